@@ -15,6 +15,7 @@
 #define _GNU_SOURCE /* asprintf */
 #define _POSIX_SOUCE /* signals */
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <poll.h>
 #include <inttypes.h>
@@ -35,6 +36,93 @@
 
 #define BUFFERSIZE 512
 
+/* a single attempt to read, returns the number of bytes read (possibly 0) or -1 on error */
+static ssize_t
+nc_read_avail(struct nc_session *session, char *buf, size_t count)
+{
+    ssize_t r = 0;
+
+    switch (session->ti_type) {
+    case NC_TI_NONE:
+        return 0;
+
+    case NC_TI_FD:
+        /* read via standard file descriptor */
+        r = read(session->ti.fd.in, buf, count);
+        if (r < 0) {
+            if ((errno == EAGAIN) || (errno == EINTR)) {
+                r = 0;
+                break;
+            } else {
+                ERR("Session %u: reading from file descriptor (%d) failed (%s).",
+                    session->id, session->ti.fd.in, strerror(errno));
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+                return -1;
+            }
+        } else if (r == 0) {
+            ERR("Session %u: communication file descriptor (%d) unexpectedly closed.",
+                session->id, session->ti.fd.in);
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_DROPPED;
+            return -1;
+        }
+        break;
+
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        /* read via libssh */
+        r = ssh_channel_read(session->ti.libssh.channel, buf, count, 0);
+        if (r == SSH_AGAIN) {
+            r = 0;
+            break;
+        } else if (r == SSH_ERROR) {
+            ERR("Session %u: reading from the SSH channel failed (%s).", session->id,
+                ssh_get_error(session->ti.libssh.session));
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_OTHER;
+            return -1;
+        } else if (r == 0) {
+            if (ssh_channel_is_eof(session->ti.libssh.channel)) {
+                ERR("Session %u: SSH channel unexpected EOF.", session->id);
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_DROPPED;
+                return -1;
+            }
+            break;
+        }
+        break;
+#endif
+
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        /* read via OpenSSL */
+        r = SSL_read(session->ti.tls, buf, count);
+        if (r <= 0) {
+            int x;
+            switch (x = SSL_get_error(session->ti.tls, r)) {
+            case SSL_ERROR_WANT_READ:
+                r = 0;
+                break;
+            case SSL_ERROR_ZERO_RETURN:
+                ERR("Session %u: communication socket unexpectedly closed (OpenSSL).", session->id);
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_DROPPED;
+                return -1;
+            default:
+                ERR("Session %u: reading from the TLS session failed (SSL code %d).", session->id, x);
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+                return -1;
+            }
+        }
+        break;
+#endif
+    }
+
+    return r;
+}
+
 static ssize_t
 nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_timeout, struct timespec *ts_act_timeout)
 {
@@ -56,82 +144,12 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
     nc_gettimespec(&ts_inact_timeout);
     nc_addtimespec(&ts_inact_timeout, inact_timeout);
     do {
-        switch (session->ti_type) {
-        case NC_TI_NONE:
+        if (session->ti_type == NC_TI_NONE) {
             return 0;
-
-        case NC_TI_FD:
-            /* read via standard file descriptor */
-            r = read(session->ti.fd.in, buf + readd, count - readd);
-            if (r < 0) {
-                if ((errno == EAGAIN) || (errno == EINTR)) {
-                    r = 0;
-                    break;
-                } else {
-                    ERR("Session %u: reading from file descriptor (%d) failed (%s).",
-                        session->id, session->ti.fd.in, strerror(errno));
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_OTHER;
-                    return -1;
-                }
-            } else if (r == 0) {
-                ERR("Session %u: communication file descriptor (%d) unexpectedly closed.",
-                    session->id, session->ti.fd.in);
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_DROPPED;
-                return -1;
-            }
-            break;
-
-#ifdef NC_ENABLED_SSH
-        case NC_TI_LIBSSH:
-            /* read via libssh */
-            r = ssh_channel_read(session->ti.libssh.channel, buf + readd, count - readd, 0);
-            if (r == SSH_AGAIN) {
-                r = 0;
-                break;
-            } else if (r == SSH_ERROR) {
-                ERR("Session %u: reading from the SSH channel failed (%s).", session->id,
-                    ssh_get_error(session->ti.libssh.session));
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_OTHER;
-                return -1;
-            } else if (r == 0) {
-                if (ssh_channel_is_eof(session->ti.libssh.channel)) {
-                    ERR("Session %u: SSH channel unexpected EOF.", session->id);
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_DROPPED;
-                    return -1;
-                }
-                break;
-            }
-            break;
-#endif
-
-#ifdef NC_ENABLED_TLS
-        case NC_TI_OPENSSL:
-            /* read via OpenSSL */
-            r = SSL_read(session->ti.tls, buf + readd, count - readd);
-            if (r <= 0) {
-                int x;
-                switch (x = SSL_get_error(session->ti.tls, r)) {
-                case SSL_ERROR_WANT_READ:
-                    r = 0;
-                    break;
-                case SSL_ERROR_ZERO_RETURN:
-                    ERR("Session %u: communication socket unexpectedly closed (OpenSSL).", session->id);
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_DROPPED;
-                    return -1;
-                default:
-                    ERR("Session %u: reading from the TLS session failed (SSL code %d).", session->id, x);
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_OTHER;
-                    return -1;
-                }
-            }
-            break;
-#endif
+        }
+        r = nc_read_avail(session, buf + readd, count - readd);
+        if (r == -1) {
+            return -1;
         }
 
         if (r == 0) {
@@ -164,154 +182,1138 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
 }
 
 static ssize_t
-nc_read_chunk(struct nc_session *session, size_t len, uint32_t inact_timeout, struct timespec *ts_act_timeout, char **chunk)
+nc_read_until(struct nc_session *session, const char *endtag, size_t limit, uint32_t inact_timeout,
+              struct timespec *ts_act_timeout, char **result)
 {
-    ssize_t r;
+    char *chunk = NULL;
+    size_t size, count = 0, r, len;
 
     assert(session);
-    assert(chunk);
+    assert(endtag);
 
-    if (!len) {
-        return 0;
+    if (limit && limit < BUFFERSIZE) {
+        size = limit;
+    } else {
+        size = BUFFERSIZE;
     }
-
-    *chunk = malloc((len + 1) * sizeof **chunk);
-    if (!*chunk) {
+    chunk = malloc((size + 1) * sizeof *chunk);
+    if (!chunk) {
         ERRMEM;
         return -1;
     }
 
-    r = nc_read(session, *chunk, len, inact_timeout, ts_act_timeout);
-    if (r <= 0) {
-        free(*chunk);
-        return -1;
+    len = strlen(endtag);
+    while (1) {
+        if (limit && count == limit) {
+            free(chunk);
+            WRN("Session %u: reading limit (%d) reached.", session->id, limit);
+            ERR("Session %u: invalid input data (missing \"%s\" sequence).", session->id, endtag);
+            return -1;
+        }
+
+        /* resize buffer if needed */
+        if (count == size) {
+            /* get more memory */
+            size = size + BUFFERSIZE;
+            chunk = realloc(chunk, (size + 1) * sizeof *chunk);
+            if (!chunk) {
+                ERRMEM;
+                return -1;
+            }
+        }
+
+        /* get another character */
+        r = nc_read(session, &(chunk[count]), 1, inact_timeout, ts_act_timeout);
+        if (r != 1) {
+            free(chunk);
+            return -1;
+        }
+
+        count++;
+
+        /* check endtag */
+        if (count >= len) {
+            if (!strncmp(endtag, &(chunk[count - len]), len)) {
+                /* endtag found */
+                break;
+            }
+        }
     }
 
     /* terminating null byte */
-    (*chunk)[r] = 0;
+    chunk[count] = 0;
+
+    if (result) {
+        *result = chunk;
+    } else {
+        free(chunk);
+    }
+    return count;
+}
+
+/* return -1 means either poll error or that session was invalidated (socket error), EINTR is handled inside */
+static int
+nc_read_poll(struct nc_session *session, int timeout)
+{
+    sigset_t sigmask, origmask;
+    int ret = -2;
+    struct pollfd fds;
+
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        ERR("Session %u: invalid session to poll.", session->id);
+        return -1;
+    }
+
+    switch (session->ti_type) {
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        /* EINTR is handled, it resumes waiting */
+        ret = ssh_channel_poll_timeout(session->ti.libssh.channel, timeout, 0);
+        if (ret == SSH_ERROR) {
+            ERR("Session %u: SSH channel poll error (%s).", session->id,
+                ssh_get_error(session->ti.libssh.session));
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_OTHER;
+            return -1;
+        } else if (ret == SSH_EOF) {
+            ERR("Session %u: SSH channel unexpected EOF.", session->id);
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_DROPPED;
+            return -1;
+        } else if (ret > 0) {
+            /* fake it */
+            ret = 1;
+            fds.revents = POLLIN;
+        } else { /* ret == 0 */
+            fds.revents = 0;
+        }
+        break;
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        ret = SSL_pending(session->ti.tls);
+        if (ret) {
+            /* some buffered TLS data available */
+            ret = 1;
+            fds.revents = POLLIN;
+            break;
+        }
+
+        fds.fd = SSL_get_fd(session->ti.tls);
+        /* fallthrough */
+#endif
+    case NC_TI_FD:
+        if (session->ti_type == NC_TI_FD) {
+            fds.fd = session->ti.fd.in;
+        }
+
+        fds.events = POLLIN;
+        fds.revents = 0;
+
+        sigfillset(&sigmask);
+        pthread_sigmask(SIG_SETMASK, &sigmask, &origmask);
+        ret = poll(&fds, 1, timeout);
+        pthread_sigmask(SIG_SETMASK, &origmask, NULL);
+
+        break;
+
+    default:
+        ERRINT;
+        return -1;
+    }
+
+    /* process the poll result, unified ret meaning for poll and ssh_channel poll */
+    if (ret < 0) {
+        /* poll failed - something really bad happened, close the session */
+        ERR("Session %u: poll error (%s).", session->id, strerror(errno));
+        session->status = NC_STATUS_INVALID;
+        session->term_reason = NC_SESSION_TERM_OTHER;
+        return -1;
+    } else { /* status > 0 */
+        /* in case of standard (non-libssh) poll, there still can be an error */
+        if (fds.revents & POLLHUP) {
+            ERR("Session %u: communication channel unexpectedly closed.", session->id);
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_DROPPED;
+            return -1;
+        }
+        if (fds.revents & POLLERR) {
+            ERR("Session %u: communication channel error.", session->id);
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_OTHER;
+            return -1;
+        }
+    }
+
+    return ret;
+}
+
+/* read what is available of a message into the session, returns 1 once the message is complete, 0 if it is not yet,
+ * -1 on error, and -2 on a framing error; with nonblock, file descriptors are polled before every read so that
+ * blocking ones do not block, the other transports never do */
+static int
+nc_read_msg_part(struct nc_session *session, int nonblock, size_t *readd)
+{
+    struct nc_msg_read *rd = &session->rd;
+    size_t count, size;
+    ssize_t r;
+    char *ptr;
+
+    *readd = 0;
+    while (1) {
+        if (nonblock && (session->ti_type == NC_TI_FD)) {
+            r = nc_read_poll(session, 0);
+            if (r < 1) {
+                return r;
+            }
+        }
+
+        if ((session->version == NC_VERSION_10) || rd->chunk_left) {
+            /* chunks are read whole, 1.0 messages byte by byte not to read past the end tag */
+            count = (session->version == NC_VERSION_10 ? 1 : rd->chunk_left);
+            if (rd->len + count + 1 > rd->size) {
+                size = (rd->size ? rd->size : BUFFERSIZE);
+                while (rd->len + count + 1 > size) {
+                    size *= 2;
+                }
+                ptr = realloc(rd->msg, size);
+                if (!ptr) {
+                    ERRMEM;
+                    return -1;
+                }
+                rd->msg = ptr;
+                rd->size = size;
+            }
+
+            r = nc_read_avail(session, rd->msg + rd->len, count);
+            if (r < 1) {
+                return r;
+            }
+            rd->len += r;
+            rd->msg[rd->len] = '\0';
+            *readd += r;
+
+            if (session->version == NC_VERSION_11) {
+                rd->chunk_left -= r;
+            } else if ((rd->len >= NC_VERSION_10_ENDTAG_LEN)
+                    && !strcmp(rd->msg + rd->len - NC_VERSION_10_ENDTAG_LEN, NC_VERSION_10_ENDTAG)) {
+                /* cut off the end tag */
+                rd->len -= NC_VERSION_10_ENDTAG_LEN;
+                rd->msg[rd->len] = '\0';
+                return 1;
+            }
+            continue;
+        }
+
+        /* chunk delimiter, byte by byte */
+        r = nc_read_avail(session, rd->frame + rd->frame_len, 1);
+        if (r < 1) {
+            return r;
+        }
+        ++rd->frame_len;
+        ++*readd;
+        if (((rd->frame_len == 1) && (rd->frame[0] != '\n')) || ((rd->frame_len == 2) && (rd->frame[1] != '#'))
+                || (rd->frame_len == sizeof rd->frame)) {
+            ERR("Session %u: invalid frame chunk delimiters.", session->id);
+            return -2;
+        } else if ((rd->frame_len < 4) || (rd->frame[rd->frame_len - 1] != '\n')) {
+            continue;
+        }
+        rd->frame[rd->frame_len - 1] = '\0';
+        rd->frame_len = 0;
+
+        if (!strcmp(rd->frame, "\n##")) {
+            /* end of chunked framing message */
+            if (!rd->len) {
+                ERR("Session %u: invalid frame chunk delimiters.", session->id);
+                return -2;
+            }
+            return 1;
+        }
+
+        /* convert string to the size of the following chunk */
+        rd->chunk_left = strtoull(rd->frame + 2, &ptr, 10);
+        if (!rd->chunk_left || *ptr) {
+            ERR("Session %u: invalid frame chunk size detected, fatal error.", session->id);
+            return -2;
+        }
+    }
+}
+
+/* get the type of a received message from its root element */
+static NC_MSG_TYPE
+nc_read_msg_type(struct nc_session *session, struct lyxml_elem *data)
+{
+    if (!strcmp(data->ns->value, NC_NS_BASE)) {
+        if (!strcmp(data->name, "rpc")) {
+            return NC_MSG_RPC;
+        } else if (!strcmp(data->name, "rpc-reply")) {
+            return NC_MSG_REPLY;
+        } else if (!strcmp(data->name, "hello")) {
+            return NC_MSG_HELLO;
+        } else {
+            ERR("Session %u: invalid message root element (invalid name \"%s\").", session->id, data->name);
+            return NC_MSG_ERROR;
+        }
+    } else if (!strcmp(data->ns->value, NC_NS_NOTIF)) {
+        if (!strcmp(data->name, "notification")) {
+            return NC_MSG_NOTIF;
+        } else {
+            ERR("Session %u: invalid message root element (invalid name \"%s\").", session->id, data->name);
+            return NC_MSG_ERROR;
+        }
+    }
+
+    ERR("Session %u: invalid message root element (invalid namespace \"%s\").", session->id, data->ns->value);
+    return NC_MSG_ERROR;
+}
+
+/* tokenizer states of the message splitter */
+#define NC_SPLIT_TEXT 0
+#define NC_SPLIT_MARKUP 1
+#define NC_SPLIT_QUOTE 2
+#define NC_SPLIT_COMMENT 3
+#define NC_SPLIT_CDATA 4
+#define NC_SPLIT_PI 5
+
+/* kinds of a finished markup */
+#define NC_SPLIT_START 0
+#define NC_SPLIT_END 1
+#define NC_SPLIT_EMPTY 2
+#define NC_SPLIT_OTHER 3
+
+struct nc_split_buf {
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+struct nc_split_ns {
+    char *decl;                 /* whole declaration as received, xmlns[:prefix]="uri" */
+    size_t name_len;            /* length of the xmlns[:prefix] part */
+};
+
+struct nc_msg_split {
+    struct nc_session *session;
+    uint64_t msgid;
+    int (*clb)(const char *xml, size_t len, void *arg);
+    void *clb_arg;
+    int clb_ret;
+
+    int state;
+    char quote;
+    char prev[2];               /* last characters, for comment/CDATA/PI end detection */
+    uint32_t depth;
+    int split;                  /* the message is the requested reply */
+    int in_data;                /* inside its <data> element */
+    int frag;                   /* 0 - no fragment, 1 - markup in <data> started, 2 - inside a data subtree */
+
+    int notif;                  /* only scanning for a notification, nothing is copied */
+    size_t pos;                 /* length of the data fed so far */
+    size_t time_start;          /* position of the eventTime content */
+    size_t time_end;
+    char *root;                 /* name of the notification content root element */
+    char *root_ns;              /* its namespace */
+
+    struct nc_split_buf envelope;
+    struct nc_split_buf tag;
+    struct nc_split_buf subtree;
+    struct nc_split_ns *ns;
+    uint16_t ns_count;
+};
+
+static int
+nc_split_buf_add(struct nc_split_buf *buf, const char *data, size_t len)
+{
+    char *ptr;
+    size_t size;
+
+    if (buf->len + len + 1 > buf->size) {
+        size = buf->size ? buf->size : BUFFERSIZE;
+        while (buf->len + len + 1 > size) {
+            size *= 2;
+        }
+        ptr = realloc(buf->data, size);
+        if (!ptr) {
+            ERRMEM;
+            return -1;
+        }
+        buf->data = ptr;
+        buf->size = size;
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+/* get the next attribute of a start tag, str points after the element name, returns NULL at the end of the tag */
+static const char *
+nc_split_next_attr(const char *str, const char **name, size_t *name_len, const char **value, size_t *value_len)
+{
+    char quote;
+
+    while (isspace((unsigned char)*str)) {
+        ++str;
+    }
+    if (!*str || (*str == '/') || (*str == '>')) {
+        return NULL;
+    }
+
+    *name = str;
+    while (*str && (*str != '=') && !isspace((unsigned char)*str)) {
+        ++str;
+    }
+    *name_len = str - *name;
+    while (isspace((unsigned char)*str)) {
+        ++str;
+    }
+    if (*str != '=') {
+        return NULL;
+    }
+    ++str;
+    while (isspace((unsigned char)*str)) {
+        ++str;
+    }
+    if ((*str != '"') && (*str != '\'')) {
+        return NULL;
+    }
+    quote = *str;
+    ++str;
+
+    *value = str;
+    while (*str && (*str != quote)) {
+        ++str;
+    }
+    if (!*str) {
+        return NULL;
+    }
+    *value_len = str - *value;
+
+    return str + 1;
+}
+
+/* add a namespace declaration, a redeclared prefix overrides the previous one */
+static int
+nc_split_add_ns(struct nc_msg_split *split, const char *aname, size_t aname_len, const char *value, size_t value_len)
+{
+    struct nc_split_ns *ns;
+    uint16_t i;
+
+    for (i = 0; i < split->ns_count; ++i) {
+        if ((split->ns[i].name_len == aname_len) && !strncmp(split->ns[i].decl, aname, aname_len)) {
+            break;
+        }
+    }
+    if (i == split->ns_count) {
+        ns = realloc(split->ns, (split->ns_count + 1) * sizeof *split->ns);
+        if (!ns) {
+            ERRMEM;
+            return -1;
+        }
+        split->ns = ns;
+        ++split->ns_count;
+    } else {
+        free(split->ns[i].decl);
+    }
+    split->ns[i].decl = strndup(aname, (value + value_len + 1) - aname);
+    split->ns[i].name_len = aname_len;
+    if (!split->ns[i].decl) {
+        ERRMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* find the namespace of a start tag among the declared ones */
+static const char *
+nc_split_find_ns(struct nc_msg_split *split, const char *tag, size_t *len)
+{
+    size_t prefix_len;
+    const char *value;
+    uint16_t i;
+
+    prefix_len = strcspn(tag, ": \t\r\n/>");
+    if (tag[prefix_len] != ':') {
+        prefix_len = 0;
+    }
+
+    for (i = 0; i < split->ns_count; ++i) {
+        if (prefix_len) {
+            if ((split->ns[i].name_len != 6 + prefix_len) || strncmp(split->ns[i].decl + 6, tag, prefix_len)) {
+                continue;
+            }
+        } else if (split->ns[i].name_len != 5) {
+            continue;
+        }
+
+        value = strpbrk(split->ns[i].decl + split->ns[i].name_len, "\"'") + 1;
+        *len = strlen(value) - 1;
+        return value;
+    }
+
+    return NULL;
+}
+
+/* learn the namespaces of <notification>, and the eventTime and the root element of its content */
+static int
+nc_split_notif_tag(struct nc_msg_split *split, const char *tag, const char *name, size_t name_len)
+{
+    const char *str, *aname, *value, *ns;
+    size_t aname_len, value_len, ns_len;
+
+    if (split->depth == 2) {
+        if ((name_len == 9) && !strncmp(name, "eventTime", 9)) {
+            if (!split->time_start && (split->tag.data[split->tag.len - 1] != '/')) {
+                split->time_start = split->pos;
+            }
+            return 0;
+        } else if (split->root) {
+            return 0;
+        }
+    } else if (split->depth != 1) {
+        return 0;
+    }
+
+    for (str = tag + strcspn(tag, " \t\r\n/>"); (str = nc_split_next_attr(str, &aname, &aname_len, &value, &value_len)); ) {
+        if ((aname_len < 5) || strncmp(aname, "xmlns", 5) || ((aname_len > 5) && (aname[5] != ':'))) {
+            continue;
+        }
+        if (nc_split_add_ns(split, aname, aname_len, value, value_len)) {
+            return -1;
+        }
+    }
+    ns = nc_split_find_ns(split, tag, &ns_len);
+
+    if (split->depth == 1) {
+        if ((name_len != 12) || strncmp(name, "notification", 12) || !ns || (ns_len != strlen(NC_NS_NOTIF))
+                || strncmp(ns, NC_NS_NOTIF, ns_len)) {
+            /* not a notification, stop */
+            return -1;
+        }
+        return 0;
+    } else if (!ns || !ns_len) {
+        return -1;
+    }
+
+    split->root = strndup(name, name_len);
+    split->root_ns = strndup(ns, ns_len);
+    if (!split->root || !split->root_ns) {
+        ERRMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/* learn the namespaces and the message-id from a start tag of <rpc-reply> or <data> */
+static int
+nc_split_start_tag(struct nc_msg_split *split, const char *tag)
+{
+    const char *name, *str, *aname, *value;
+    size_t name_len, aname_len, value_len;
+
+    name = tag;
+    name_len = strcspn(tag, " \t\r\n/>");
+    if (memchr(name, ':', name_len)) {
+        name_len -= (strchr(name, ':') + 1) - name;
+        name = strchr(name, ':') + 1;
+    }
+
+    if (split->notif) {
+        return nc_split_notif_tag(split, tag, name, name_len);
+    } else if (split->depth == 1) {
+        if ((name_len != 9) || strncmp(name, "rpc-reply", 9)) {
+            return 0;
+        }
+    } else if (split->split && (split->depth == 2)) {
+        if ((name_len != 4) || strncmp(name, "data", 4)) {
+            return 0;
+        }
+        split->in_data = 1;
+    } else {
+        return 0;
+    }
+
+    for (str = tag + strcspn(tag, " \t\r\n/>"); (str = nc_split_next_attr(str, &aname, &aname_len, &value, &value_len)); ) {
+        if ((split->depth == 1) && (aname_len == 10) && !strncmp(aname, "message-id", 10)) {
+            if (strtoull(value, NULL, 10) == split->msgid) {
+                split->split = 1;
+            }
+            continue;
+        }
+        if ((aname_len < 5) || strncmp(aname, "xmlns", 5) || ((aname_len > 5) && (aname[5] != ':'))) {
+            continue;
+        }
+
+        /* namespace declaration, <data> ones override <rpc-reply> ones */
+        if (nc_split_add_ns(split, aname, aname_len, value, value_len)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* pass a complete data subtree to the callback, with the inherited namespaces declared on its root */
+static int
+nc_split_subtree(struct nc_msg_split *split)
+{
+    const char *str, *aname, *value;
+    size_t name_end, aname_len, value_len, len;
+    char *xml, *ptr;
+    uint16_t i;
+    int *inherit = NULL;
+
+    if (split->clb_ret) {
+        /* callback failed before, just skip the rest of the data */
+        split->subtree.len = 0;
+        return 0;
+    }
+
+    if (split->ns_count) {
+        inherit = malloc(split->ns_count * sizeof *inherit);
+        if (!inherit) {
+            ERRMEM;
+            return -1;
+        }
+    }
+
+    /* skip the namespaces redefined by the subtree root */
+    name_end = 1 + strcspn(split->subtree.data + 1, " \t\r\n/>");
+    len = split->subtree.len;
+    for (i = 0; i < split->ns_count; ++i) {
+        inherit[i] = 1;
+        for (str = split->subtree.data + name_end; (str = nc_split_next_attr(str, &aname, &aname_len, &value, &value_len)); ) {
+            if ((aname_len == split->ns[i].name_len) && !strncmp(aname, split->ns[i].decl, aname_len)) {
+                inherit[i] = 0;
+                break;
+            }
+        }
+        if (inherit[i]) {
+            len += 1 + strlen(split->ns[i].decl);
+        }
+    }
+
+    xml = malloc(len + 1);
+    if (!xml) {
+        ERRMEM;
+        free(inherit);
+        return -1;
+    }
+    memcpy(xml, split->subtree.data, name_end);
+    ptr = xml + name_end;
+    for (i = 0; i < split->ns_count; ++i) {
+        if (inherit[i]) {
+            ptr += sprintf(ptr, " %s", split->ns[i].decl);
+        }
+    }
+    memcpy(ptr, split->subtree.data + name_end, split->subtree.len - name_end + 1);
+    free(inherit);
+
+    split->clb_ret = split->clb(xml, len, split->clb_arg);
+    free(xml);
+    split->subtree.len = 0;
+
+    return 0;
+}
+
+/* a markup has just been finished */
+static int
+nc_split_markup(struct nc_msg_split *split, int kind)
+{
+    struct nc_split_buf *sink;
+
+    if (split->frag == 1) {
+        /* first markup at the top level of <data> */
+        switch (kind) {
+        case NC_SPLIT_START:
+            ++split->depth;
+            split->frag = 2;
+            return 0;
+        case NC_SPLIT_EMPTY:
+            split->frag = 0;
+            return nc_split_subtree(split);
+        case NC_SPLIT_END:
+            --split->depth;
+            split->in_data = 0;
+            break;
+        }
+
+        /* not a subtree, move it back to the envelope */
+        split->frag = 0;
+        sink = &split->subtree;
+        if (nc_split_buf_add(&split->envelope, sink->data, sink->len)) {
+            return -1;
+        }
+        sink->len = 0;
+        return 0;
+    } else if (split->frag == 2) {
+        if (kind == NC_SPLIT_START) {
+            ++split->depth;
+        } else if ((kind == NC_SPLIT_END) && (--split->depth == 2)) {
+            split->frag = 0;
+            return nc_split_subtree(split);
+        }
+        return 0;
+    }
+
+    switch (kind) {
+    case NC_SPLIT_START:
+        ++split->depth;
+        return nc_split_start_tag(split, split->tag.data);
+    case NC_SPLIT_EMPTY:
+        ++split->depth;
+        if (nc_split_start_tag(split, split->tag.data)) {
+            return -1;
+        }
+        --split->depth;
+        split->in_data = 0;
+        break;
+    case NC_SPLIT_END:
+        if (!split->depth) {
+            ERR("Session %u: unexpected end tag \"<%s>\".", split->session->id, split->tag.data);
+            return -1;
+        }
+        if (split->notif && (split->depth == 2) && split->time_start && !split->time_end) {
+            /* end of eventTime, before "</" tag ">" */
+            split->time_end = split->pos - (split->tag.len + 2);
+        }
+        if (--split->depth < 2) {
+            split->in_data = 0;
+        }
+        break;
+    }
+
+    return 0;
+}
+
+/* feed received message data into the splitter, whole runs of characters are processed at once where possible */
+static int
+nc_split_feed(struct nc_msg_split *split, const char *data, size_t len)
+{
+    struct nc_split_buf *sink;
+    const char *end = data + len, *ptr;
+    size_t run;
+    char p0, p1;
+    int kind;
+
+    while (data < end) {
+        kind = -1;
+        switch (split->state) {
+        case NC_SPLIT_TEXT:
+            if (*data == '<') {
+                if (split->in_data && (split->depth == 2) && !split->frag) {
+                    split->frag = 1;
+                }
+                split->state = NC_SPLIT_MARKUP;
+                split->tag.len = 0;
+                run = 1;
+            } else {
+                /* all the text up to the next markup */
+                ptr = memchr(data, '<', end - data);
+                run = (ptr ? ptr : end) - data;
+            }
+            break;
+        case NC_SPLIT_MARKUP:
+            if (*data == '>') {
+                if (split->tag.len && (split->tag.data[0] == '/')) {
+                    kind = NC_SPLIT_END;
+                } else if (split->tag.len && ((split->tag.data[0] == '!') || (split->tag.data[0] == '?'))) {
+                    kind = NC_SPLIT_OTHER;
+                } else if (split->tag.len && (split->tag.data[split->tag.len - 1] == '/')) {
+                    kind = NC_SPLIT_EMPTY;
+                } else {
+                    kind = NC_SPLIT_START;
+                }
+                run = 1;
+                break;
+            }
+
+            if ((*data == '"') || (*data == '\'')) {
+                split->quote = *data;
+                split->state = NC_SPLIT_QUOTE;
+                run = 1;
+            } else if (split->tag.len < 8) {
+                /* the beginning decides whether it is a comment, CDATA, or a processing instruction */
+                run = 1;
+            } else {
+                for (run = 1; (data + run < end) && (data[run] != '"') && (data[run] != '\'') && (data[run] != '>'); ++run);
+            }
+            if (nc_split_buf_add(&split->tag, data, run)) {
+                return -1;
+            }
+            if (split->state != NC_SPLIT_MARKUP) {
+                break;
+            }
+            if ((split->tag.len == 1) && (split->tag.data[0] == '?')) {
+                split->state = NC_SPLIT_PI;
+            } else if ((split->tag.len == 3) && !strcmp(split->tag.data, "!--")) {
+                split->state = NC_SPLIT_COMMENT;
+            } else if ((split->tag.len == 8) && !strcmp(split->tag.data, "![CDATA[")) {
+                split->state = NC_SPLIT_CDATA;
+            }
+            break;
+        case NC_SPLIT_QUOTE:
+            ptr = memchr(data, split->quote, end - data);
+            run = (ptr ? ptr + 1 : end) - data;
+            if (nc_split_buf_add(&split->tag, data, run)) {
+                return -1;
+            }
+            if (ptr) {
+                split->state = NC_SPLIT_MARKUP;
+            }
+            break;
+        case NC_SPLIT_COMMENT:
+        case NC_SPLIT_CDATA:
+        case NC_SPLIT_PI:
+            ptr = memchr(data, '>', end - data);
+            run = (ptr ? ptr + 1 : end) - data;
+            if (!ptr) {
+                break;
+            }
+
+            /* the two characters before '>', possibly from the previous blocks */
+            p1 = (run > 1 ? data[run - 2] : split->prev[1]);
+            p0 = (run > 2 ? data[run - 3] : (run == 2 ? split->prev[1] : split->prev[0]));
+            if (((split->state == NC_SPLIT_COMMENT) && (p0 == '-') && (p1 == '-'))
+                    || ((split->state == NC_SPLIT_CDATA) && (p0 == ']') && (p1 == ']'))
+                    || ((split->state == NC_SPLIT_PI) && (p1 == '?'))) {
+                kind = NC_SPLIT_OTHER;
+            }
+            break;
+        default:
+            ERRINT;
+            return -1;
+        }
+
+        if (!split->notif) {
+            sink = (split->frag ? &split->subtree : &split->envelope);
+            if (nc_split_buf_add(sink, data, run)) {
+                return -1;
+            }
+        }
+        split->pos += run;
+        if (run > 1) {
+            split->prev[0] = data[run - 2];
+        } else {
+            split->prev[0] = split->prev[1];
+        }
+        split->prev[1] = data[run - 1];
+        data += run;
+
+        if (kind > -1) {
+            split->state = NC_SPLIT_TEXT;
+            split->prev[0] = split->prev[1] = '\0';
+            if (nc_split_markup(split, kind)) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* if the received message is a notification, make a raw one of it, taking over the message,
+ * returns 1 on success, 0 if it is not a notification (or not a well-formed one), -1 on error */
+static int
+nc_read_notif_raw(struct nc_session *session, char *msg, size_t len, struct nc_notif_raw **notif)
+{
+    struct nc_msg_split split;
+    char *str;
+    size_t time_len;
+    uint16_t i;
+    int ret = 0;
+
+    memset(&split, 0, sizeof split);
+    split.session = session;
+    split.notif = 1;
+
+    if (nc_split_feed(&split, msg, len) || split.depth || (split.state != NC_SPLIT_TEXT) || !split.root
+            || (split.time_end <= split.time_start)) {
+        goto cleanup;
+    }
+
+    /* the strings are stored right after the structure */
+    time_len = split.time_end - split.time_start;
+    *notif = calloc(1, sizeof **notif + time_len + 1 + strlen(split.root) + 1 + strlen(split.root_ns) + 1);
+    if (!*notif) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    str = (char *)(*notif + 1);
+    (*notif)->datetime = memcpy(str, msg + split.time_start, time_len);
+    str += time_len + 1;
+    (*notif)->name = strcpy(str, split.root);
+    str += strlen(str) + 1;
+    (*notif)->ns = strcpy(str, split.root_ns);
+    (*notif)->xml = msg;
+    (*notif)->xml_len = len;
+    ret = 1;
+
+cleanup:
+    free(split.tag.data);
+    for (i = 0; i < split.ns_count; ++i) {
+        free(split.ns[i].decl);
+    }
+    free(split.ns);
+    free(split.root);
+    free(split.root_ns);
+
+    return ret;
+}
+
+/* return NC_MSG_ERROR can change session status */
+static NC_MSG_TYPE
+_nc_read_msg(struct nc_session *session, int nonblock, struct lyxml_elem **data, struct nc_notif_raw **notif)
+{
+    int ret;
+    char *msg = NULL;
+    size_t len, readd;
+    /* use timeout in milliseconds instead seconds */
+    uint32_t inact_timeout = NC_READ_INACT_TIMEOUT * 1000;
+    struct timespec ts_act_timeout, ts_inact_timeout, ts_cur;
+    struct nc_server_reply *reply;
+
+    assert(session && data);
+    *data = NULL;
+    if (notif) {
+        *notif = NULL;
+    }
+
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        ERR("Session %u: invalid session to read from.", session->id);
+        return NC_MSG_ERROR;
+    }
+
+    nc_gettimespec(&ts_act_timeout);
+    nc_addtimespec(&ts_act_timeout, NC_READ_ACT_TIMEOUT * 1000);
+    nc_gettimespec(&ts_inact_timeout);
+    nc_addtimespec(&ts_inact_timeout, inact_timeout);
+
+    /* read the message, or the rest of it if it was read only partially before */
+    while (!(ret = nc_read_msg_part(session, nonblock, &readd))) {
+        if (nonblock) {
+            return NC_MSG_WOULDBLOCK;
+        }
+
+        nc_gettimespec(&ts_cur);
+        if (readd) {
+            /* reset inactive timeout */
+            ts_inact_timeout = ts_cur;
+            nc_addtimespec(&ts_inact_timeout, inact_timeout);
+            continue;
+        }
+
+        /* nothing read */
+        if (nc_difftimespec(&ts_cur, &ts_inact_timeout) < 1) {
+            ERR("Session %u: inactive read timeout elapsed.", session->id);
+        } else if (nc_difftimespec(&ts_cur, &ts_act_timeout) < 1) {
+            ERR("Session %u: active read timeout elapsed.", session->id);
+        } else {
+            usleep(NC_TIMEOUT_STEP);
+            continue;
+        }
+        session->status = NC_STATUS_INVALID;
+        session->term_reason = NC_SESSION_TERM_OTHER;
+        goto error;
+    }
+    if (ret < 0) {
+        /* drop what was read of the message */
+        free(session->rd.msg);
+        memset(&session->rd, 0, sizeof session->rd);
+        if (ret == -1) {
+            goto error;
+        }
+        goto malformed_msg;
+    }
+
+    /* take the message over */
+    msg = session->rd.msg;
+    len = session->rd.len;
+    memset(&session->rd, 0, sizeof session->rd);
+
+    DBG("Session %u: received message:\n%s\n", session->id, msg);
+
+    if (notif) {
+        /* a notification is returned as received */
+        ret = nc_read_notif_raw(session, msg, len, notif);
+        if (ret == 1) {
+            return NC_MSG_NOTIF;
+        } else if (ret == -1) {
+            goto error;
+        }
+    }
+
+    /* build XML tree */
+    *data = lyxml_parse_mem(session->ctx, msg, 0);
+    if (!*data) {
+        goto malformed_msg;
+    } else if (!(*data)->ns) {
+        ERR("Session %u: invalid message root element (invalid namespace).", session->id);
+        goto malformed_msg;
+    }
+    free(msg);
+    msg = NULL;
+
+    /* get and return message type */
+    ret = nc_read_msg_type(session, *data);
+    if (ret != NC_MSG_ERROR) {
+        return ret;
+    }
+
+malformed_msg:
+    ERR("Session %u: malformed message received.", session->id);
+    if ((session->side == NC_SERVER) && (session->version == NC_VERSION_11)) {
+        /* NETCONF version 1.1 defines sending error reply from the server (RFC 6241 sec. 3) */
+        reply = nc_server_reply_err(nc_err(NC_ERR_MALFORMED_MSG));
+
+        if (nc_write_msg(session, NC_MSG_REPLY, NULL, reply) == -1) {
+            ERR("Session %u: unable to send a \"Malformed message\" error reply, terminating session.", session->id);
+            if (session->status != NC_STATUS_INVALID) {
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+            }
+        }
+        nc_server_reply_free(reply);
+    }
+
+error:
+    /* cleanup */
+    free(msg);
+    free(*data);
+    *data = NULL;
+
+    return NC_MSG_ERROR;
+}
 
-    return r;
+NC_MSG_TYPE
+nc_read_msg(struct nc_session *session, struct lyxml_elem **data)
+{
+    return _nc_read_msg(session, 0, data, NULL);
 }
 
-static ssize_t
-nc_read_until(struct nc_session *session, const char *endtag, size_t limit, uint32_t inact_timeout,
-              struct timespec *ts_act_timeout, char **result)
+NC_MSG_TYPE
+nc_read_msg_nonblock(struct nc_session *session, struct lyxml_elem **data)
 {
-    char *chunk = NULL;
-    size_t size, count = 0, r, len;
+    return _nc_read_msg(session, 1, data, NULL);
+}
 
-    assert(session);
-    assert(endtag);
+/* return NC_MSG_ERROR can change session status */
+NC_MSG_TYPE
+nc_read_msg_notif_raw_poll(struct nc_session *session, int timeout, struct lyxml_elem **data,
+                           struct nc_notif_raw **notif)
+{
+    int ret;
 
-    if (limit && limit < BUFFERSIZE) {
-        size = limit;
-    } else {
-        size = BUFFERSIZE;
-    }
-    chunk = malloc((size + 1) * sizeof *chunk);
-    if (!chunk) {
-        ERRMEM;
-        return -1;
+    assert(data);
+    *data = NULL;
+    if (notif) {
+        *notif = NULL;
     }
 
-    len = strlen(endtag);
-    while (1) {
-        if (limit && count == limit) {
-            free(chunk);
-            WRN("Session %u: reading limit (%d) reached.", session->id, limit);
-            ERR("Session %u: invalid input data (missing \"%s\" sequence).", session->id, endtag);
-            return -1;
-        }
-
-        /* resize buffer if needed */
-        if (count == size) {
-            /* get more memory */
-            size = size + BUFFERSIZE;
-            chunk = realloc(chunk, (size + 1) * sizeof *chunk);
-            if (!chunk) {
-                ERRMEM;
-                return -1;
-            }
-        }
-
-        /* get another character */
-        r = nc_read(session, &(chunk[count]), 1, inact_timeout, ts_act_timeout);
-        if (r != 1) {
-            free(chunk);
-            return -1;
-        }
-
-        count++;
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        ERR("Session %u: invalid session to read from.", session->id);
+        return NC_MSG_ERROR;
+    }
 
-        /* check endtag */
-        if (count >= len) {
-            if (!strncmp(endtag, &(chunk[count - len]), len)) {
-                /* endtag found */
-                break;
-            }
-        }
+    ret = nc_read_poll(session, timeout);
+    if (ret == 0) {
+        /* timed out */
+        return NC_MSG_WOULDBLOCK;
+    } else if (ret < 0) {
+        /* poll error, error written */
+        return NC_MSG_ERROR;
     }
 
-    /* terminating null byte */
-    chunk[count] = 0;
+    return _nc_read_msg(session, 0, data, notif);
+}
 
-    if (result) {
-        *result = chunk;
-    } else {
-        free(chunk);
-    }
-    return count;
+NC_MSG_TYPE
+nc_read_msg_poll(struct nc_session *session, int timeout, struct lyxml_elem **data)
+{
+    return nc_read_msg_notif_raw_poll(session, timeout, data, NULL);
 }
 
 /* return NC_MSG_ERROR can change session status */
-NC_MSG_TYPE
-nc_read_msg(struct nc_session *session, struct lyxml_elem **data)
+static NC_MSG_TYPE
+nc_read_msg_split(struct nc_session *session, uint64_t msgid, int (*clb)(const char *xml, size_t len, void *arg),
+                  void *clb_arg, struct lyxml_elem **data)
 {
     int ret;
-    char *msg = NULL, *chunk;
+    char buf[BUFFERSIZE + 1], *chunk;
     uint64_t chunk_len, len = 0;
+    size_t count = 0;
     /* use timeout in milliseconds instead seconds */
     uint32_t inact_timeout = NC_READ_INACT_TIMEOUT * 1000;
     struct timespec ts_act_timeout;
-    struct nc_server_reply *reply;
-
-    assert(session && data);
-    *data = NULL;
+    struct nc_msg_split split;
+    NC_MSG_TYPE msgtype = NC_MSG_ERROR;
+    uint16_t i;
 
-    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
-        ERR("Session %u: invalid session to read from.", session->id);
-        return NC_MSG_ERROR;
+    if (session->rd.len || session->rd.frame_len || session->rd.chunk_left) {
+        /* finish the message partially read before whole */
+        return _nc_read_msg(session, 0, data, NULL);
     }
 
+    memset(&split, 0, sizeof split);
+    split.session = session;
+    split.msgid = msgid;
+    split.clb = clb;
+    split.clb_arg = clb_arg;
+
+    /* the activity timeout is restarted after every block so that only a stalled transfer times out */
     nc_gettimespec(&ts_act_timeout);
     nc_addtimespec(&ts_act_timeout, NC_READ_ACT_TIMEOUT * 1000);
 
     /* read the message */
     switch (session->version) {
     case NC_VERSION_10:
-        ret = nc_read_until(session, NC_VERSION_10_ENDTAG, 0, inact_timeout, &ts_act_timeout, &msg);
-        if (ret == -1) {
-            goto error;
-        }
+        while (1) {
+            ret = nc_read(session, buf + count, 1, inact_timeout, &ts_act_timeout);
+            if (ret != 1) {
+                goto cleanup;
+            }
+            ++count;
+
+            if ((count >= NC_VERSION_10_ENDTAG_LEN)
+                    && !strncmp(buf + count - NC_VERSION_10_ENDTAG_LEN, NC_VERSION_10_ENDTAG, NC_VERSION_10_ENDTAG_LEN)) {
+                if (nc_split_feed(&split, buf, count - NC_VERSION_10_ENDTAG_LEN)) {
+                    goto cleanup;
+                }
+                break;
+            }
+
+            if (count == BUFFERSIZE) {
+                /* keep the possible beginning of the end tag */
+                if (nc_split_feed(&split, buf, count - (NC_VERSION_10_ENDTAG_LEN - 1))) {
+                    goto cleanup;
+                }
+                memmove(buf, buf + count - (NC_VERSION_10_ENDTAG_LEN - 1), NC_VERSION_10_ENDTAG_LEN - 1);
+                count = NC_VERSION_10_ENDTAG_LEN - 1;
 
-        /* cut off the end tag */
-        msg[ret - NC_VERSION_10_ENDTAG_LEN] = '\0';
+                nc_gettimespec(&ts_act_timeout);
+                nc_addtimespec(&ts_act_timeout, NC_READ_ACT_TIMEOUT * 1000);
+            }
+        }
         break;
     case NC_VERSION_11:
         while (1) {
             ret = nc_read_until(session, "\n#", 0, inact_timeout, &ts_act_timeout, NULL);
             if (ret == -1) {
-                goto error;
+                goto cleanup;
             }
             ret = nc_read_until(session, "\n", 0, inact_timeout, &ts_act_timeout, &chunk);
             if (ret == -1) {
-                goto error;
+                goto cleanup;
             }
 
             if (!strcmp(chunk, "#\n")) {
                 /* end of chunked framing message */
                 free(chunk);
-                if (!msg) {
+                if (!len) {
                     ERR("Session %u: invalid frame chunk delimiters.", session->id);
                     goto malformed_msg;
                 }
@@ -325,193 +1327,77 @@ nc_read_msg(struct nc_session *session, struct lyxml_elem **data)
                 ERR("Session %u: invalid frame chunk size detected, fatal error.", session->id);
                 goto malformed_msg;
             }
+            len += chunk_len;
 
-            /* now we have size of next chunk, so read the chunk */
-            ret = nc_read_chunk(session, chunk_len, inact_timeout, &ts_act_timeout, &chunk);
-            if (ret == -1) {
-                goto error;
-            }
+            /* pass the chunk to the splitter block by block */
+            while (chunk_len) {
+                count = (chunk_len < BUFFERSIZE ? chunk_len : BUFFERSIZE);
+                ret = nc_read(session, buf, count, inact_timeout, &ts_act_timeout);
+                if (ret == -1) {
+                    goto cleanup;
+                }
+                if (nc_split_feed(&split, buf, count)) {
+                    goto cleanup;
+                }
+                chunk_len -= count;
 
-            /* realloc message buffer, remember to count terminating null byte */
-            msg = realloc(msg, len + chunk_len + 1);
-            if (!msg) {
-                ERRMEM;
-                goto error;
+                nc_gettimespec(&ts_act_timeout);
+                nc_addtimespec(&ts_act_timeout, NC_READ_ACT_TIMEOUT * 1000);
             }
-            memcpy(msg + len, chunk, chunk_len);
-            len += chunk_len;
-            msg[len] = '\0';
-            free(chunk);
         }
-
         break;
     }
-    DBG("Session %u: received message:\n%s\n", session->id, msg);
 
-    /* build XML tree */
-    *data = lyxml_parse_mem(session->ctx, msg, 0);
+    if (split.depth || split.frag || (split.state != NC_SPLIT_TEXT) || !split.envelope.len) {
+        goto malformed_msg;
+    }
+    DBG("Session %u: received message (data subtrees omitted):\n%s\n", session->id, split.envelope.data);
+
+    /* build XML tree of the rest of the message */
+    *data = lyxml_parse_mem(session->ctx, split.envelope.data, 0);
     if (!*data) {
         goto malformed_msg;
     } else if (!(*data)->ns) {
         ERR("Session %u: invalid message root element (invalid namespace).", session->id);
         goto malformed_msg;
     }
-    free(msg);
-    msg = NULL;
 
-    /* get and return message type */
-    if (!strcmp((*data)->ns->value, NC_NS_BASE)) {
-        if (!strcmp((*data)->name, "rpc")) {
-            return NC_MSG_RPC;
-        } else if (!strcmp((*data)->name, "rpc-reply")) {
-            return NC_MSG_REPLY;
-        } else if (!strcmp((*data)->name, "hello")) {
-            return NC_MSG_HELLO;
-        } else {
-            ERR("Session %u: invalid message root element (invalid name \"%s\").", session->id, (*data)->name);
-            goto malformed_msg;
-        }
-    } else if (!strcmp((*data)->ns->value, NC_NS_NOTIF)) {
-        if (!strcmp((*data)->name, "notification")) {
-            return NC_MSG_NOTIF;
-        } else {
-            ERR("Session %u: invalid message root element (invalid name \"%s\").", session->id, (*data)->name);
-            goto malformed_msg;
-        }
-    } else {
-        ERR("Session %u: invalid message root element (invalid namespace \"%s\").", session->id, (*data)->ns->value);
+    msgtype = nc_read_msg_type(session, *data);
+    if ((msgtype != NC_MSG_ERROR) && split.clb_ret) {
+        ERR("Session %u: processing of a received data subtree failed.", session->id);
+        msgtype = NC_MSG_ERROR;
+    } else if (msgtype == NC_MSG_ERROR) {
         goto malformed_msg;
     }
+    goto cleanup;
 
 malformed_msg:
     ERR("Session %u: malformed message received.", session->id);
-    if ((session->side == NC_SERVER) && (session->version == NC_VERSION_11)) {
-        /* NETCONF version 1.1 defines sending error reply from the server (RFC 6241 sec. 3) */
-        reply = nc_server_reply_err(nc_err(NC_ERR_MALFORMED_MSG));
-
-        if (nc_write_msg(session, NC_MSG_REPLY, NULL, reply) == -1) {
-            ERR("Session %u: unable to send a \"Malformed message\" error reply, terminating session.", session->id);
-            if (session->status != NC_STATUS_INVALID) {
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_OTHER;
-            }
-        }
-        nc_server_reply_free(reply);
-    }
-
-error:
-    /* cleanup */
-    free(msg);
-    free(*data);
-    *data = NULL;
-
-    return NC_MSG_ERROR;
-}
-
-/* return -1 means either poll error or that session was invalidated (socket error), EINTR is handled inside */
-static int
-nc_read_poll(struct nc_session *session, int timeout)
-{
-    sigset_t sigmask, origmask;
-    int ret = -2;
-    struct pollfd fds;
-
-    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
-        ERR("Session %u: invalid session to poll.", session->id);
-        return -1;
-    }
-
-    switch (session->ti_type) {
-#ifdef NC_ENABLED_SSH
-    case NC_TI_LIBSSH:
-        /* EINTR is handled, it resumes waiting */
-        ret = ssh_channel_poll_timeout(session->ti.libssh.channel, timeout, 0);
-        if (ret == SSH_ERROR) {
-            ERR("Session %u: SSH channel poll error (%s).", session->id,
-                ssh_get_error(session->ti.libssh.session));
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_OTHER;
-            return -1;
-        } else if (ret == SSH_EOF) {
-            ERR("Session %u: SSH channel unexpected EOF.", session->id);
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_DROPPED;
-            return -1;
-        } else if (ret > 0) {
-            /* fake it */
-            ret = 1;
-            fds.revents = POLLIN;
-        } else { /* ret == 0 */
-            fds.revents = 0;
-        }
-        break;
-#endif
-#ifdef NC_ENABLED_TLS
-    case NC_TI_OPENSSL:
-        ret = SSL_pending(session->ti.tls);
-        if (ret) {
-            /* some buffered TLS data available */
-            ret = 1;
-            fds.revents = POLLIN;
-            break;
-        }
-
-        fds.fd = SSL_get_fd(session->ti.tls);
-        /* fallthrough */
-#endif
-    case NC_TI_FD:
-        if (session->ti_type == NC_TI_FD) {
-            fds.fd = session->ti.fd.in;
-        }
-
-        fds.events = POLLIN;
-        fds.revents = 0;
-
-        sigfillset(&sigmask);
-        pthread_sigmask(SIG_SETMASK, &sigmask, &origmask);
-        ret = poll(&fds, 1, timeout);
-        pthread_sigmask(SIG_SETMASK, &origmask, NULL);
-
-        break;
 
-    default:
-        ERRINT;
-        return -1;
+cleanup:
+    if (msgtype == NC_MSG_ERROR) {
+        lyxml_free(session->ctx, *data);
+        *data = NULL;
     }
-
-    /* process the poll result, unified ret meaning for poll and ssh_channel poll */
-    if (ret < 0) {
-        /* poll failed - something really bad happened, close the session */
-        ERR("Session %u: poll error (%s).", session->id, strerror(errno));
-        session->status = NC_STATUS_INVALID;
-        session->term_reason = NC_SESSION_TERM_OTHER;
-        return -1;
-    } else { /* status > 0 */
-        /* in case of standard (non-libssh) poll, there still can be an error */
-        if (fds.revents & POLLHUP) {
-            ERR("Session %u: communication channel unexpectedly closed.", session->id);
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_DROPPED;
-            return -1;
-        }
-        if (fds.revents & POLLERR) {
-            ERR("Session %u: communication channel error.", session->id);
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_OTHER;
-            return -1;
-        }
+    free(split.envelope.data);
+    free(split.tag.data);
+    free(split.subtree.data);
+    for (i = 0; i < split.ns_count; ++i) {
+        free(split.ns[i].decl);
     }
+    free(split.ns);
 
-    return ret;
+    return msgtype;
 }
 
 /* return NC_MSG_ERROR can change session status */
 NC_MSG_TYPE
-nc_read_msg_poll(struct nc_session *session, int timeout, struct lyxml_elem **data)
+nc_read_msg_split_poll(struct nc_session *session, int timeout, uint64_t msgid,
+                       int (*clb)(const char *xml, size_t len, void *arg), void *clb_arg, struct lyxml_elem **data)
 {
     int ret;
 
-    assert(data);
+    assert(data && clb);
     *data = NULL;
 
     if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
@@ -528,7 +1414,7 @@ nc_read_msg_poll(struct nc_session *session, int timeout, struct lyxml_elem **da
         return NC_MSG_ERROR;
     }
 
-    return nc_read_msg(session, data);
+    return nc_read_msg_split(session, msgid, clb, clb_arg, data);
 }
 
 /* does not really log, only fatal errors */
@@ -1016,7 +1902,7 @@ nc_write_msg(struct nc_session *session, int type, ...)
     struct nc_server_reply_error *error_rpl;
     char *buf = NULL;
     struct wclb_arg arg;
-    const char **capabilities;
+    const char **capabilities, *cpblts_xml, *content_xml;
     uint32_t *sid = NULL, i;
     int wd = 0;
 
@@ -1037,6 +1923,7 @@ nc_write_msg(struct nc_session *session, int type, ...)
     case NC_MSG_RPC:
         content = va_arg(ap, struct lyd_node *);
         attrs = va_arg(ap, const char *);
+        content_xml = va_arg(ap, const char *);
 
         count = asprintf(&buf, "<rpc xmlns=\"%s\" message-id=\"%"PRIu64"\"%s>",
                          NC_NS_BASE, session->opts.client.msgid + 1, attrs ? attrs : "");
@@ -1048,7 +1935,11 @@ nc_write_msg(struct nc_session *session, int type, ...)
         nc_write_clb((void *)&arg, buf, count, 0);
         free(buf);
 
-        lyd_print_clb(nc_write_xmlclb, (void *)&arg, content, LYD_XML, LYP_WITHSIBLINGS | LYP_NETCONF);
+        if (content) {
+            lyd_print_clb(nc_write_xmlclb, (void *)&arg, content, LYD_XML, LYP_WITHSIBLINGS | LYP_NETCONF);
+        } else {
+            nc_write_clb((void *)&arg, content_xml, strlen(content_xml), 0);
+        }
         nc_write_clb((void *)&arg, "</rpc>", 6, 0);
 
         session->opts.client.msgid++;
@@ -1145,6 +2036,7 @@ nc_write_msg(struct nc_session *session, int type, ...)
         }
         capabilities = va_arg(ap, const char **);
         sid = va_arg(ap, uint32_t*);
+        cpblts_xml = va_arg(ap, const char *);
 
         count = asprintf(&buf, "<hello xmlns=\"%s\"><capabilities>", NC_NS_BASE);
         if (count == -1) {
@@ -1154,10 +2046,14 @@ nc_write_msg(struct nc_session *session, int type, ...)
         }
         nc_write_clb((void *)&arg, buf, count, 0);
         free(buf);
-        for (i = 0; capabilities[i]; i++) {
-            nc_write_clb((void *)&arg, "<capability>", 12, 0);
-            nc_write_clb((void *)&arg, capabilities[i], strlen(capabilities[i]), 1);
-            nc_write_clb((void *)&arg, "</capability>", 13, 0);
+        if (cpblts_xml) {
+            nc_write_clb((void *)&arg, cpblts_xml, strlen(cpblts_xml), 0);
+        } else {
+            for (i = 0; capabilities[i]; i++) {
+                nc_write_clb((void *)&arg, "<capability>", 12, 0);
+                nc_write_clb((void *)&arg, capabilities[i], strlen(capabilities[i]), 1);
+                nc_write_clb((void *)&arg, "</capability>", 13, 0);
+            }
         }
         if (sid) {
             count = asprintf(&buf, "</capabilities><session-id>%u</session-id></hello>", *sid);
@@ -60,6 +60,7 @@ nc_rpc_act_generic(const struct lyd_node *data, NC_PARAMTYPE paramtype)
         rpc->content.data = (struct lyd_node *)data;
     }
     rpc->free = (paramtype == NC_PARAMTYPE_CONST ? 0 : 1);
+    rpc->raw = 0;
 
     return (struct nc_rpc *)rpc;
 }
@@ -88,10 +89,25 @@ nc_rpc_act_generic_xml(const char *xml_str, NC_PARAMTYPE paramtype)
         rpc->content.xml_str = (char *)xml_str;
     }
     rpc->free = (paramtype == NC_PARAMTYPE_CONST ? 0 : 1);
+    rpc->raw = 0;
 
     return (struct nc_rpc *)rpc;
 }
 
+API int
+nc_rpc_act_generic_set_raw(struct nc_rpc *rpc, int raw)
+{
+    struct nc_rpc_act_generic *rpc_gen = (struct nc_rpc_act_generic *)rpc;
+
+    if (!rpc || (rpc->type != NC_RPC_ACT_GENERIC) || rpc_gen->has_data) {
+        ERRARG("rpc");
+        return -1;
+    }
+
+    rpc_gen->raw = (raw ? 1 : 0);
+    return 0;
+}
+
 API struct nc_rpc *
 nc_rpc_getconfig(NC_DATASTORE source, const char *filter, NC_WD_MODE wd_mode, NC_PARAMTYPE paramtype)
 {
@@ -688,3 +704,14 @@ nc_notif_free(struct nc_notif *notif)
     lyd_free(notif->tree);
     free(notif);
 }
+
+API void
+nc_notif_raw_free(struct nc_notif_raw *notif)
+{
+    if (!notif) {
+        return;
+    }
+
+    free(notif->xml);
+    free(notif);
+}
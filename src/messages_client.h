@@ -178,6 +178,17 @@ struct nc_notif {
     struct lyd_node *tree; /**< libyang data tree of the message */
 };
 
+/**
+ * @brief NETCONF client notification object not parsed by libyang
+ */
+struct nc_notif_raw {
+    const char *datetime;  /**< eventTime of the notification */
+    const char *name;      /**< name of the notification root element */
+    const char *ns;        /**< namespace of the notification root element */
+    char *xml;             /**< the whole \<notification\> message as received */
+    size_t xml_len;        /**< length of \p xml */
+};
+
 /**
  * @brief Get the type of the RPC
  *
@@ -213,6 +224,20 @@ struct nc_rpc *nc_rpc_act_generic(const struct lyd_node *data, NC_PARAMTYPE para
  */
 struct nc_rpc *nc_rpc_act_generic_xml(const char *xml_str, NC_PARAMTYPE paramtype);
 
+/**
+ * @brief Set a generic RPC created by nc_rpc_act_generic_xml() to be sent verbatim.
+ *
+ * The XML string is then written inside the \<rpc\> element as it is, without being parsed
+ * and validated, so the schema of the RPC does not even have to be in the session context.
+ * It is up to the caller to provide a well-formed operation with the correct namespace.
+ * Only \<ok\> and \<rpc-error\> replies can be parsed without the schema.
+ *
+ * @param[in] rpc Generic RPC created from an XML string.
+ * @param[in] raw Whether to send the XML string verbatim or not.
+ * @return 0 on success, -1 on error.
+ */
+int nc_rpc_act_generic_set_raw(struct nc_rpc *rpc, int raw);
+
 /**
  * @brief Create NETCONF RPC \<get-config\>
  *
@@ -465,4 +490,11 @@ void nc_reply_free(struct nc_reply *reply);
  */
 void nc_notif_free(struct nc_notif *notif);
 
+/**
+ * @brief Free the raw NETCONF Notification object.
+ *
+ * @param[in] notif Object to free.
+ */
+void nc_notif_raw_free(struct nc_notif_raw *notif);
+
 #endif /* NC_MESSAGES_CLIENT_H_ */
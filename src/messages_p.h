@@ -93,6 +93,7 @@ struct nc_rpc_act_generic {
         char *xml_str;          /**< raw XML string */
     } content;
     char free;
+    char raw;               /**< send content.xml_str verbatim, without parsing it */
 };
 
 struct nc_rpc_getconfig {
@@ -268,6 +268,11 @@ nc_session_unlock(struct nc_session *session, int timeout, const char *func)
     *session->ti_inuse = 0;
     pthread_cond_signal(session->ti_cond);
 
+    if (session->side == NC_CLIENT) {
+        /* a reactor may be waiting for the session */
+        nc_client_reactor_session_unlocked(session);
+    }
+
     if (!ret) {
         /* UNLOCK */
         ret = pthread_mutex_unlock(session->ti_lock);
@@ -413,7 +418,7 @@ nc_send_msg(struct nc_session *session, struct lyd_node *op)
         return NC_MSG_ERROR;
     }
 
-    r = nc_write_msg(session, NC_MSG_RPC, op, NULL);
+    r = nc_write_msg(session, NC_MSG_RPC, op, NULL, NULL);
 
     if (r) {
         return NC_MSG_ERROR;
@@ -450,6 +455,11 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         pthread_join(tid, NULL);
     }
 
+    /* remove from a reactor, pending asynchronous RPCs fail */
+    if ((session->side == NC_CLIENT) && session->opts.client.reactor) {
+        nc_client_reactor_session_free(session);
+    }
+
     if (session->ti_lock) {
         r = nc_session_lock(session, NC_SESSION_FREE_LOCK_TIMEOUT, __func__);
         if (r == -1) {
@@ -475,15 +485,26 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
             contiter = contiter->next;
             free(p);
         }
+        session->opts.client.notifs = NULL;
+        session->opts.client.notifs_tail = NULL;
+        session->opts.client.notif_count = 0;
+        session->opts.client.notif_size = 0;
 
         /* rpc replies */
-        for (contiter = session->opts.client.replies; contiter; ) {
-            lyxml_free(session->ctx, contiter->msg);
+        for (i = 0; (unsigned)i < session->opts.client.reply_buckets; ++i) {
+            for (contiter = session->opts.client.replies[i]; contiter; ) {
+                lyxml_free(session->ctx, contiter->msg);
 
-            p = contiter;
-            contiter = contiter->next;
-            free(p);
+                p = contiter;
+                contiter = contiter->next;
+                free(p);
+            }
         }
+        free(session->opts.client.replies);
+        session->opts.client.replies = NULL;
+        session->opts.client.reply_buckets = 0;
+        session->opts.client.reply_count = 0;
+        session->opts.client.reply_size = 0;
 
         /* send closing info to the other side */
         ietfnc = ly_ctx_get_module(session->ctx, "ietf-netconf", NULL);
@@ -524,6 +545,10 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
             }
             free(session->opts.client.cpblts);
         }
+        free(session->opts.client.cpblt_idx);
+        free(session->opts.client.cpblt_sorted);
+        free(session->opts.client.discard);
+        free(session->opts.client.dropped);
     }
 
     if (session->data && data_free) {
@@ -660,6 +685,8 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
 
     if (!(session->flags & NC_SESSION_SHAREDCTX)) {
         ly_ctx_destroy(session->ctx, NULL);
+    } else if ((session->side == NC_CLIENT) && (session->flags & NC_SESSION_CLIENT_POOLCTX)) {
+        nc_client_ctx_pool_release(session->ctx);
     }
 
     if (session->side == NC_SERVER) {
@@ -673,6 +700,9 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         }
     }
 
+    /* message read only partially */
+    free(session->rd.msg);
+
     free(session);
 }
 
@@ -717,8 +747,8 @@ add_cpblt(struct ly_ctx *ctx, const char *capab, const char ***cpblts, int *size
     ++(*count);
 }
 
-API const char **
-nc_server_get_cpblts(struct ly_ctx *ctx)
+static const char **
+nc_server_create_cpblts(struct ly_ctx *ctx)
 {
     struct lyd_node *child, *child2, *yanglib;
     struct lyd_node_leaf_list **features = NULL, **deviations = NULL, *ns = NULL, *rev = NULL, *name = NULL, *module_set_id = NULL;
@@ -729,11 +759,6 @@ nc_server_get_cpblts(struct ly_ctx *ctx)
 #define NC_CPBLT_BUF_LEN 512
     char str[NC_CPBLT_BUF_LEN];
 
-    if (!ctx) {
-        ERRARG("ctx");
-        return NULL;
-    }
-
     yanglib = ly_ctx_info(ctx);
     if (!yanglib) {
         ERR("Failed to get ietf-yang-library data from the context.");
@@ -934,6 +959,284 @@ nc_server_get_cpblts(struct ly_ctx *ctx)
     return cpblts;
 }
 
+/* cheap signature of the modules in a context and their features, changes whenever the capabilities may */
+static uint32_t
+nc_server_ctx_signature(struct ly_ctx *ctx)
+{
+    const struct lys_module *mod;
+    uint32_t idx = 0, sig = 2166136261U;
+    uint8_t i;
+
+    /* FNV-1a-like mixing of the module identities and states */
+#define NC_SIG_MIX(val) sig = (sig ^ (uint32_t)(val)) * 16777619U
+    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
+        NC_SIG_MIX((uintptr_t)mod);
+        NC_SIG_MIX((uintptr_t)mod->name);
+        NC_SIG_MIX(mod->implemented);
+        NC_SIG_MIX(mod->rev_size);
+        NC_SIG_MIX(mod->features_size);
+        for (i = 0; i < mod->features_size; ++i) {
+            NC_SIG_MIX(mod->features[i].flags & LYS_FENABLED ? 1 : 0);
+        }
+    }
+    NC_SIG_MIX(idx);
+#undef NC_SIG_MIX
+
+    return sig;
+}
+
+static char *
+nc_server_cpblts_to_xml(const char **cpblts)
+{
+    char *xml, *p;
+    const char *c;
+    size_t len = 1;
+    int i;
+
+    for (i = 0; cpblts[i]; ++i) {
+        len += 12 + 13;
+        for (c = cpblts[i]; *c; ++c) {
+            if (*c == '&') {
+                len += 5;
+            } else if ((*c == '<') || (*c == '>')) {
+                len += 4;
+            } else {
+                ++len;
+            }
+        }
+    }
+
+    xml = malloc(len);
+    if (!xml) {
+        ERRMEM;
+        return NULL;
+    }
+
+    p = xml;
+    for (i = 0; cpblts[i]; ++i) {
+        p = stpcpy(p, "<capability>");
+        for (c = cpblts[i]; *c; ++c) {
+            switch (*c) {
+            case '&':
+                p = stpcpy(p, "&amp;");
+                break;
+            case '<':
+                p = stpcpy(p, "&lt;");
+                break;
+            case '>':
+                p = stpcpy(p, "&gt;");
+                break;
+            default:
+                *(p++) = *c;
+                break;
+            }
+        }
+        p = stpcpy(p, "</capability>");
+    }
+    *p = '\0';
+
+    return xml;
+}
+
+void
+nc_server_clear_cpblts_cache(void)
+{
+    int i;
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.cpblt_lock);
+
+    if (server_opts.cpblts) {
+        for (i = 0; server_opts.cpblts[i]; ++i) {
+            lydict_remove(server_opts.ctx, server_opts.cpblts[i]);
+        }
+        free(server_opts.cpblts);
+        server_opts.cpblts = NULL;
+    }
+    free(server_opts.cpblts_xml);
+    server_opts.cpblts_xml = NULL;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.cpblt_lock);
+}
+
+/* cpblt_lock is expected to be held */
+static int
+nc_server_update_cpblts_cache(void)
+{
+    const char **cpblts;
+    char *xml;
+    uint32_t sig;
+    int i;
+
+    sig = nc_server_ctx_signature(server_opts.ctx);
+    if (server_opts.cpblts && (server_opts.cpblts_ctx_sig == sig)) {
+        /* still valid */
+        return 0;
+    }
+
+    cpblts = nc_server_create_cpblts(server_opts.ctx);
+    if (!cpblts) {
+        return -1;
+    }
+    xml = nc_server_cpblts_to_xml(cpblts);
+    if (!xml) {
+        for (i = 0; cpblts[i]; ++i) {
+            lydict_remove(server_opts.ctx, cpblts[i]);
+        }
+        free(cpblts);
+        return -1;
+    }
+
+    if (server_opts.cpblts) {
+        for (i = 0; server_opts.cpblts[i]; ++i) {
+            lydict_remove(server_opts.ctx, server_opts.cpblts[i]);
+        }
+        free(server_opts.cpblts);
+    }
+    free(server_opts.cpblts_xml);
+
+    server_opts.cpblts = cpblts;
+    server_opts.cpblts_xml = xml;
+    server_opts.cpblts_ctx_sig = sig;
+    return 0;
+}
+
+API const char **
+nc_server_get_cpblts(struct ly_ctx *ctx)
+{
+    const char **cpblts = NULL;
+    int i, count;
+
+    if (!ctx) {
+        ERRARG("ctx");
+        return NULL;
+    }
+
+    if (ctx != server_opts.ctx) {
+        return nc_server_create_cpblts(ctx);
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.cpblt_lock);
+
+    if (nc_server_update_cpblts_cache()) {
+        goto cleanup;
+    }
+
+    /* return a copy of the cached capabilities */
+    for (count = 0; server_opts.cpblts[count]; ++count);
+    cpblts = malloc((count + 1) * sizeof *cpblts);
+    if (!cpblts) {
+        ERRMEM;
+        goto cleanup;
+    }
+    for (i = 0; i < count; ++i) {
+        cpblts[i] = lydict_insert(ctx, server_opts.cpblts[i], 0);
+    }
+    cpblts[count] = NULL;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.cpblt_lock);
+
+    return cpblts;
+}
+
+uint32_t
+nc_cpblt_hash(const char *uri, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < len; ++i) {
+        hash ^= (unsigned char)uri[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static int
+cpblt_cmp(const void *cpblt1, const void *cpblt2)
+{
+    return strcmp(*(const char **)cpblt1, *(const char **)cpblt2);
+}
+
+/* index the server capabilities of a client session */
+static int
+index_cpblts(struct nc_session *session)
+{
+    static const struct {
+        const char *uri;
+        uint32_t bit;
+    } known[] = {
+        {"urn:ietf:params:netconf:base:1.0", NC_CPBLT_BASE_10},
+        {"urn:ietf:params:netconf:base:1.1", NC_CPBLT_BASE_11},
+        {"urn:ietf:params:netconf:capability:writable-running:1.0", NC_CPBLT_WRITABLE_RUNNING},
+        {"urn:ietf:params:netconf:capability:candidate:1.0", NC_CPBLT_CANDIDATE},
+        {"urn:ietf:params:netconf:capability:confirmed-commit:1.1", NC_CPBLT_CONFIRMED_COMMIT},
+        {"urn:ietf:params:netconf:capability:rollback-on-error:1.0", NC_CPBLT_ROLLBACK_ON_ERROR},
+        {"urn:ietf:params:netconf:capability:validate:1.1", NC_CPBLT_VALIDATE},
+        {"urn:ietf:params:netconf:capability:startup:1.0", NC_CPBLT_STARTUP},
+        {"urn:ietf:params:netconf:capability:url:1.0", NC_CPBLT_URL},
+        {"urn:ietf:params:netconf:capability:xpath:1.0", NC_CPBLT_XPATH},
+        {"urn:ietf:params:netconf:capability:with-defaults:1.0", NC_CPBLT_WITH_DEFAULTS},
+        {"urn:ietf:params:netconf:capability:notification:1.0", NC_CPBLT_NOTIFICATION},
+        {"urn:ietf:params:netconf:capability:interleave:1.0", NC_CPBLT_INTERLEAVE},
+        {"urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring", NC_CPBLT_MONITORING}
+    };
+    char **cpblts = session->opts.client.cpblts;
+    uint32_t i, j, count, size, slot;
+    size_t len;
+
+    for (count = 0; cpblts[count]; ++count);
+
+    /* keep the load factor at most 1/2 */
+    for (size = 8; size < 2 * count; size *= 2);
+    session->opts.client.cpblt_idx = calloc(size, sizeof *session->opts.client.cpblt_idx);
+    if (!session->opts.client.cpblt_idx) {
+        ERRMEM;
+        return -1;
+    }
+    session->opts.client.cpblt_idx_size = size;
+
+    /* prefixes of capabilities are found by a binary search */
+    session->opts.client.cpblt_sorted = malloc((count + 1) * sizeof *session->opts.client.cpblt_sorted);
+    if (!session->opts.client.cpblt_sorted) {
+        ERRMEM;
+        return -1;
+    }
+    memcpy(session->opts.client.cpblt_sorted, cpblts, (count + 1) * sizeof *cpblts);
+    qsort(session->opts.client.cpblt_sorted, count, sizeof *session->opts.client.cpblt_sorted, cpblt_cmp);
+    session->opts.client.cpblt_count = count;
+
+    for (i = 0; i < count; ++i) {
+        len = strcspn(cpblts[i], "?");
+
+        for (j = 0; j < sizeof known / sizeof *known; ++j) {
+            if (!strncmp(cpblts[i], known[j].uri, len) && !known[j].uri[len]) {
+                session->opts.client.cpblt_bits |= known[j].bit;
+                break;
+            }
+        }
+
+        /* linear probing, duplicates are skipped so that the first one is found */
+        for (slot = nc_cpblt_hash(cpblts[i], len) & (size - 1); session->opts.client.cpblt_idx[slot];
+                slot = (slot + 1) & (size - 1)) {
+            j = session->opts.client.cpblt_idx[slot] - 1;
+            if (!strncmp(cpblts[j], cpblts[i], len) && ((cpblts[j][len] == '\0') || (cpblts[j][len] == '?'))) {
+                break;
+            }
+        }
+        if (!session->opts.client.cpblt_idx[slot]) {
+            session->opts.client.cpblt_idx[slot] = i + 1;
+        }
+    }
+
+    return 0;
+}
+
 static int
 parse_cpblts(struct lyxml_elem *xml, char ***list)
 {
@@ -1013,7 +1316,7 @@ nc_send_client_hello(struct nc_session *session)
     cpblts[1] = lydict_insert(session->ctx, "urn:ietf:params:netconf:base:1.1", 0);
     cpblts[2] = NULL;
 
-    r = nc_write_msg(session, NC_MSG_HELLO, cpblts, NULL);
+    r = nc_write_msg(session, NC_MSG_HELLO, cpblts, NULL, NULL);
 
     for (i = 0; cpblts[i]; ++i) {
         lydict_remove(session->ctx, cpblts[i]);
@@ -1032,15 +1335,37 @@ nc_send_server_hello(struct nc_session *session)
 {
     int r, i;
     const char **cpblts;
+    char *cpblts_xml = NULL;
 
-    cpblts = nc_server_get_cpblts(session->ctx);
+    if (session->ctx == server_opts.ctx) {
+        /* use the cached capabilities, the lock cannot be held while writing */
+        /* LOCK */
+        pthread_mutex_lock(&server_opts.cpblt_lock);
+        if (!nc_server_update_cpblts_cache()) {
+            cpblts_xml = strdup(server_opts.cpblts_xml);
+        }
+        /* UNLOCK */
+        pthread_mutex_unlock(&server_opts.cpblt_lock);
 
-    r = nc_write_msg(session, NC_MSG_HELLO, cpblts, &session->id);
+        if (!cpblts_xml) {
+            return NC_MSG_ERROR;
+        }
 
-    for (i = 0; cpblts[i]; ++i) {
-        lydict_remove(session->ctx, cpblts[i]);
+        r = nc_write_msg(session, NC_MSG_HELLO, NULL, &session->id, cpblts_xml);
+        free(cpblts_xml);
+    } else {
+        cpblts = nc_server_get_cpblts(session->ctx);
+        if (!cpblts) {
+            return NC_MSG_ERROR;
+        }
+
+        r = nc_write_msg(session, NC_MSG_HELLO, cpblts, &session->id, NULL);
+
+        for (i = 0; cpblts[i]; ++i) {
+            lydict_remove(session->ctx, cpblts[i]);
+        }
+        free(cpblts);
     }
-    free(cpblts);
 
     if (r) {
         return NC_MSG_ERROR;
@@ -1096,6 +1421,10 @@ nc_recv_client_hello(struct nc_session *session)
                 goto error;
             }
             session->version = ver;
+
+            if (index_cpblts(session)) {
+                goto error;
+            }
         }
 
         if (!session->id) {
@@ -15,9 +15,11 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -33,9 +35,18 @@
 #include "session_client.h"
 #include "messages_client.h"
 
+#ifdef HAVE_EPOLL
+#   include <sys/epoll.h>
+#   include <sys/eventfd.h>
+#endif
+
 static const char *ncds2str[] = {NULL, "config", "url", "running", "startup", "candidate"};
 
-struct nc_client_opts client_opts;
+struct nc_client_opts client_opts = {
+    .ctx_pool_lock = PTHREAD_MUTEX_INITIALIZER,
+    .shared_ctx_lock = PTHREAD_MUTEX_INITIALIZER,
+    .reply_queue_max = NC_CLIENT_REPLY_QUEUE_MAX
+};
 
 API int
 nc_client_set_schema_searchpath(const char *path)
@@ -63,33 +74,63 @@ nc_client_get_schema_searchpath(void)
     return client_opts.schema_searchpath;
 }
 
+API int
+nc_client_set_schema_cache_dir(const char *path)
+{
+    if (client_opts.schema_cache_dir) {
+        free(client_opts.schema_cache_dir);
+    }
+
+    if (path) {
+        client_opts.schema_cache_dir = strdup(path);
+        if (!client_opts.schema_cache_dir) {
+            ERRMEM;
+            return 1;
+        }
+    } else {
+        client_opts.schema_cache_dir = NULL;
+    }
+
+    return 0;
+}
+
+API const char *
+nc_client_get_schema_cache_dir(void)
+{
+    return client_opts.schema_cache_dir;
+}
+
+/* value of a module capability parameter, NULL if not present */
+static char *
+module_cpblt_param(const char *module_cpblt, const char *param)
+{
+    const char *ptr, *ptr2;
+
+    ptr = strstr(module_cpblt, param);
+    if (!ptr) {
+        return NULL;
+    }
+
+    ptr += strlen(param);
+    ptr2 = strchr(ptr, '&');
+    if (!ptr2) {
+        ptr2 = ptr + strlen(ptr);
+    }
+    return strndup(ptr, ptr2 - ptr);
+}
+
 /* SCHEMAS_DIR not used (implicitly) */
 static int
 ctx_check_and_load_model(struct nc_session *session, const char *module_cpblt)
 {
     const struct lys_module *module;
     char *ptr, *ptr2;
-    char *model_name, *revision = NULL, *features = NULL;
+    char *model_name, *revision, *features;
 
     assert(!strncmp(module_cpblt, "module=", 7));
 
-    ptr = (char *)module_cpblt + 7;
-    ptr2 = strchr(ptr, '&');
-    if (!ptr2) {
-        ptr2 = ptr + strlen(ptr);
-    }
-    model_name = strndup(ptr, ptr2 - ptr);
-
-    /* parse revision */
-    ptr = strstr(module_cpblt, "revision=");
-    if (ptr) {
-        ptr += 9;
-        ptr2 = strchr(ptr, '&');
-        if (!ptr2) {
-            ptr2 = ptr + strlen(ptr);
-        }
-        revision = strndup(ptr, ptr2 - ptr);
-    }
+    model_name = module_cpblt_param(module_cpblt, "module=");
+    revision = module_cpblt_param(module_cpblt, "revision=");
 
     /* load module if needed */
     module = ly_ctx_get_module(session->ctx, model_name, revision);
@@ -112,15 +153,7 @@ ctx_check_and_load_model(struct nc_session *session, const char *module_cpblt)
     }
 
     /* parse features */
-    ptr = strstr(module_cpblt, "features=");
-    if (ptr) {
-        ptr += 9;
-        ptr2 = strchr(ptr, '&');
-        if (!ptr2) {
-            ptr2 = ptr + strlen(ptr);
-        }
-        features = strndup(ptr, ptr2 - ptr);
-    }
+    features = module_cpblt_param(module_cpblt, "features=");
 
     /* enable features */
     if (features) {
@@ -149,9 +182,8 @@ ctx_check_and_load_model(struct nc_session *session, const char *module_cpblt)
 
 /* SCHEMAS_DIR used as the last resort */
 static int
-ctx_check_and_load_ietf_netconf(struct ly_ctx *ctx, char **cpblts)
+ctx_check_and_load_ietf_netconf(struct ly_ctx *ctx, uint32_t cpblt_bits)
 {
-    int i;
     const struct lys_module *ietfnc;
 
     ietfnc = ly_ctx_get_module(ctx, "ietf-netconf", NULL);
@@ -167,77 +199,262 @@ ctx_check_and_load_ietf_netconf(struct ly_ctx *ctx, char **cpblts)
     }
 
     /* set supported capabilities from ietf-netconf */
-    for (i = 0; cpblts[i]; ++i) {
-        if (!strncmp(cpblts[i], "urn:ietf:params:netconf:capability:", 35)) {
-            if (!strncmp(cpblts[i] + 35, "writable-running", 16)) {
-                lys_features_enable(ietfnc, "writable-running");
-            } else if (!strncmp(cpblts[i] + 35, "candidate", 9)) {
-                lys_features_enable(ietfnc, "candidate");
-            } else if (!strcmp(cpblts[i] + 35, "confirmed-commit:1.1")) {
-                lys_features_enable(ietfnc, "confirmed-commit");
-            } else if (!strncmp(cpblts[i] + 35, "rollback-on-error", 17)) {
-                lys_features_enable(ietfnc, "rollback-on-error");
-            } else if (!strcmp(cpblts[i] + 35, "validate:1.1")) {
-                lys_features_enable(ietfnc, "validate");
-            } else if (!strncmp(cpblts[i] + 35, "startup", 7)) {
-                lys_features_enable(ietfnc, "startup");
-            } else if (!strncmp(cpblts[i] + 35, "url", 3)) {
-                lys_features_enable(ietfnc, "url");
-            } else if (!strncmp(cpblts[i] + 35, "xpath", 5)) {
-                lys_features_enable(ietfnc, "xpath");
+    if (cpblt_bits & NC_CPBLT_WRITABLE_RUNNING) {
+        lys_features_enable(ietfnc, "writable-running");
+    }
+    if (cpblt_bits & NC_CPBLT_CANDIDATE) {
+        lys_features_enable(ietfnc, "candidate");
+    }
+    if (cpblt_bits & NC_CPBLT_CONFIRMED_COMMIT) {
+        lys_features_enable(ietfnc, "confirmed-commit");
+    }
+    if (cpblt_bits & NC_CPBLT_ROLLBACK_ON_ERROR) {
+        lys_features_enable(ietfnc, "rollback-on-error");
+    }
+    if (cpblt_bits & NC_CPBLT_VALIDATE) {
+        lys_features_enable(ietfnc, "validate");
+    }
+    if (cpblt_bits & NC_CPBLT_STARTUP) {
+        lys_features_enable(ietfnc, "startup");
+    }
+    if (cpblt_bits & NC_CPBLT_URL) {
+        lys_features_enable(ietfnc, "url");
+    }
+    if (cpblt_bits & NC_CPBLT_XPATH) {
+        lys_features_enable(ietfnc, "xpath");
+    }
+
+    return 0;
+}
+
+/* user data of libyang_module_clb() */
+struct module_clb_data {
+    struct nc_session *session;
+
+    /* schemas downloaded in advance */
+    struct schema_prefetch {
+        char *name;
+        char *revision;
+        char *data;             /* NULL if the download failed */
+    } *prefetched;
+    uint32_t prefetch_count;
+};
+
+/* FNV-1a hash of schema cache file contents */
+static uint64_t
+schema_cache_hash(const char *data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (; *data; ++data) {
+        hash ^= (unsigned char)*data;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* cached schema file path, <dir>/<name>@<revision>.yang[<suffix>] */
+static char *
+schema_cache_path(const char *name, const char *revision, const char *suffix)
+{
+    char *path;
+    size_t len;
+
+    len = strlen(client_opts.schema_cache_dir) + 1 + strlen(name) + 1 + strlen(revision) + 5 + strlen(suffix) + 1;
+    path = malloc(len);
+    if (!path) {
+        ERRMEM;
+        return NULL;
+    }
+    sprintf(path, "%s/%s@%s.yang%s", client_opts.schema_cache_dir, name, revision, suffix);
+
+    return path;
+}
+
+static char *
+schema_cache_read_file(const char *path)
+{
+    struct stat st;
+    char *data;
+    ssize_t r;
+    size_t len = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    data = malloc(st.st_size + 1);
+    if (!data) {
+        ERRMEM;
+        close(fd);
+        return NULL;
+    }
+    while (len < (size_t)st.st_size) {
+        r = read(fd, data + len, st.st_size - len);
+        if (r < 1) {
+            if ((r == -1) && (errno == EINTR)) {
+                continue;
+            }
+            break;
+        }
+        len += r;
+    }
+    close(fd);
+
+    if (len < (size_t)st.st_size) {
+        free(data);
+        return NULL;
+    }
+    data[len] = '\0';
+    return data;
+}
+
+/* write a file atomically so that concurrent readers never see partial data */
+static int
+schema_cache_write_file(const char *path, const char *data)
+{
+    char *tmp_path;
+    size_t len, written = 0;
+    ssize_t r;
+    int fd;
+
+    tmp_path = malloc(strlen(path) + 8);
+    if (!tmp_path) {
+        ERRMEM;
+        return -1;
+    }
+    sprintf(tmp_path, "%s.XXXXXX", path);
+
+    fd = mkstemp(tmp_path);
+    if (fd == -1) {
+        WRN("Failed to create schema cache file \"%s\" (%s).", tmp_path, strerror(errno));
+        free(tmp_path);
+        return -1;
+    }
+    fchmod(fd, 0644);
+
+    len = strlen(data);
+    while (written < len) {
+        r = write(fd, data + written, len - written);
+        if (r == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            break;
         }
+        written += r;
+    }
+    if ((close(fd) == -1) || (written < len) || rename(tmp_path, path)) {
+        WRN("Failed to write schema cache file \"%s\" (%s).", path, strerror(errno));
+        unlink(tmp_path);
+        free(tmp_path);
+        return -1;
     }
 
+    free(tmp_path);
     return 0;
 }
 
+/* returns a cached schema if its content hash matches */
 static char *
-libyang_module_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *submod_rev,
-                   void *user_data, LYS_INFORMAT *format, void (**free_model_data)(void *model_data))
+schema_cache_load(const char *name, const char *revision)
 {
-    struct nc_session *session = (struct nc_session *)user_data;
-    struct nc_rpc *rpc;
-    struct nc_reply *reply;
-    struct nc_reply_data *data_rpl;
-    struct nc_reply_error *error_rpl;
-    struct lyd_node_anydata *get_schema_data;
-    NC_MSG_TYPE msg;
-    char *model_data = NULL;
-    uint64_t msgid;
+    char *path, *data, *hash_str, *ptr;
+    uint64_t hash;
 
-    if (submod_name) {
-        rpc = nc_rpc_getschema(submod_name, submod_rev, "yang", NC_PARAMTYPE_CONST);
-    } else {
-        rpc = nc_rpc_getschema(mod_name, mod_rev, "yang", NC_PARAMTYPE_CONST);
+    path = schema_cache_path(name, revision, "");
+    if (!path) {
+        return NULL;
+    }
+    data = schema_cache_read_file(path);
+    free(path);
+    if (!data) {
+        return NULL;
     }
 
-    while ((msg = nc_send_rpc(session, rpc, 0, &msgid)) == NC_MSG_WOULDBLOCK) {
-        usleep(1000);
+    path = schema_cache_path(name, revision, ".hash");
+    if (!path) {
+        free(data);
+        return NULL;
     }
-    if (msg == NC_MSG_ERROR) {
-        ERR("Session %u: failed to send the <get-schema> RPC.", session->id);
-        nc_rpc_free(rpc);
+    hash_str = schema_cache_read_file(path);
+    free(path);
+    if (!hash_str) {
+        free(data);
         return NULL;
     }
 
+    errno = 0;
+    hash = strtoull(hash_str, &ptr, 16);
+    if (errno || (ptr == hash_str) || (hash != schema_cache_hash(data))) {
+        WRN("Cached schema \"%s@%s\" is corrupted, ignoring it.", name, revision);
+        free(data);
+        data = NULL;
+    }
+    free(hash_str);
+
+    return data;
+}
+
+static void
+schema_cache_store(const char *name, const char *revision, const char *data)
+{
+    char *path, hash_str[17];
+
+    /* write the hash second so that it never matches partially updated data */
+    path = schema_cache_path(name, revision, "");
+    if (!path) {
+        return;
+    }
+    if (schema_cache_write_file(path, data)) {
+        free(path);
+        return;
+    }
+    free(path);
+
+    path = schema_cache_path(name, revision, ".hash");
+    if (!path) {
+        return;
+    }
+    sprintf(hash_str, "%016"PRIx64, schema_cache_hash(data));
+    schema_cache_write_file(path, hash_str);
+    free(path);
+}
+
+/* receive a <get-schema> reply, model_data are set only on success */
+static NC_MSG_TYPE
+get_schema_recv(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, char **model_data)
+{
+    struct nc_reply *reply;
+    struct nc_reply_data *data_rpl;
+    struct nc_reply_error *error_rpl;
+    struct lyd_node_anydata *get_schema_data;
+    NC_MSG_TYPE msg;
+
+    *model_data = NULL;
+
     do {
         msg = nc_recv_reply(session, rpc, msgid, NC_READ_ACT_TIMEOUT * 1000, 0, &reply);
     } while (msg == NC_MSG_NOTIF);
-    nc_rpc_free(rpc);
     if (msg == NC_MSG_WOULDBLOCK) {
         ERR("Session %u: timeout for receiving reply to a <get-schema> expired.", session->id);
-        return NULL;
+        return msg;
     } else if (msg == NC_MSG_ERROR) {
         ERR("Session %u: failed to receive a reply to <get-schema>.", session->id);
-        return NULL;
+        return msg;
     }
 
     switch (reply->type) {
     case NC_RPL_OK:
         ERR("Session %u: unexpected reply OK to a <get-schema> RPC.", session->id);
         nc_reply_free(reply);
-        return NULL;
+        return NC_MSG_REPLY;
     case NC_RPL_DATA:
         /* fine */
         break;
@@ -250,11 +467,11 @@ libyang_module_clb(const char *mod_name, const char *mod_rev, const char *submod
             ERR("Session %u: unexpected reply error to a <get-schema> RPC.", session->id);
         }
         nc_reply_free(reply);
-        return NULL;
+        return NC_MSG_REPLY;
     case NC_RPL_NOTIF:
         ERR("Session %u: unexpected reply notification to a <get-schema> RPC.", session->id);
         nc_reply_free(reply);
-        return NULL;
+        return NC_MSG_REPLY;
     }
 
     data_rpl = (struct nc_reply_data *)reply;
@@ -262,19 +479,19 @@ libyang_module_clb(const char *mod_name, const char *mod_rev, const char *submod
             || !data_rpl->data->child || (data_rpl->data->child->schema->nodetype != LYS_ANYXML)) {
         ERR("Session %u: unexpected data in reply to a <get-schema> RPC.", session->id);
         nc_reply_free(reply);
-        return NULL;
+        return NC_MSG_REPLY;
     }
     get_schema_data = (struct lyd_node_anydata *)data_rpl->data->child;
     switch (get_schema_data->value_type) {
     case LYD_ANYDATA_CONSTSTRING:
     case LYD_ANYDATA_STRING:
-        model_data = strdup(get_schema_data->value.str);
+        *model_data = strdup(get_schema_data->value.str);
         break;
     case LYD_ANYDATA_DATATREE:
-        lyd_print_mem(&model_data, get_schema_data->value.tree, LYD_XML, LYP_WITHSIBLINGS);
+        lyd_print_mem(model_data, get_schema_data->value.tree, LYD_XML, LYP_WITHSIBLINGS);
         break;
     case LYD_ANYDATA_XML:
-        lyxml_print_mem(&model_data, get_schema_data->value.xml, LYXML_PRINT_SIBLINGS);
+        lyxml_print_mem(model_data, get_schema_data->value.xml, LYXML_PRINT_SIBLINGS);
         break;
     case LYD_ANYDATA_JSON:
     case LYD_ANYDATA_JSOND:
@@ -284,94 +501,568 @@ libyang_module_clb(const char *mod_name, const char *mod_rev, const char *submod
         break;
     }
     nc_reply_free(reply);
-    *free_model_data = free;
-    *format = LYS_IN_YANG;
+
+    return NC_MSG_REPLY;
+}
+
+static char *
+get_schema_download(struct nc_session *session, const char *name, const char *revision)
+{
+    struct nc_rpc *rpc;
+    NC_MSG_TYPE msg;
+    char *model_data = NULL;
+    uint64_t msgid;
+
+    rpc = nc_rpc_getschema(name, revision, "yang", NC_PARAMTYPE_CONST);
+
+    while ((msg = nc_send_rpc(session, rpc, 0, &msgid)) == NC_MSG_WOULDBLOCK) {
+        usleep(1000);
+    }
+    if (msg == NC_MSG_ERROR) {
+        ERR("Session %u: failed to send the <get-schema> RPC.", session->id);
+        nc_rpc_free(rpc);
+        return NULL;
+    }
+
+    get_schema_recv(session, rpc, msgid, &model_data);
+    nc_rpc_free(rpc);
 
     return model_data;
 }
 
-int
-nc_ctx_check_and_fill(struct nc_session *session)
+/* send <get-schema> for all the missing modules from the capabilities at once and receive the replies,
+ * never more than NC_CLIENT_GETSCHEMA_WINDOW RPCs waiting for their replies not to block the server */
+static void
+get_schema_prefetch(struct module_clb_data *clb_data)
 {
+    struct nc_session *session = clb_data->session;
+    struct schema_prefetch *prefetched;
+    struct nc_rpc *rpcs[NC_CLIENT_GETSCHEMA_WINDOW];
+    uint64_t msgids[NC_CLIENT_GETSCHEMA_WINDOW];
     const char *module_cpblt;
-    int i, get_schema_support = 0, ret = 0, r;
-    ly_module_imp_clb old_clb = NULL;
-    void *old_data = NULL;
+    char *name, *revision, *path;
+    uint32_t count = 0, sent, recvd, i;
+    NC_MSG_TYPE msg;
 
-    assert(session->opts.client.cpblts && session->ctx);
+    for (i = 0; session->opts.client.cpblts[i]; ++i) {
+        ++count;
+    }
+    prefetched = malloc(count * sizeof *prefetched);
+    if (!prefetched) {
+        ERRMEM;
+        return;
+    }
 
-    /* check if get-schema is supported */
+    /* learn what is missing */
+    count = 0;
     for (i = 0; session->opts.client.cpblts[i]; ++i) {
-        if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring", 51)) {
-            get_schema_support = 1;
+        module_cpblt = strstr(session->opts.client.cpblts[i], "module=");
+        if (!module_cpblt) {
+            continue;
+        }
+        name = module_cpblt_param(module_cpblt, "module=");
+        revision = module_cpblt_param(module_cpblt, "revision=");
+        if (!name) {
+            ERRMEM;
+            free(revision);
             break;
         }
-    }
 
-    /* get-schema is supported, load local ietf-netconf-monitoring so we can create <get-schema> RPCs */
-    if (get_schema_support && !ly_ctx_get_module(session->ctx, "ietf-netconf-monitoring", NULL)) {
-        if (lys_parse_path(session->ctx, SCHEMAS_DIR"/ietf-netconf-monitoring.yin", LYS_IN_YIN)) {
-            /* set module retrieval using <get-schema> */
-            old_clb = ly_ctx_get_module_imp_clb(session->ctx, &old_data);
-            ly_ctx_set_module_imp_clb(session->ctx, libyang_module_clb, session);
-        } else {
-            WRN("Loading NETCONF monitoring schema failed, cannot use <get-schema>.");
+        if (ly_ctx_get_module(session->ctx, name, revision)) {
+            /* already in the context */
+            free(name);
+            free(revision);
+            continue;
         }
-    }
-
-    /* load base model disregarding whether it's in capabilities (but NETCONF capabilities are used to enable features) */
-    if (ctx_check_and_load_ietf_netconf(session->ctx, session->opts.client.cpblts)) {
-        if (old_clb) {
-            ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
+        if (client_opts.schema_cache_dir && revision && !strchr(name, '/') && !strchr(revision, '/')) {
+            path = schema_cache_path(name, revision, "");
+            if (path && !access(path, R_OK)) {
+                /* will be loaded from the cache */
+                free(path);
+                free(name);
+                free(revision);
+                continue;
+            }
+            free(path);
         }
-        return -1;
+
+        prefetched[count].name = name;
+        prefetched[count].revision = revision;
+        prefetched[count].data = NULL;
+        ++count;
+    }
+    clb_data->prefetched = prefetched;
+    clb_data->prefetch_count = count;
+    if (!count) {
+        return;
     }
 
-    /* load all other models */
-    for (i = 0; session->opts.client.cpblts[i]; ++i) {
-        module_cpblt = strstr(session->opts.client.cpblts[i], "module=");
-        /* this capability requires a module */
-        if (module_cpblt) {
-            r = ctx_check_and_load_model(session, module_cpblt);
-            if (r == -1) {
-                ret = -1;
+    VRB("Session %u: downloading %u schemas.", session->id, count);
+
+    sent = 0;
+    recvd = 0;
+    while (recvd < count) {
+        /* fill the window */
+        while ((sent < count) && (sent - recvd < NC_CLIENT_GETSCHEMA_WINDOW)) {
+            rpcs[sent % NC_CLIENT_GETSCHEMA_WINDOW] = nc_rpc_getschema(prefetched[sent].name, prefetched[sent].revision,
+                                                                       "yang", NC_PARAMTYPE_CONST);
+            if (!rpcs[sent % NC_CLIENT_GETSCHEMA_WINDOW]) {
                 break;
             }
+            msg = nc_send_rpc(session, rpcs[sent % NC_CLIENT_GETSCHEMA_WINDOW], NC_READ_ACT_TIMEOUT * 1000,
+                              &msgids[sent % NC_CLIENT_GETSCHEMA_WINDOW]);
+            if (msg != NC_MSG_RPC) {
+                ERR("Session %u: failed to send the <get-schema> RPC.", session->id);
+                nc_rpc_free(rpcs[sent % NC_CLIENT_GETSCHEMA_WINDOW]);
+                break;
+            }
+            ++sent;
+        }
+        if (recvd == sent) {
+            break;
+        }
 
-            /* failed to load schema, but let's try to find it using user callback (or locally, if not set),
-            * if it was using get-schema */
-            if (r == 1) {
-                if (get_schema_support) {
-                    VRB("Trying to load the schema from a different source.");
-                    /* works even if old_clb is NULL */
-                    ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
-                    r = ctx_check_and_load_model(session, module_cpblt);
-                }
-
-                /* fail again (or no other way to try), too bad */
-                if (r) {
-                    session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
-                }
+        /* receive the oldest reply */
+        msg = get_schema_recv(session, rpcs[recvd % NC_CLIENT_GETSCHEMA_WINDOW], msgids[recvd % NC_CLIENT_GETSCHEMA_WINDOW],
+                              &prefetched[recvd].data);
+        nc_rpc_free(rpcs[recvd % NC_CLIENT_GETSCHEMA_WINDOW]);
+        ++recvd;
+        if (msg != NC_MSG_REPLY) {
+            break;
+        }
 
-                /* set get-schema callback back */
-                ly_ctx_set_module_imp_clb(session->ctx, &libyang_module_clb, session);
-            }
+        if (prefetched[recvd - 1].data && client_opts.schema_cache_dir && prefetched[recvd - 1].revision
+                && !strchr(prefetched[recvd - 1].name, '/') && !strchr(prefetched[recvd - 1].revision, '/')) {
+            schema_cache_store(prefetched[recvd - 1].name, prefetched[recvd - 1].revision, prefetched[recvd - 1].data);
         }
     }
 
-    if (old_clb) {
-        ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
+    /* the session failed, the rest is left to be downloaded on demand (or fail then) */
+    for (i = recvd; i < sent; ++i) {
+        if (session->status == NC_STATUS_RUNNING) {
+            /* the replies may still arrive, do not keep them */
+            nc_session_discard_reply(session, msgids[i % NC_CLIENT_GETSCHEMA_WINDOW]);
+        }
+        nc_rpc_free(rpcs[i % NC_CLIENT_GETSCHEMA_WINDOW]);
     }
-    if (session->flags & NC_SESSION_CLIENT_NOT_STRICT) {
-        WRN("Some models failed to be loaded, any data from these models (and any other unknown) will be ignored.");
+    for (i = recvd; i < count; ++i) {
+        free(prefetched[i].name);
+        free(prefetched[i].revision);
+        free(prefetched[i].data);
     }
-    return ret;
+    clb_data->prefetch_count = recvd;
 }
 
-API struct nc_session *
-nc_connect_inout(int fdin, int fdout, struct ly_ctx *ctx)
+static void
+get_schema_prefetch_free(struct module_clb_data *clb_data)
 {
-    struct nc_session *session;
+    uint32_t i;
+
+    for (i = 0; i < clb_data->prefetch_count; ++i) {
+        free(clb_data->prefetched[i].name);
+        free(clb_data->prefetched[i].revision);
+        free(clb_data->prefetched[i].data);
+    }
+    free(clb_data->prefetched);
+    clb_data->prefetched = NULL;
+    clb_data->prefetch_count = 0;
+}
+
+static char *
+libyang_module_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *submod_rev,
+                   void *user_data, LYS_INFORMAT *format, void (**free_model_data)(void *model_data))
+{
+    struct module_clb_data *clb_data = (struct module_clb_data *)user_data;
+    struct nc_session *session = clb_data->session;
+    const char *name, *revision;
+    char *model_data = NULL;
+    uint32_t i;
+
+    if (submod_name) {
+        name = submod_name;
+        revision = submod_rev;
+    } else {
+        name = mod_name;
+        revision = mod_rev;
+
+        /* downloaded in advance, a failed download is not retried */
+        for (i = 0; i < clb_data->prefetch_count; ++i) {
+            if (!strcmp(clb_data->prefetched[i].name, name) && (!revision || (clb_data->prefetched[i].revision
+                    && !strcmp(clb_data->prefetched[i].revision, revision)))) {
+                if (!clb_data->prefetched[i].data) {
+                    return NULL;
+                }
+                model_data = clb_data->prefetched[i].data;
+                clb_data->prefetched[i].data = NULL;
+                *free_model_data = free;
+                *format = LYS_IN_YANG;
+                return model_data;
+            }
+        }
+    }
+
+    /* only schemas with a revision can be cached, the latest one could change */
+    if (client_opts.schema_cache_dir && revision && !strchr(name, '/') && !strchr(revision, '/')) {
+        model_data = schema_cache_load(name, revision);
+        if (model_data) {
+            VRB("Session %u: schema \"%s@%s\" loaded from the cache.", session->id, name, revision);
+        }
+    }
+
+    if (!model_data) {
+        model_data = get_schema_download(session, name, revision);
+        if (!model_data) {
+            return NULL;
+        }
+        if (client_opts.schema_cache_dir && revision && !strchr(name, '/') && !strchr(revision, '/')) {
+            schema_cache_store(name, revision, model_data);
+        }
+    }
+
+    *free_model_data = free;
+    *format = LYS_IN_YANG;
+
+    return model_data;
+}
+
+static int
+ctx_load_models(struct nc_session *session)
+{
+    const char *module_cpblt;
+    int i, get_schema_support = 0, ret = 0, r;
+    ly_module_imp_clb old_clb = NULL;
+    void *old_data = NULL;
+    struct module_clb_data clb_data;
+
+    assert(session->opts.client.cpblts && session->ctx);
+
+    clb_data.session = session;
+    clb_data.prefetched = NULL;
+    clb_data.prefetch_count = 0;
+
+    /* check if get-schema is supported */
+    if (session->opts.client.cpblt_bits & NC_CPBLT_MONITORING) {
+        get_schema_support = 1;
+    }
+
+    /* get-schema is supported, load local ietf-netconf-monitoring so we can create <get-schema> RPCs */
+    if (get_schema_support && !ly_ctx_get_module(session->ctx, "ietf-netconf-monitoring", NULL)) {
+        if (lys_parse_path(session->ctx, SCHEMAS_DIR"/ietf-netconf-monitoring.yin", LYS_IN_YIN)) {
+            /* set module retrieval using <get-schema> */
+            old_clb = ly_ctx_get_module_imp_clb(session->ctx, &old_data);
+            ly_ctx_set_module_imp_clb(session->ctx, libyang_module_clb, &clb_data);
+
+            /* download all the missing schemas in advance instead of one round-trip each */
+            get_schema_prefetch(&clb_data);
+        } else {
+            WRN("Loading NETCONF monitoring schema failed, cannot use <get-schema>.");
+        }
+    }
+
+    /* load base model disregarding whether it's in capabilities (but NETCONF capabilities are used to enable features) */
+    if (ctx_check_and_load_ietf_netconf(session->ctx, session->opts.client.cpblt_bits)) {
+        if (old_clb) {
+            ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
+        }
+        get_schema_prefetch_free(&clb_data);
+        return -1;
+    }
+
+    /* load all other models */
+    for (i = 0; session->opts.client.cpblts[i]; ++i) {
+        module_cpblt = strstr(session->opts.client.cpblts[i], "module=");
+        /* this capability requires a module */
+        if (module_cpblt) {
+            r = ctx_check_and_load_model(session, module_cpblt);
+            if (r == -1) {
+                ret = -1;
+                break;
+            }
+
+            /* failed to load schema, but let's try to find it using user callback (or locally, if not set),
+            * if it was using get-schema */
+            if (r == 1) {
+                if (get_schema_support) {
+                    VRB("Trying to load the schema from a different source.");
+                    /* works even if old_clb is NULL */
+                    ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
+                    r = ctx_check_and_load_model(session, module_cpblt);
+                }
+
+                /* fail again (or no other way to try), too bad */
+                if (r) {
+                    session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+                }
+
+                /* set get-schema callback back */
+                ly_ctx_set_module_imp_clb(session->ctx, &libyang_module_clb, &clb_data);
+            }
+        }
+    }
+
+    if (old_clb) {
+        ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
+    }
+    get_schema_prefetch_free(&clb_data);
+    if (session->flags & NC_SESSION_CLIENT_NOT_STRICT) {
+        WRN("Some models failed to be loaded, any data from these models (and any other unknown) will be ignored.");
+    }
+    return ret;
+}
+
+API void
+nc_client_set_ctx_pool(int enabled)
+{
+    /* LOCK */
+    pthread_mutex_lock(&client_opts.ctx_pool_lock);
+    client_opts.ctx_pool_enabled = enabled;
+    /* UNLOCK */
+    pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+}
+
+static int
+ctx_pool_cpblt_cmp(const void *ptr1, const void *ptr2)
+{
+    return strcmp(*(char * const *)ptr1, *(char * const *)ptr2);
+}
+
+/* FNV-1a hash of the sorted capabilities and the searchpath */
+static uint64_t
+ctx_pool_hash(char **sorted_cpblts, const char *searchpath)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const char *str;
+    int i;
+
+    for (i = 0; sorted_cpblts[i]; ++i) {
+        /* including the terminating zero as a separator */
+        str = sorted_cpblts[i];
+        do {
+            hash ^= (unsigned char)*str;
+            hash *= 1099511628211ULL;
+        } while (*(str++));
+    }
+    for (str = searchpath; str && *str; ++str) {
+        hash ^= (unsigned char)*str;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/* pool lock is expected to be held */
+static struct nc_ctx_pool *
+ctx_pool_find(char **sorted_cpblts, const char *searchpath, uint64_t hash)
+{
+    struct nc_ctx_pool *pool;
+    int i;
+
+    for (pool = client_opts.ctx_pool; pool; pool = pool->next) {
+        if ((pool->hash != hash) || (!pool->searchpath != !searchpath)
+                || (searchpath && strcmp(pool->searchpath, searchpath))) {
+            continue;
+        }
+
+        /* compare the capabilities on a hash match */
+        for (i = 0; sorted_cpblts[i] && pool->cpblts[i]; ++i) {
+            if (strcmp(sorted_cpblts[i], pool->cpblts[i])) {
+                break;
+            }
+        }
+        if (!sorted_cpblts[i] && !pool->cpblts[i]) {
+            return pool;
+        }
+    }
+
+    return NULL;
+}
+
+/* adds a filled session context to the pool, unless there is one for the same capabilities already */
+static void
+ctx_pool_add(struct nc_session *session, char **sorted_cpblts, const char *searchpath, uint64_t hash)
+{
+    struct nc_ctx_pool *pool;
+    int i;
+
+    pool = calloc(1, sizeof *pool);
+    if (!pool) {
+        ERRMEM;
+        return;
+    }
+    for (i = 0; sorted_cpblts[i]; ++i);
+    pool->cpblts = calloc(i + 1, sizeof *pool->cpblts);
+    if (!pool->cpblts) {
+        ERRMEM;
+        goto fail;
+    }
+    for (i = 0; sorted_cpblts[i]; ++i) {
+        pool->cpblts[i] = strdup(sorted_cpblts[i]);
+        if (!pool->cpblts[i]) {
+            ERRMEM;
+            goto fail;
+        }
+    }
+    if (searchpath) {
+        pool->searchpath = strdup(searchpath);
+        if (!pool->searchpath) {
+            ERRMEM;
+            goto fail;
+        }
+    }
+    pool->hash = hash;
+    pool->ctx = session->ctx;
+    pool->refs = 1;
+    pool->not_strict = (session->flags & NC_SESSION_CLIENT_NOT_STRICT ? 1 : 0);
+
+    /* LOCK */
+    pthread_mutex_lock(&client_opts.ctx_pool_lock);
+    if (ctx_pool_find(sorted_cpblts, searchpath, hash)) {
+        /* someone was faster, keep the context private */
+        /* UNLOCK */
+        pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+        goto fail;
+    }
+    pool->next = client_opts.ctx_pool;
+    client_opts.ctx_pool = pool;
+    session->flags |= NC_SESSION_SHAREDCTX | NC_SESSION_CLIENT_POOLCTX;
+    /* UNLOCK */
+    pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+
+    return;
+
+fail:
+    if (pool->cpblts) {
+        for (i = 0; pool->cpblts[i]; ++i) {
+            free(pool->cpblts[i]);
+        }
+        free(pool->cpblts);
+    }
+    free(pool->searchpath);
+    free(pool);
+}
+
+void
+nc_client_ctx_pool_release(struct ly_ctx *ctx)
+{
+    struct nc_ctx_pool *pool, *prev = NULL;
+    int i;
+
+    /* LOCK */
+    pthread_mutex_lock(&client_opts.ctx_pool_lock);
+    for (pool = client_opts.ctx_pool; pool && (pool->ctx != ctx); prev = pool, pool = pool->next);
+    if (!pool) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+        ERRINT;
+        return;
+    }
+    if (--pool->refs) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+        return;
+    }
+
+    if (prev) {
+        prev->next = pool->next;
+    } else {
+        client_opts.ctx_pool = pool->next;
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+
+    ly_ctx_destroy(pool->ctx, NULL);
+    for (i = 0; pool->cpblts[i]; ++i) {
+        free(pool->cpblts[i]);
+    }
+    free(pool->cpblts);
+    free(pool->searchpath);
+    free(pool);
+}
+
+/* cache modules used for creating RPCs, before the session can be used by several threads */
+static void
+ctx_cache_modules(struct nc_session *session)
+{
+    session->opts.client.mods.ctx = session->ctx;
+    session->opts.client.mods.ietfnc = ly_ctx_get_module(session->ctx, "ietf-netconf", NULL);
+    session->opts.client.mods.ietfncwd = ly_ctx_get_module(session->ctx, "ietf-netconf-with-defaults", NULL);
+    session->opts.client.mods.ietfncmon = ly_ctx_get_module(session->ctx, "ietf-netconf-monitoring", NULL);
+    session->opts.client.mods.notifs = ly_ctx_get_module(session->ctx, "notifications", NULL);
+}
+
+int
+nc_ctx_check_and_fill(struct nc_session *session)
+{
+    struct nc_ctx_pool *pool;
+    char **sorted_cpblts = NULL;
+    const char *searchpath;
+    uint64_t hash = 0;
+    int i, ret;
+
+    /* LOCK */
+    pthread_mutex_lock(&client_opts.ctx_pool_lock);
+    if (client_opts.ctx_pool_enabled && !(session->flags & NC_SESSION_SHAREDCTX)) {
+        /* normalize the capabilities */
+        for (i = 0; session->opts.client.cpblts[i]; ++i);
+        sorted_cpblts = malloc((i + 1) * sizeof *sorted_cpblts);
+        if (!sorted_cpblts) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+            ERRMEM;
+            return -1;
+        }
+        memcpy(sorted_cpblts, session->opts.client.cpblts, (i + 1) * sizeof *sorted_cpblts);
+        qsort(sorted_cpblts, i, sizeof *sorted_cpblts, ctx_pool_cpblt_cmp);
+
+        searchpath = client_opts.schema_searchpath;
+        hash = ctx_pool_hash(sorted_cpblts, searchpath);
+        pool = ctx_pool_find(sorted_cpblts, searchpath, hash);
+        if (pool) {
+            /* use the pooled context, the private one was needed only for the handshake */
+            ++pool->refs;
+            /* UNLOCK */
+            pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+
+            VRB("Session %u: using a shared context for the server capabilities.", session->id);
+            ly_ctx_destroy(session->ctx, NULL);
+            session->ctx = pool->ctx;
+            session->flags |= NC_SESSION_SHAREDCTX | NC_SESSION_CLIENT_POOLCTX;
+            if (pool->not_strict) {
+                session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+            }
+            free(sorted_cpblts);
+            ctx_cache_modules(session);
+            return 0;
+        }
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&client_opts.ctx_pool_lock);
+
+    if (session->flags & NC_SESSION_SHAREDCTX) {
+        /* context of the caller, other sessions may be filling it right now */
+        /* SHARED CTX LOCK */
+        pthread_mutex_lock(&client_opts.shared_ctx_lock);
+        ret = ctx_load_models(session);
+        /* SHARED CTX UNLOCK */
+        pthread_mutex_unlock(&client_opts.shared_ctx_lock);
+    } else {
+        ret = ctx_load_models(session);
+    }
+
+    if (!ret && sorted_cpblts) {
+        ctx_pool_add(session, sorted_cpblts, client_opts.schema_searchpath, hash);
+    }
+    free(sorted_cpblts);
+    if (!ret) {
+        ctx_cache_modules(session);
+    }
+    return ret;
+}
+
+API struct nc_session *
+nc_connect_inout(int fdin, int fdout, struct ly_ctx *ctx)
+{
+    struct nc_session *session;
 
     if (fdin < 0) {
         ERRARG("fdin");
@@ -429,11 +1120,42 @@ fail:
     return NULL;
 }
 
+/* start a non-blocking connection, returns the socket or -1 if it failed right away */
+static int
+sock_connect_start(struct addrinfo *res)
+{
+    int sock, flags;
+
+    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock == -1) {
+        return -1;
+    }
+
+    /* make the socket non-blocking */
+    if (((flags = fcntl(sock, F_GETFL)) == -1) || (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        ERR("Fcntl failed (%s).", strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    if ((connect(sock, res->ai_addr, res->ai_addrlen) == -1) && (errno != EINPROGRESS)) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
 int
 nc_sock_connect(const char* host, uint16_t port)
 {
-    int i, sock = -1, flags;
-    struct addrinfo hints, *res_list, *res;
+    int i, sock = -1, timeout, err;
+    uint32_t addr_count = 0, first_count = 0, other_count = 0, next = 0, pending = 0;
+    socklen_t err_len;
+    struct addrinfo hints, *res_list, *res, **addrs = NULL;
+    struct pollfd *fds = NULL;
+    struct timespec *deadlines = NULL, ts_next, ts_cur;
+    uint32_t *fd_addr = NULL;
     char port_s[6]; /* length of string representation of short int */
 
     snprintf(port_s, 6, "%u", port);
@@ -449,51 +1171,430 @@ nc_sock_connect(const char* host, uint16_t port)
         return -1;
     }
 
-    for (res = res_list; res != NULL; res = res->ai_next) {
-        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (sock == -1) {
-            /* socket was not created, try another resource */
-            continue;
+    for (res = res_list; res; res = res->ai_next) {
+        ++addr_count;
+    }
+    /* the preferred family may be spread over twice as many slots before the gaps are closed */
+    addrs = malloc(2 * addr_count * sizeof *addrs);
+    fds = malloc(addr_count * sizeof *fds);
+    deadlines = malloc(addr_count * sizeof *deadlines);
+    fd_addr = malloc(addr_count * sizeof *fd_addr);
+    if (!addrs || !fds || !deadlines || !fd_addr) {
+        ERRMEM;
+        goto cleanup;
+    }
+
+    /* alternate the address families, starting with the preferred one (RFC 8305 sec. 4) */
+    for (res = res_list; res; res = res->ai_next) {
+        if (res->ai_family == res_list->ai_family) {
+            addrs[2 * first_count] = res;
+            ++first_count;
+        }
+    }
+    for (res = res_list; res; res = res->ai_next) {
+        if (res->ai_family != res_list->ai_family) {
+            if (other_count < first_count - 1) {
+                addrs[2 * other_count + 1] = res;
+            } else {
+                addrs[first_count + other_count] = res;
+            }
+            ++other_count;
+        }
+    }
+    if (other_count < first_count - 1) {
+        /* close the gaps left after the other family addresses */
+        for (i = 0; (unsigned)i < first_count - other_count; ++i) {
+            addrs[2 * other_count + i] = addrs[2 * (other_count + i)];
         }
+    }
 
-        if (connect(sock, res->ai_addr, res->ai_addrlen) == -1) {
-            /* network connection failed, try another resource */
-            close(sock);
-            sock = -1;
+    /* start the attempts one after another, each after the previous one failed
+     * or did not connect in NC_SOCK_CONNECT_DELAY, and wait for the first to succeed */
+    nc_gettimespec(&ts_next);
+    while (1) {
+        nc_gettimespec(&ts_cur);
+        if ((next < addr_count) && (!pending || (nc_difftimespec(&ts_cur, &ts_next) < 1))) {
+            fds[pending].fd = sock_connect_start(addrs[next]);
+            if (fds[pending].fd != -1) {
+                fds[pending].events = POLLOUT;
+                fds[pending].revents = 0;
+                fd_addr[pending] = next;
+                deadlines[pending] = ts_cur;
+                nc_addtimespec(&deadlines[pending], NC_SOCK_CONNECT_TIMEOUT);
+                ++pending;
+
+                ts_next = ts_cur;
+                nc_addtimespec(&ts_next, NC_SOCK_CONNECT_DELAY);
+            }
+            ++next;
             continue;
         }
+        if (!pending) {
+            /* all the attempts failed */
+            break;
+        }
 
-        /* make the socket non-blocking */
-        if (((flags = fcntl(sock, F_GETFL)) == -1) || (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
-            ERR("Fcntl failed (%s).", strerror(errno));
-            close(sock);
-            freeaddrinfo(res_list);
-            return -1;
+        /* wait for the nearest event */
+        timeout = -1;
+        if (next < addr_count) {
+            timeout = nc_difftimespec(&ts_cur, &ts_next);
+        }
+        for (i = 0; (unsigned)i < pending; ++i) {
+            err = nc_difftimespec(&ts_cur, &deadlines[i]);
+            if ((timeout == -1) || (err < timeout)) {
+                timeout = err;
+            }
+        }
+        if (timeout < 0) {
+            timeout = 0;
         }
 
-        /* we're done, network connection established */
-        break;
-    }
+        if (poll(fds, pending, timeout) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ERR("Poll failed (%s).", strerror(errno));
+            break;
+        }
 
-    if (sock != -1) {
-        VRB("Successfully connected to %s:%s over %s.", host, port_s, (res->ai_family == AF_INET6) ? "IPv6" : "IPv4");
-    }
-    freeaddrinfo(res_list);
+        nc_gettimespec(&ts_cur);
+        for (i = 0; (unsigned)i < pending; ) {
+            if (fds[i].revents) {
+                err = 0;
+                err_len = sizeof err;
+                if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == -1) {
+                    err = errno;
+                }
+                if (!err) {
+                    /* we're done, network connection established */
+                    sock = fds[i].fd;
+                    res = addrs[fd_addr[i]];
+                } else {
+                    VRB("Connecting to %s:%s over %s failed (%s).", host, port_s,
+                        (addrs[fd_addr[i]]->ai_family == AF_INET6) ? "IPv6" : "IPv4", strerror(err));
+                    close(fds[i].fd);
+                }
+            } else if (nc_difftimespec(&ts_cur, &deadlines[i]) < 1) {
+                VRB("Connecting to %s:%s over %s timed out.", host, port_s,
+                    (addrs[fd_addr[i]]->ai_family == AF_INET6) ? "IPv6" : "IPv4");
+                close(fds[i].fd);
+            } else {
+                ++i;
+                continue;
+            }
 
-    return sock;
-}
+            /* remove the finished attempt, the next one can start right away */
+            --pending;
+            fds[i] = fds[pending];
+            fd_addr[i] = fd_addr[pending];
+            deadlines[i] = deadlines[pending];
+            ts_next = ts_cur;
+            if (sock != -1) {
+                break;
+            }
+        }
+        if (sock != -1) {
+            break;
+        }
+    }
 
-static NC_MSG_TYPE
-get_msg(struct nc_session *session, int timeout, uint64_t msgid, struct lyxml_elem **msg)
+    /* abort the attempts still in progress */
+    for (i = 0; (unsigned)i < pending; ++i) {
+        close(fds[i].fd);
+    }
+
+    if (sock != -1) {
+        VRB("Successfully connected to %s:%s over %s.", host, port_s, (res->ai_family == AF_INET6) ? "IPv6" : "IPv4");
+    }
+
+cleanup:
+    free(addrs);
+    free(fds);
+    free(deadlines);
+    free(fd_addr);
+    freeaddrinfo(res_list);
+
+    return sock;
+}
+
+/* message-id of an <rpc-reply>, 0 if missing or invalid */
+static uint64_t
+get_reply_msgid(struct lyxml_elem *xml)
 {
-    int r;
-    char *ptr;
     const char *str_msgid;
-    uint64_t cur_msgid;
+    char *ptr;
+    uint64_t msgid;
+
+    str_msgid = lyxml_get_attr(xml, "message-id", NULL);
+    if (!str_msgid) {
+        return 0;
+    }
+
+    errno = 0;
+    msgid = strtoull(str_msgid, &ptr, 10);
+    if (errno || ptr[0]) {
+        return 0;
+    }
+    return msgid;
+}
+
+/* rough estimate of the memory used by an XML tree */
+static size_t
+xml_size(const struct lyxml_elem *xml)
+{
+    const struct lyxml_elem *child;
+    const struct lyxml_attr *attr;
+    size_t size;
+
+    size = sizeof *xml + (xml->content ? strlen(xml->content) : 0);
+    for (attr = xml->attr; attr; attr = attr->next) {
+        size += sizeof *attr + (attr->value ? strlen(attr->value) : 0);
+    }
+    LY_TREE_FOR(xml->child, child) {
+        size += xml_size(child);
+    }
+
+    return size;
+}
+
+/* session lock is expected to be held */
+static int
+store_reply(struct nc_session *session, uint64_t msgid, struct lyxml_elem *xml)
+{
+    struct nc_msg_cont **replies, *cont, *next;
+    uint32_t buckets, i;
+    size_t size;
+    uint64_t *dropped;
+
+    for (i = 0; i < session->opts.client.discard_count; ++i) {
+        if (session->opts.client.discard[i] == msgid) {
+            /* nobody is going to ask for this reply */
+            session->opts.client.discard[i] = session->opts.client.discard[session->opts.client.discard_count - 1];
+            --session->opts.client.discard_count;
+            lyxml_free(session->ctx, xml);
+            return 0;
+        }
+    }
+
+    size = xml_size(xml);
+    if ((client_opts.reply_queue_max && (session->opts.client.reply_count >= client_opts.reply_queue_max))
+            || (client_opts.reply_queue_max_size
+            && (session->opts.client.reply_size + size > client_opts.reply_queue_max_size))) {
+        /* nobody may ever ask for these replies, do not let them pile up */
+        if (!session->opts.client.reply_dropped) {
+            WRN("Session %u: too many RPC replies received before being requested, dropping replies.", session->id);
+        }
+        /* remember it so that whoever asks for it gets an error */
+        dropped = realloc(session->opts.client.dropped, (session->opts.client.dropped_count + 1) * sizeof *dropped);
+        if (!dropped) {
+            ERRMEM;
+            return -1;
+        }
+        session->opts.client.dropped = dropped;
+        session->opts.client.dropped[session->opts.client.dropped_count++] = msgid;
+
+        ++session->opts.client.reply_dropped;
+        lyxml_free(session->ctx, xml);
+        return 0;
+    }
+
+    if (session->opts.client.reply_count >= session->opts.client.reply_buckets) {
+        /* resize and rehash */
+        buckets = (session->opts.client.reply_buckets ? session->opts.client.reply_buckets * 2 : 16);
+        replies = calloc(buckets, sizeof *replies);
+        if (!replies) {
+            ERRMEM;
+            return -1;
+        }
+        for (i = 0; i < session->opts.client.reply_buckets; ++i) {
+            for (cont = session->opts.client.replies[i]; cont; cont = next) {
+                next = cont->next;
+                cont->next = replies[cont->msgid & (buckets - 1)];
+                replies[cont->msgid & (buckets - 1)] = cont;
+            }
+        }
+        free(session->opts.client.replies);
+        session->opts.client.replies = replies;
+        session->opts.client.reply_buckets = buckets;
+    }
+
+    cont = malloc(sizeof *cont);
+    if (!cont) {
+        ERRMEM;
+        return -1;
+    }
+    cont->msg = xml;
+    cont->msgid = msgid;
+    cont->size = size;
+    cont->next = session->opts.client.replies[msgid & (session->opts.client.reply_buckets - 1)];
+    session->opts.client.replies[msgid & (session->opts.client.reply_buckets - 1)] = cont;
+    ++session->opts.client.reply_count;
+    session->opts.client.reply_size += size;
+
+    return 0;
+}
+
+/* session lock is expected to be held */
+static struct lyxml_elem *
+take_reply(struct nc_session *session, uint64_t msgid)
+{
+    struct nc_msg_cont **cont_ptr, *cont;
+    struct lyxml_elem *xml;
+
+    if (!session->opts.client.reply_count) {
+        return NULL;
+    }
+
+    for (cont_ptr = &session->opts.client.replies[msgid & (session->opts.client.reply_buckets - 1)]; *cont_ptr;
+            cont_ptr = &(*cont_ptr)->next) {
+        if ((*cont_ptr)->msgid == msgid) {
+            cont = *cont_ptr;
+            *cont_ptr = cont->next;
+            --session->opts.client.reply_count;
+            session->opts.client.reply_size -= cont->size;
+
+            xml = cont->msg;
+            free(cont);
+            return xml;
+        }
+    }
+
+    return NULL;
+}
+
+/* session lock is expected to be held, returns 1 if the reply was dropped, it is forgotten then */
+static int
+take_dropped(struct nc_session *session, uint64_t msgid)
+{
+    uint32_t i;
+
+    for (i = 0; i < session->opts.client.dropped_count; ++i) {
+        if (session->opts.client.dropped[i] == msgid) {
+            session->opts.client.dropped[i] = session->opts.client.dropped[session->opts.client.dropped_count - 1];
+            --session->opts.client.dropped_count;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int
+nc_session_discard_reply(struct nc_session *session, uint64_t msgid)
+{
+    struct lyxml_elem *xml;
+    uint64_t *discard;
+    int ret = 0;
+
+    if (nc_session_lock(session, -1, __func__) != 1) {
+        return -1;
+    }
+
+    xml = take_reply(session, msgid);
+    if (xml) {
+        /* already received */
+        lyxml_free(session->ctx, xml);
+        goto cleanup;
+    } else if (take_dropped(session, msgid)) {
+        /* already received and dropped */
+        goto cleanup;
+    }
+
+    discard = realloc(session->opts.client.discard, (session->opts.client.discard_count + 1) * sizeof *discard);
+    if (!discard) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    session->opts.client.discard = discard;
+    session->opts.client.discard[session->opts.client.discard_count] = msgid;
+    ++session->opts.client.discard_count;
+
+cleanup:
+    nc_session_unlock(session, -1, __func__);
+    return ret;
+}
+
+/* session lock is expected to be held */
+static int
+queue_notif(struct nc_session *session, struct lyxml_elem *xml)
+{
+    struct nc_msg_cont *cont;
+    size_t size;
+
+    size = xml_size(xml);
+    if ((client_opts.notif_queue_max && (session->opts.client.notif_count >= client_opts.notif_queue_max))
+            || (client_opts.notif_queue_max_size
+            && (session->opts.client.notif_size + size > client_opts.notif_queue_max_size))) {
+        if (!session->opts.client.notif_dropped) {
+            WRN("Session %u: notification queue is full, dropping notifications.", session->id);
+        }
+        ++session->opts.client.notif_dropped;
+        lyxml_free(session->ctx, xml);
+        return 0;
+    }
+
+    cont = malloc(sizeof *cont);
+    if (!cont) {
+        ERRMEM;
+        return -1;
+    }
+    cont->msg = xml;
+    cont->msgid = 0;
+    cont->size = size;
+    cont->next = NULL;
+
+    if (session->opts.client.notifs_tail) {
+        session->opts.client.notifs_tail->next = cont;
+    } else {
+        session->opts.client.notifs = cont;
+    }
+    session->opts.client.notifs_tail = cont;
+    ++session->opts.client.notif_count;
+    session->opts.client.notif_size += size;
+
+    return 0;
+}
+
+/* session lock is expected to be held */
+static struct lyxml_elem *
+take_notif(struct nc_session *session)
+{
+    struct nc_msg_cont *cont;
     struct lyxml_elem *xml;
-    struct nc_msg_cont *cont, **cont_ptr;
+
+    cont = session->opts.client.notifs;
+    if (!cont) {
+        return NULL;
+    }
+
+    session->opts.client.notifs = cont->next;
+    if (!cont->next) {
+        session->opts.client.notifs_tail = NULL;
+    }
+    --session->opts.client.notif_count;
+    session->opts.client.notif_size -= cont->size;
+
+    xml = cont->msg;
+    free(cont);
+    return xml;
+}
+
+static NC_MSG_TYPE
+get_msg(struct nc_session *session, int timeout, uint64_t msgid, int (*split_clb)(const char *, size_t, void *),
+        void *split_arg, struct lyxml_elem **msg, struct nc_notif_raw **notif_raw)
+{
+    int r, read_timeout = timeout;
+    uint64_t cur_msgid;
+    struct lyxml_elem *xml = NULL;
+    struct timespec ts_timeout, ts_cur;
     NC_MSG_TYPE msgtype = 0; /* NC_MSG_ERROR */
 
+    if (timeout > 0) {
+        nc_gettimespec(&ts_timeout);
+        nc_addtimespec(&ts_timeout, timeout);
+    }
+
     r = nc_session_lock(session, timeout, __func__);
     if (r == -1) {
         /* error */
@@ -504,71 +1605,94 @@ get_msg(struct nc_session *session, int timeout, uint64_t msgid, struct lyxml_el
     }
 
     /* try to get notification from the session's queue */
-    if (!msgid && session->opts.client.notifs) {
-        cont = session->opts.client.notifs;
-        session->opts.client.notifs = cont->next;
-
-        xml = cont->msg;
-        free(cont);
-
-        msgtype = NC_MSG_NOTIF;
+    if (!msgid) {
+        xml = take_notif(session);
+        if (xml) {
+            msgtype = NC_MSG_NOTIF;
+        }
     }
 
-    /* try to get rpc-reply from the session's queue */
-    if (msgid && session->opts.client.replies) {
-        cont = session->opts.client.replies;
-        session->opts.client.replies = cont->next;
-
-        xml = cont->msg;
-        free(cont);
-
-        msgtype = NC_MSG_REPLY;
+    /* try to get the rpc-reply from the session's table */
+    if (msgid) {
+        xml = take_reply(session, msgid);
+        if (xml) {
+            msgtype = NC_MSG_REPLY;
+        } else if (take_dropped(session, msgid)) {
+            nc_session_unlock(session, timeout, __func__);
+            ERR("Session %u: the reply to the RPC with message-id %"PRIu64" was dropped, too many replies were "
+                "received before being requested.", session->id, msgid);
+            return NC_MSG_ERROR;
+        }
     }
 
-    if (!msgtype) {
-        /* read message from wire */
-        msgtype = nc_read_msg_poll(session, timeout, &xml);
-    }
+    while (!msgtype) {
+        if (timeout > 0) {
+            nc_gettimespec(&ts_cur);
+            read_timeout = nc_difftimespec(&ts_cur, &ts_timeout);
+            if (read_timeout < 1) {
+                msgtype = NC_MSG_WOULDBLOCK;
+                break;
+            }
+        }
 
-    /* we read rpc-reply, want a notif */
-    if (!msgid && (msgtype == NC_MSG_REPLY)) {
-        cont_ptr = &session->opts.client.replies;
-        while (*cont_ptr) {
-            cont_ptr = &((*cont_ptr)->next);
+        /* read message from wire */
+        if (split_clb) {
+            msgtype = nc_read_msg_split_poll(session, read_timeout, msgid, split_clb, split_arg, &xml);
+        } else if (notif_raw) {
+            msgtype = nc_read_msg_notif_raw_poll(session, read_timeout, &xml, notif_raw);
+        } else {
+            msgtype = nc_read_msg_poll(session, read_timeout, &xml);
         }
-        *cont_ptr = malloc(sizeof **cont_ptr);
-        if (!*cont_ptr) {
-            ERRMEM;
+        if (msgtype != NC_MSG_REPLY) {
+            break;
+        }
+
+        /* we read an rpc-reply, store it unless it is the one we want */
+        cur_msgid = get_reply_msgid(xml);
+        if (msgid && (!cur_msgid || (cur_msgid == msgid) || (cur_msgid > session->opts.client.msgid))) {
+            /* requested, invalid, or not a reply to any sent RPC, return it */
+            break;
+        } else if (!cur_msgid) {
+            ERR("Session %u: received an <rpc-reply> without a valid message-id, discarding it.", session->id);
+            lyxml_free(session->ctx, xml);
+        } else if (nc_client_reactor_take_reply(session, cur_msgid, xml)) {
+            /* a reply to an asynchronous RPC, the reactor dispatches it */
+        } else if (store_reply(session, cur_msgid, xml)) {
             nc_session_unlock(session, timeout, __func__);
             lyxml_free(session->ctx, xml);
             return NC_MSG_ERROR;
         }
-        (*cont_ptr)->msg = xml;
-        (*cont_ptr)->next = NULL;
+        xml = NULL;
+
+        if (!msgid) {
+            /* we want a notif, let the caller know a reply was read instead */
+            break;
+        } else if (!timeout) {
+            msgtype = NC_MSG_WOULDBLOCK;
+        } else {
+            /* keep waiting for the requested reply */
+            msgtype = 0;
+        }
     }
 
     /* we read notif, want a rpc-reply */
     if (msgid && (msgtype == NC_MSG_NOTIF)) {
-        if (!session->opts.client.ntf_tid) {
-            pthread_mutex_unlock(session->ti_lock);
+        if (!session->opts.client.ntf_tid && !session->opts.client.reactor) {
+            nc_session_unlock(session, timeout, __func__);
             ERR("Session %u: received a <notification> but session is not subscribed.", session->id);
             lyxml_free(session->ctx, xml);
             return NC_MSG_ERROR;
         }
 
-        cont_ptr = &session->opts.client.notifs;
-        while (*cont_ptr) {
-            cont_ptr = &((*cont_ptr)->next);
-        }
-        *cont_ptr = malloc(sizeof **cont_ptr);
-        if (!cont_ptr) {
-            ERRMEM;
+        if (queue_notif(session, xml)) {
             nc_session_unlock(session, timeout, __func__);
             lyxml_free(session->ctx, xml);
             return NC_MSG_ERROR;
         }
-        (*cont_ptr)->msg = xml;
-        (*cont_ptr)->next = NULL;
+        if (session->opts.client.reactor) {
+            /* the reactor dispatches it once the session is unlocked */
+            session->opts.client.reactor_wait = 1;
+        }
     }
 
     nc_session_unlock(session, timeout, __func__);
@@ -583,17 +1707,14 @@ get_msg(struct nc_session *session, int timeout, uint64_t msgid, struct lyxml_el
     case NC_MSG_REPLY:
         if (msgid) {
             /* check message-id */
-            str_msgid = lyxml_get_attr(xml, "message-id", NULL);
-            if (!str_msgid) {
-                ERR("Session %u: received a <rpc-reply> without a message-id.", session->id);
+            cur_msgid = get_reply_msgid(xml);
+            if (!cur_msgid) {
+                ERR("Session %u: received an <rpc-reply> without a valid message-id.", session->id);
+                msgtype = NC_MSG_REPLY_ERR_MSGID;
+            } else if (cur_msgid != msgid) {
+                ERR("Session %u: received an <rpc-reply> with an unexpected message-id %"PRIu64".",
+                    session->id, cur_msgid);
                 msgtype = NC_MSG_REPLY_ERR_MSGID;
-            } else {
-                cur_msgid = strtoul(str_msgid, &ptr, 10);
-                if (cur_msgid != msgid) {
-                    ERR("Session %u: received a <rpc-reply> with an unexpected message-id \"%s\".",
-                        session->id, str_msgid);
-                    msgtype = NC_MSG_REPLY_ERR_MSGID;
-                }
             }
             *msg = xml;
         }
@@ -927,6 +2048,162 @@ parse_reply(struct ly_ctx *ctx, struct lyxml_elem *xml, struct nc_rpc *rpc, int
 
 #if defined(NC_ENABLED_SSH) || defined(NC_ENABLED_TLS)
 
+struct nc_connect_bulk {
+    const struct nc_connect_target *targets;
+    uint32_t count;
+    uint32_t next;              /* index of the next target to connect to */
+    uint32_t connected;
+    struct ly_ctx *ctx;
+    void (*session_clb)(uint32_t idx, struct nc_session *session, void *user_data);
+    void *user_data;
+    pthread_mutex_t lock;
+};
+
+static void *
+nc_connect_bulk_thread(void *arg)
+{
+    struct nc_connect_bulk *bulk = (struct nc_connect_bulk *)arg;
+    const struct nc_connect_target *target;
+    struct nc_session *session;
+    uint32_t idx;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&bulk->lock);
+        idx = bulk->next;
+        if (idx < bulk->count) {
+            ++bulk->next;
+        }
+        /* UNLOCK */
+        pthread_mutex_unlock(&bulk->lock);
+
+        if (idx == bulk->count) {
+            break;
+        }
+        target = &bulk->targets[idx];
+
+        session = NULL;
+        switch (target->ti) {
+#ifdef NC_ENABLED_SSH
+        case NC_TI_LIBSSH:
+            session = nc_connect_ssh(target->host, target->port, bulk->ctx);
+            break;
+#endif
+#ifdef NC_ENABLED_TLS
+        case NC_TI_OPENSSL:
+            session = nc_connect_tls(target->host, target->port, bulk->ctx);
+            break;
+#endif
+        default:
+            ERRINT;
+            break;
+        }
+        if (!session) {
+            ERR("Connecting to %s:%u failed.", target->host, target->port);
+        }
+
+        if (session) {
+            /* LOCK */
+            pthread_mutex_lock(&bulk->lock);
+            ++bulk->connected;
+            /* UNLOCK */
+            pthread_mutex_unlock(&bulk->lock);
+        }
+
+        /* not locked so that the other threads can carry on meanwhile */
+        bulk->session_clb(idx, session, bulk->user_data);
+    }
+
+    return NULL;
+}
+
+API int
+nc_connect_bulk(const struct nc_connect_target *targets, uint32_t count, struct ly_ctx *ctx, uint16_t max_concurrent,
+                void (*session_clb)(uint32_t idx, struct nc_session *session, void *user_data), void *user_data)
+{
+    struct nc_connect_bulk bulk;
+    pthread_t *tids;
+    uint32_t i, thread_count;
+    int ret;
+
+    if (!targets) {
+        ERRARG("targets");
+        return -1;
+    } else if (!max_concurrent) {
+        ERRARG("max_concurrent");
+        return -1;
+    } else if (!session_clb) {
+        ERRARG("session_clb");
+        return -1;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (!targets[i].host) {
+            ERRARG("targets");
+            return -1;
+        }
+        switch (targets[i].ti) {
+#ifdef NC_ENABLED_SSH
+        case NC_TI_LIBSSH:
+#endif
+#ifdef NC_ENABLED_TLS
+        case NC_TI_OPENSSL:
+#endif
+            break;
+        default:
+            ERRARG("targets");
+            return -1;
+        }
+    }
+    if (!count) {
+        return 0;
+    }
+
+    bulk.targets = targets;
+    bulk.count = count;
+    bulk.next = 0;
+    bulk.connected = 0;
+    bulk.ctx = ctx;
+    bulk.session_clb = session_clb;
+    bulk.user_data = user_data;
+    pthread_mutex_init(&bulk.lock, NULL);
+
+    if (max_concurrent > NC_CLIENT_BULK_THREADS_MAX) {
+        max_concurrent = NC_CLIENT_BULK_THREADS_MAX;
+    }
+    thread_count = (count < max_concurrent ? count : max_concurrent);
+    tids = malloc(thread_count * sizeof *tids);
+    if (!tids) {
+        ERRMEM;
+        pthread_mutex_destroy(&bulk.lock);
+        return -1;
+    }
+
+    for (i = 0; i < thread_count; ++i) {
+        ret = pthread_create(&tids[i], NULL, nc_connect_bulk_thread, &bulk);
+        if (ret) {
+            /* carry on with the threads already running */
+            WRN("Failed to create a new thread (%s).", strerror(ret));
+            break;
+        }
+    }
+    thread_count = i;
+
+    if (!thread_count) {
+        free(tids);
+        pthread_mutex_destroy(&bulk.lock);
+        return -1;
+    }
+
+    for (i = 0; i < thread_count; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+    pthread_mutex_destroy(&bulk.lock);
+
+    return bulk.connected;
+}
+
 int
 nc_client_ch_add_bind_listen(const char *address, uint16_t port, NC_TRANSPORT_IMPL ti)
 {
@@ -940,7 +2217,7 @@ nc_client_ch_add_bind_listen(const char *address, uint16_t port, NC_TRANSPORT_IM
         return -1;
     }
 
-    sock = nc_sock_listen(address, port);
+    sock = nc_sock_listen(address, port, NULL, 0);
     if (sock == -1) {
         return -1;
     }
@@ -961,6 +2238,13 @@ nc_client_ch_add_bind_listen(const char *address, uint16_t port, NC_TRANSPORT_IM
     }
     client_opts.ch_bind_ti[client_opts.ch_bind_count - 1] = ti;
 
+    client_opts.ch_bind_pfds = nc_realloc(client_opts.ch_bind_pfds, client_opts.ch_bind_count * sizeof *client_opts.ch_bind_pfds);
+    if (!client_opts.ch_bind_pfds) {
+        ERRMEM;
+        close(sock);
+        return -1;
+    }
+
     client_opts.ch_binds[client_opts.ch_bind_count - 1].address = strdup(address);
     if (!client_opts.ch_binds[client_opts.ch_bind_count - 1].address) {
         ERRMEM;
@@ -989,6 +2273,8 @@ nc_client_ch_del_bind(const char *address, uint16_t port, NC_TRANSPORT_IMPL ti)
         }
         free(client_opts.ch_binds);
         client_opts.ch_binds = NULL;
+        free(client_opts.ch_bind_pfds);
+        client_opts.ch_bind_pfds = NULL;
         client_opts.ch_bind_count = 0;
     } else {
         for (i = 0; i < client_opts.ch_bind_count; ++i) {
@@ -1002,6 +2288,8 @@ nc_client_ch_del_bind(const char *address, uint16_t port, NC_TRANSPORT_IMPL ti)
                 if (!client_opts.ch_bind_count) {
                     free(client_opts.ch_binds);
                     client_opts.ch_binds = NULL;
+                    free(client_opts.ch_bind_pfds);
+                    client_opts.ch_bind_pfds = NULL;
                 } else if (i < client_opts.ch_bind_count) {
                     memcpy(&client_opts.ch_binds[i], &client_opts.ch_binds[client_opts.ch_bind_count], sizeof *client_opts.ch_binds);
                     client_opts.ch_bind_ti[i] = client_opts.ch_bind_ti[client_opts.ch_bind_count];
@@ -1030,7 +2318,7 @@ nc_accept_callhome(int timeout, struct ly_ctx *ctx, struct nc_session **session)
         return -1;
     }
 
-    sock = nc_sock_accept_binds(client_opts.ch_binds, client_opts.ch_bind_count, timeout, &host, &port, &idx);
+    sock = nc_sock_accept_binds(client_opts.ch_binds, client_opts.ch_bind_pfds, client_opts.ch_bind_count, timeout, &host, &port, &idx);
 
     if (sock < 1) {
         free(host);
@@ -1077,7 +2365,9 @@ nc_session_get_cpblts(const struct nc_session *session)
 API const char *
 nc_session_cpblt(const struct nc_session *session, const char *capab)
 {
-    int i, len;
+    uint32_t slot, mask, lo, hi, mid;
+    const char *cpblt;
+    int len;
 
     if (!session) {
         ERRARG("session");
@@ -1088,19 +2378,86 @@ nc_session_cpblt(const struct nc_session *session, const char *capab)
     }
 
     len = strlen(capab);
-    for (i = 0; session->opts.client.cpblts[i]; ++i) {
-        if (!strncmp(session->opts.client.cpblts[i], capab, len)) {
-            return session->opts.client.cpblts[i];
+
+    /* whole capability URI lookup in the index */
+    if (session->opts.client.cpblt_idx) {
+        mask = session->opts.client.cpblt_idx_size - 1;
+        for (slot = nc_cpblt_hash(capab, len) & mask; session->opts.client.cpblt_idx[slot]; slot = (slot + 1) & mask) {
+            cpblt = session->opts.client.cpblts[session->opts.client.cpblt_idx[slot] - 1];
+            if (!strncmp(cpblt, capab, len) && ((cpblt[len] == '\0') || (cpblt[len] == '?'))) {
+                return cpblt;
+            }
+        }
+    }
+
+    /* any other prefix, all the capabilities starting with it follow right after it in the sorted ones */
+    if (session->opts.client.cpblt_sorted) {
+        lo = 0;
+        hi = session->opts.client.cpblt_count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (strcmp(session->opts.client.cpblt_sorted[mid], capab) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if ((lo < session->opts.client.cpblt_count) && !strncmp(session->opts.client.cpblt_sorted[lo], capab, len)) {
+            return session->opts.client.cpblt_sorted[lo];
         }
     }
 
     return NULL;
 }
 
-API int
-nc_session_ntf_thread_running(const struct nc_session *session)
+API void
+nc_client_set_notif_queue_limits(uint32_t max_count, size_t max_size)
 {
-    if (!session || (session->side != NC_CLIENT)) {
+    client_opts.notif_queue_max = max_count;
+    client_opts.notif_queue_max_size = max_size;
+}
+
+API void
+nc_client_set_reply_queue_limits(uint32_t max_count, size_t max_size)
+{
+    client_opts.reply_queue_max = max_count;
+    client_opts.reply_queue_max_size = max_size;
+}
+
+API int
+nc_session_get_queue_stats(const struct nc_session *session, uint32_t *reply_count, size_t *reply_size,
+                           uint32_t *reply_dropped, uint32_t *notif_count, size_t *notif_size, uint32_t *notif_dropped)
+{
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG("session");
+        return -1;
+    }
+
+    if (reply_count) {
+        *reply_count = session->opts.client.reply_count;
+    }
+    if (reply_size) {
+        *reply_size = session->opts.client.reply_size;
+    }
+    if (reply_dropped) {
+        *reply_dropped = session->opts.client.reply_dropped;
+    }
+    if (notif_count) {
+        *notif_count = session->opts.client.notif_count;
+    }
+    if (notif_size) {
+        *notif_size = session->opts.client.notif_size;
+    }
+    if (notif_dropped) {
+        *notif_dropped = session->opts.client.notif_dropped;
+    }
+    return 0;
+}
+
+API int
+nc_session_ntf_thread_running(const struct nc_session *session)
+{
+    if (!session || (session->side != NC_CLIENT)) {
         ERRARG("session");
         return 0;
     }
@@ -1118,6 +2475,8 @@ API void
 nc_client_destroy(void)
 {
     nc_client_set_schema_searchpath(NULL);
+    nc_client_set_schema_cache_dir(NULL);
+    nc_client_set_ctx_pool(0);
 #if defined(NC_ENABLED_SSH) || defined(NC_ENABLED_TLS)
     nc_client_ch_del_bind(NULL, 0, 0);
 #endif
@@ -1160,7 +2519,7 @@ nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, in
     parseroptions|= LYD_OPT_NOEXTDEPS;
     *reply = NULL;
 
-    msgtype = get_msg(session, timeout, msgid, &xml);
+    msgtype = get_msg(session, timeout, msgid, NULL, NULL, &xml, NULL);
 
     if ((msgtype == NC_MSG_REPLY) || (msgtype == NC_MSG_REPLY_ERR_MSGID)) {
         *reply = parse_reply(session->ctx, xml, rpc, parseroptions);
@@ -1173,59 +2532,153 @@ nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, in
     return msgtype;
 }
 
+struct reply_stream_data {
+    struct nc_session *session;
+    int parseroptions;
+    int (*data_clb)(struct nc_session *session, const struct lyd_node *subtree, const char *xml, void *user_data);
+    void *user_data;
+};
+
+static int
+reply_stream_subtree(const char *xml, size_t UNUSED(len), void *arg)
+{
+    struct reply_stream_data *stream = (struct reply_stream_data *)arg;
+    struct lyd_node *subtree;
+    int ret;
+
+    ly_errno = LY_SUCCESS;
+    subtree = lyd_parse_mem(stream->session->ctx, xml, LYD_XML, stream->parseroptions);
+    if (!subtree && ly_errno) {
+        ERR("Session %u: failed to parse a data subtree of a reply.", stream->session->id);
+        return -1;
+    }
+
+    ret = stream->data_clb(stream->session, subtree, xml, stream->user_data);
+    lyd_free_withsiblings(subtree);
+    return ret;
+}
+
 API NC_MSG_TYPE
-nc_recv_notif(struct nc_session *session, int timeout, struct nc_notif **notif)
+nc_recv_reply_stream(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout, int parseroptions,
+                     int (*data_clb)(struct nc_session *session, const struct lyd_node *subtree, const char *xml,
+                                     void *user_data),
+                     void *user_data, struct nc_reply **reply)
 {
-    struct lyxml_elem *xml, *ev_time;
+    struct lyxml_elem *xml;
+    struct lyd_node *iter;
+    struct nc_reply_data *data_rpl;
+    struct reply_stream_data stream;
+    char *str;
+    int ret = 0;
     NC_MSG_TYPE msgtype = 0; /* NC_MSG_ERROR */
 
     if (!session) {
         ERRARG("session");
         return NC_MSG_ERROR;
-    } else if (!notif) {
-        ERRARG("notif");
+    } else if (!rpc || ((rpc->type != NC_RPC_GET) && (rpc->type != NC_RPC_GETCONFIG))) {
+        ERRARG("rpc");
         return NC_MSG_ERROR;
-    } else if (session->status != NC_STATUS_RUNNING || session->side != NC_CLIENT) {
-        ERR("Session %u: invalid session to receive Notifications.", session->id);
+    } else if (!msgid) {
+        ERRARG("msgid");
         return NC_MSG_ERROR;
+    } else if (!data_clb) {
+        ERRARG("data_clb");
+        return NC_MSG_ERROR;
+    } else if (!reply) {
+        ERRARG("reply");
+        return NC_MSG_ERROR;
+    } else if (parseroptions & LYD_OPT_TYPEMASK) {
+        ERRARG("parseroptions");
+        return NC_MSG_ERROR;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR("Session %u: invalid session to receive RPC replies.", session->id);
+        return NC_MSG_ERROR;
+    }
+    parseroptions &= ~(LYD_OPT_DESTRUCT | LYD_OPT_NOSIBLINGS);
+    if (!(session->flags & NC_SESSION_CLIENT_NOT_STRICT)) {
+        parseroptions |= LYD_OPT_STRICT;
     }
+    /* no mechanism to check external dependencies is provided */
+    parseroptions |= LYD_OPT_NOEXTDEPS;
+    *reply = NULL;
 
-    msgtype = get_msg(session, timeout, 0, &xml);
+    stream.session = session;
+    stream.parseroptions = parseroptions | (rpc->type == NC_RPC_GETCONFIG ? LYD_OPT_GETCONFIG : LYD_OPT_GET);
+    stream.data_clb = data_clb;
+    stream.user_data = user_data;
 
-    if (msgtype == NC_MSG_NOTIF) {
-        *notif = calloc(1, sizeof **notif);
-        if (!*notif) {
-            ERRMEM;
-            lyxml_free(session->ctx, xml);
+    msgtype = get_msg(session, timeout, msgid, reply_stream_subtree, &stream, &xml, NULL);
+
+    if ((msgtype == NC_MSG_REPLY) || (msgtype == NC_MSG_REPLY_ERR_MSGID)) {
+        *reply = parse_reply(session->ctx, xml, rpc, parseroptions);
+        lyxml_free(session->ctx, xml);
+        if (!(*reply)) {
             return NC_MSG_ERROR;
         }
 
-        /* eventTime */
-        LY_TREE_FOR(xml->child, ev_time) {
-            if (!strcmp(ev_time->name, "eventTime")) {
-                (*notif)->datetime = lydict_insert(session->ctx, ev_time->content, 0);
-                /* lyd_parse does not know this element */
-                lyxml_free(session->ctx, ev_time);
-                break;
+        /* the reply was read whole before (while waiting for another one), pass its data the same way */
+        if ((*reply)->type == NC_RPL_DATA) {
+            data_rpl = (struct nc_reply_data *)*reply;
+            for (iter = data_rpl->data; iter && !ret; iter = iter->next) {
+                if (lyd_print_mem(&str, iter, LYD_XML, 0)) {
+                    ERRINT;
+                    ret = -1;
+                    break;
+                }
+                ret = data_clb(session, iter, str, user_data);
+                free(str);
+            }
+            lyd_free_withsiblings(data_rpl->data);
+            data_rpl->data = NULL;
+
+            if (ret) {
+                nc_reply_free(*reply);
+                *reply = NULL;
+                return NC_MSG_ERROR;
             }
         }
-        if (!(*notif)->datetime) {
-            ERR("Session %u: notification is missing the \"eventTime\" element.", session->id);
-            goto fail;
-        }
+    }
+
+    return msgtype;
+}
+
+static int
+parse_notif(struct nc_session *session, struct lyxml_elem *xml, struct nc_notif **notif)
+{
+    struct lyxml_elem *ev_time;
 
-        /* notification body */
-        (*notif)->tree = lyd_parse_xml(session->ctx, &xml->child, LYD_OPT_NOTIF | LYD_OPT_DESTRUCT | LYD_OPT_NOEXTDEPS
-                                       | (session->flags & NC_SESSION_CLIENT_NOT_STRICT ? 0 : LYD_OPT_STRICT), NULL);
+    *notif = calloc(1, sizeof **notif);
+    if (!*notif) {
+        ERRMEM;
         lyxml_free(session->ctx, xml);
-        xml = NULL;
-        if (!(*notif)->tree) {
-            ERR("Session %u: failed to parse a new notification.", session->id);
-            goto fail;
+        return -1;
+    }
+
+    /* eventTime */
+    LY_TREE_FOR(xml->child, ev_time) {
+        if (!strcmp(ev_time->name, "eventTime")) {
+            (*notif)->datetime = lydict_insert(session->ctx, ev_time->content, 0);
+            /* lyd_parse does not know this element */
+            lyxml_free(session->ctx, ev_time);
+            break;
         }
     }
+    if (!(*notif)->datetime) {
+        ERR("Session %u: notification is missing the \"eventTime\" element.", session->id);
+        goto fail;
+    }
 
-    return msgtype;
+    /* notification body */
+    (*notif)->tree = lyd_parse_xml(session->ctx, &xml->child, LYD_OPT_NOTIF | LYD_OPT_DESTRUCT | LYD_OPT_NOEXTDEPS
+                                   | (session->flags & NC_SESSION_CLIENT_NOT_STRICT ? 0 : LYD_OPT_STRICT), NULL);
+    lyxml_free(session->ctx, xml);
+    xml = NULL;
+    if (!(*notif)->tree) {
+        ERR("Session %u: failed to parse a new notification.", session->id);
+        goto fail;
+    }
+
+    return 0;
 
 fail:
     lydict_remove(session->ctx, (*notif)->datetime);
@@ -1234,7 +2687,139 @@ fail:
     *notif = NULL;
     lyxml_free(session->ctx, xml);
 
-    return NC_MSG_ERROR;
+    return -1;
+}
+
+API NC_MSG_TYPE
+nc_recv_notif(struct nc_session *session, int timeout, struct nc_notif **notif)
+{
+    struct lyxml_elem *xml;
+    NC_MSG_TYPE msgtype = 0; /* NC_MSG_ERROR */
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!notif) {
+        ERRARG("notif");
+        return NC_MSG_ERROR;
+    } else if (session->status != NC_STATUS_RUNNING || session->side != NC_CLIENT) {
+        ERR("Session %u: invalid session to receive Notifications.", session->id);
+        return NC_MSG_ERROR;
+    }
+
+    msgtype = get_msg(session, timeout, 0, NULL, NULL, &xml, NULL);
+
+    if ((msgtype == NC_MSG_NOTIF) && parse_notif(session, xml, notif)) {
+        return NC_MSG_ERROR;
+    }
+
+    return msgtype;
+}
+
+static int
+parse_notif_raw(struct nc_session *session, struct lyxml_elem *xml, struct nc_notif_raw **notif)
+{
+    struct lyxml_elem *iter, *ev_time = NULL, *root = NULL;
+    char *str;
+    size_t len;
+
+    LY_TREE_FOR(xml->child, iter) {
+        if (!ev_time && !strcmp(iter->name, "eventTime")) {
+            ev_time = iter;
+        } else if (!root) {
+            root = iter;
+        }
+    }
+    if (!ev_time || !ev_time->content) {
+        ERR("Session %u: notification is missing the \"eventTime\" element.", session->id);
+        lyxml_free(session->ctx, xml);
+        return -1;
+    } else if (!root || !root->ns) {
+        ERR("Session %u: notification is missing its content.", session->id);
+        lyxml_free(session->ctx, xml);
+        return -1;
+    }
+
+    /* the strings are stored right after the structure */
+    len = strlen(ev_time->content) + 1 + strlen(root->name) + 1 + strlen(root->ns->value) + 1;
+    *notif = calloc(1, sizeof **notif + len);
+    if (!*notif) {
+        ERRMEM;
+        lyxml_free(session->ctx, xml);
+        return -1;
+    }
+    str = (char *)(*notif + 1);
+    (*notif)->datetime = strcpy(str, ev_time->content);
+    str += strlen(str) + 1;
+    (*notif)->name = strcpy(str, root->name);
+    str += strlen(str) + 1;
+    (*notif)->ns = strcpy(str, root->ns->value);
+
+    if (lyxml_print_mem(&(*notif)->xml, xml, 0) < 1) {
+        ERR("Session %u: failed to print a notification.", session->id);
+        lyxml_free(session->ctx, xml);
+        nc_notif_raw_free(*notif);
+        *notif = NULL;
+        return -1;
+    }
+    (*notif)->xml_len = strlen((*notif)->xml);
+    lyxml_free(session->ctx, xml);
+
+    return 0;
+}
+
+API NC_MSG_TYPE
+nc_recv_notif_raw(struct nc_session *session, int timeout, struct nc_notif_raw **notif)
+{
+    struct lyxml_elem *xml;
+    NC_MSG_TYPE msgtype = 0; /* NC_MSG_ERROR */
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!notif) {
+        ERRARG("notif");
+        return NC_MSG_ERROR;
+    } else if (session->status != NC_STATUS_RUNNING || session->side != NC_CLIENT) {
+        ERR("Session %u: invalid session to receive Notifications.", session->id);
+        return NC_MSG_ERROR;
+    }
+
+    /* notifications read now are returned as received, queued ones were already parsed */
+    *notif = NULL;
+    msgtype = get_msg(session, timeout, 0, NULL, NULL, &xml, notif);
+
+    if ((msgtype == NC_MSG_NOTIF) && !*notif && parse_notif_raw(session, xml, notif)) {
+        return NC_MSG_ERROR;
+    }
+
+    return msgtype;
+}
+
+API struct nc_notif *
+nc_notif_raw_parse(struct nc_session *session, const struct nc_notif_raw *notif)
+{
+    struct lyxml_elem *xml;
+    struct nc_notif *parsed;
+
+    if (!session) {
+        ERRARG("session");
+        return NULL;
+    } else if (!notif) {
+        ERRARG("notif");
+        return NULL;
+    }
+
+    xml = lyxml_parse_mem(session->ctx, notif->xml, 0);
+    if (!xml) {
+        ERR("Session %u: failed to parse a raw notification.", session->id);
+        return NULL;
+    }
+
+    if (parse_notif(session, xml, &parsed)) {
+        return NULL;
+    }
+    return parsed;
 }
 
 static void *
@@ -1243,15 +2828,39 @@ nc_recv_notif_thread(void *arg)
     struct nc_ntf_thread_arg *ntarg;
     struct nc_session *session;
     void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif);
+    void (*notif_raw_clb)(struct nc_session *session, const struct nc_notif_raw *notif);
     struct nc_notif *notif;
+    struct nc_notif_raw *notif_raw;
     NC_MSG_TYPE msgtype;
 
     ntarg = (struct nc_ntf_thread_arg *)arg;
     session = ntarg->session;
     notif_clb = ntarg->notif_clb;
+    notif_raw_clb = ntarg->notif_raw_clb;
     free(ntarg);
 
     while (session->opts.client.ntf_tid) {
+        if (notif_raw_clb) {
+            msgtype = nc_recv_notif_raw(session, NC_CLIENT_NOTIF_THREAD_SLEEP / 1000, &notif_raw);
+            if (msgtype == NC_MSG_NOTIF) {
+                notif_raw_clb(session, notif_raw);
+                if (!strcmp(notif_raw->name, "notificationComplete")
+                        && !strcmp(notif_raw->ns, "urn:ietf:params:xml:ns:netmod:notification")) {
+                    nc_notif_raw_free(notif_raw);
+                    break;
+                }
+                nc_notif_raw_free(notif_raw);
+
+                /* read the next one right away, there may be more of them */
+                continue;
+            } else if (msgtype == NC_MSG_ERROR) {
+                break;
+            }
+
+            usleep(NC_CLIENT_NOTIF_THREAD_SLEEP);
+            continue;
+        }
+
         msgtype = nc_recv_notif(session, NC_CLIENT_NOTIF_THREAD_SLEEP / 1000, &notif);
         if (msgtype == NC_MSG_NOTIF) {
             notif_clb(session, notif);
@@ -1273,19 +2882,14 @@ nc_recv_notif_thread(void *arg)
     return NULL;
 }
 
-API int
-nc_recv_notif_dispatch(struct nc_session *session, void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif))
+static int
+recv_notif_dispatch(struct nc_session *session, void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif),
+                    void (*notif_raw_clb)(struct nc_session *session, const struct nc_notif_raw *notif))
 {
     struct nc_ntf_thread_arg *ntarg;
     int ret;
 
-    if (!session) {
-        ERRARG("session");
-        return -1;
-    } else if (!notif_clb) {
-        ERRARG("notif_clb");
-        return -1;
-    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
         ERR("Session %u: invalid session to receive Notifications.", session->id);
         return -1;
     } else if (session->opts.client.ntf_tid) {
@@ -1300,6 +2904,7 @@ nc_recv_notif_dispatch(struct nc_session *session, void (*notif_clb)(struct nc_s
     }
     ntarg->session = session;
     ntarg->notif_clb = notif_clb;
+    ntarg->notif_raw_clb = notif_raw_clb;
 
     /* just so that nc_recv_notif_thread() does not immediately exit, the value does not matter */
     session->opts.client.ntf_tid = malloc(sizeof *session->opts.client.ntf_tid);
@@ -1321,11 +2926,51 @@ nc_recv_notif_dispatch(struct nc_session *session, void (*notif_clb)(struct nc_s
     return 0;
 }
 
-API NC_MSG_TYPE
-nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid)
+API int
+nc_recv_notif_dispatch(struct nc_session *session, void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif))
+{
+    if (!session) {
+        ERRARG("session");
+        return -1;
+    } else if (!notif_clb) {
+        ERRARG("notif_clb");
+        return -1;
+    }
+
+    return recv_notif_dispatch(session, notif_clb, NULL);
+}
+
+API int
+nc_recv_notif_dispatch_raw(struct nc_session *session,
+                           void (*notif_clb)(struct nc_session *session, const struct nc_notif_raw *notif))
+{
+    if (!session) {
+        ERRARG("session");
+        return -1;
+    } else if (!notif_clb) {
+        ERRARG("notif_clb");
+        return -1;
+    }
+
+    return recv_notif_dispatch(session, NULL, notif_clb);
+}
+
+/* session context module, the cache is only read here because the session is not locked */
+static const struct lys_module *
+session_module(struct nc_session *session, const struct lys_module *module, const char *name)
+{
+    if (module && (session->opts.client.mods.ctx == session->ctx)) {
+        return module;
+    }
+
+    /* not cached or loaded into the context later */
+    return ly_ctx_get_module(session->ctx, name, NULL);
+}
+
+/* create the validated RPC data tree */
+static struct lyd_node *
+rpc_to_data(struct nc_session *session, struct nc_rpc *rpc)
 {
-    NC_MSG_TYPE r;
-    int ret;
     struct nc_rpc_act_generic *rpc_gen;
     struct nc_rpc_getconfig *rpc_gc;
     struct nc_rpc_edit *rpc_e;
@@ -1342,27 +2987,12 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
     struct lyd_node *data, *node;
     const struct lys_module *ietfnc = NULL, *ietfncmon, *notifs, *ietfncwd = NULL;
     char str[11];
-    uint64_t cur_msgid;
-
-    if (!session) {
-        ERRARG("session");
-        return NC_MSG_ERROR;
-    } else if (!rpc) {
-        ERRARG("rpc");
-        return NC_MSG_ERROR;
-    } else if (!msgid) {
-        ERRARG("msgid");
-        return NC_MSG_ERROR;
-    } else if (session->status != NC_STATUS_RUNNING || session->side != NC_CLIENT) {
-        ERR("Session %u: invalid session to send RPCs.", session->id);
-        return NC_MSG_ERROR;
-    }
 
     if ((rpc->type != NC_RPC_GETSCHEMA) && (rpc->type != NC_RPC_ACT_GENERIC) && (rpc->type != NC_RPC_SUBSCRIBE)) {
-        ietfnc = ly_ctx_get_module(session->ctx, "ietf-netconf", NULL);
+        ietfnc = session_module(session, session->opts.client.mods.ietfnc, "ietf-netconf");
         if (!ietfnc) {
             ERR("Session %u: missing \"ietf-netconf\" schema in the context.", session->id);
-            return NC_MSG_ERROR;
+            return NULL;
         }
     }
 
@@ -1386,7 +3016,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         node = lyd_new_leaf(node, ietfnc, ncds2str[rpc_gc->source], NULL);
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         if (rpc_gc->filter) {
             if (!rpc_gc->filter[0] || (rpc_gc->filter[0] == '<')) {
@@ -1399,16 +3029,16 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             }
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
         if (rpc_gc->wd_mode) {
             if (!ietfncwd) {
-                ietfncwd = ly_ctx_get_module(session->ctx, "ietf-netconf-with-defaults", NULL);
+                ietfncwd = session_module(session, session->opts.client.mods.ietfncwd, "ietf-netconf-with-defaults");
                 if (!ietfncwd) {
                     ERR("Session %u: missing \"ietf-netconf-with-defaults\" schema in the context.", session->id);
-                    return NC_MSG_ERROR;
+                    return NULL;
                 }
             }
             switch (rpc_gc->wd_mode) {
@@ -1430,7 +3060,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             }
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
@@ -1443,14 +3073,14 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         node = lyd_new_leaf(node, ietfnc, ncds2str[rpc_e->target], NULL);
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
 
         if (rpc_e->default_op) {
             node = lyd_new_leaf(data, ietfnc, "default-operation", rpcedit_dfltop2str[rpc_e->default_op]);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1458,7 +3088,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, ietfnc, "test-option", rpcedit_testopt2str[rpc_e->test_opt]);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1466,7 +3096,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, ietfnc, "error-option", rpcedit_erropt2str[rpc_e->error_opt]);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1477,7 +3107,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         }
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         break;
 
@@ -1493,7 +3123,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         }
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
 
         node = lyd_new(data, ietfnc, "source");
@@ -1508,15 +3138,15 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         }
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
 
         if (rpc_cp->wd_mode) {
             if (!ietfncwd) {
-                ietfncwd = ly_ctx_get_module(session->ctx, "ietf-netconf-with-defaults", NULL);
+                ietfncwd = session_module(session, session->opts.client.mods.ietfncwd, "ietf-netconf-with-defaults");
                 if (!ietfncwd) {
                     ERR("Session %u: missing \"ietf-netconf-with-defaults\" schema in the context.", session->id);
-                    return NC_MSG_ERROR;
+                    return NULL;
                 }
             }
             switch (rpc_cp->wd_mode) {
@@ -1538,7 +3168,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             }
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
@@ -1555,7 +3185,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         }
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         break;
 
@@ -1567,7 +3197,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         node = lyd_new_leaf(node, ietfnc, ncds2str[rpc_lock->target], NULL);
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         break;
 
@@ -1579,7 +3209,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         node = lyd_new_leaf(node, ietfnc, ncds2str[rpc_lock->target], NULL);
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         break;
 
@@ -1598,16 +3228,16 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             }
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
         if (rpc_g->wd_mode) {
             if (!ietfncwd) {
-                ietfncwd = ly_ctx_get_module(session->ctx, "ietf-netconf-with-defaults", NULL);
+                ietfncwd = session_module(session, session->opts.client.mods.ietfncwd, "ietf-netconf-with-defaults");
                 if (!ietfncwd) {
                     ERR("Session %u: missing \"ietf-netconf-with-defaults\" schema in the context.", session->id);
-                    return NC_MSG_ERROR;
+                    return NULL;
                 }
             }
             switch (rpc_g->wd_mode) {
@@ -1629,7 +3259,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             }
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
@@ -1659,7 +3289,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, ietfnc, "persist", rpc_com->persist);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1667,7 +3297,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, ietfnc, "persist-id", rpc_com->persist_id);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
@@ -1684,7 +3314,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, ietfnc, "persist-id", rpc_can->persist_id);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
@@ -1705,15 +3335,15 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         }
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         break;
 
     case NC_RPC_GETSCHEMA:
-        ietfncmon = ly_ctx_get_module(session->ctx, "ietf-netconf-monitoring", NULL);
+        ietfncmon = session_module(session, session->opts.client.mods.ietfncmon, "ietf-netconf-monitoring");
         if (!ietfncmon) {
             ERR("Session %u: missing \"ietf-netconf-monitoring\" schema in the context.", session->id);
-            return NC_MSG_ERROR;
+            return NULL;
         }
 
         rpc_gs = (struct nc_rpc_getschema *)rpc;
@@ -1722,29 +3352,29 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         node = lyd_new_leaf(data, ietfncmon, "identifier", rpc_gs->identifier);
         if (!node) {
             lyd_free(data);
-            return NC_MSG_ERROR;
+            return NULL;
         }
         if (rpc_gs->version) {
             node = lyd_new_leaf(data, ietfncmon, "version", rpc_gs->version);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         if (rpc_gs->format) {
             node = lyd_new_leaf(data, ietfncmon, "format", rpc_gs->format);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
 
     case NC_RPC_SUBSCRIBE:
-        notifs = ly_ctx_get_module(session->ctx, "notifications", NULL);
+        notifs = session_module(session, session->opts.client.mods.notifs, "notifications");
         if (!notifs) {
             ERR("Session %u: missing \"notifications\" schema in the context.", session->id);
-            return NC_MSG_ERROR;
+            return NULL;
         }
 
         rpc_sub = (struct nc_rpc_subscribe *)rpc;
@@ -1754,7 +3384,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, notifs, "stream", rpc_sub->stream);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1769,7 +3399,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             }
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1777,7 +3407,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, notifs, "startTime", rpc_sub->start);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
 
@@ -1785,19 +3415,54 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
             node = lyd_new_leaf(data, notifs, "stopTime", rpc_sub->stop);
             if (!node) {
                 lyd_free(data);
-                return NC_MSG_ERROR;
+                return NULL;
             }
         }
         break;
     default:
         ERRINT;
-        return NC_MSG_ERROR;
+        return NULL;
     }
 
     if (lyd_validate(&data, LYD_OPT_RPC | LYD_OPT_NOEXTDEPS
                      | (session->flags & NC_SESSION_CLIENT_NOT_STRICT ? 0 : LYD_OPT_STRICT), NULL)) {
         lyd_free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid)
+{
+    NC_MSG_TYPE r;
+    int ret;
+    struct lyd_node *data;
+    uint64_t cur_msgid;
+
+    if (!session) {
+        ERRARG("session");
         return NC_MSG_ERROR;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NC_MSG_ERROR;
+    } else if (!msgid) {
+        ERRARG("msgid");
+        return NC_MSG_ERROR;
+    } else if (session->status != NC_STATUS_RUNNING || session->side != NC_CLIENT) {
+        ERR("Session %u: invalid session to send RPCs.", session->id);
+        return NC_MSG_ERROR;
+    }
+
+    if ((rpc->type == NC_RPC_ACT_GENERIC) && ((struct nc_rpc_act_generic *)rpc)->raw) {
+        /* sent verbatim */
+        data = NULL;
+    } else {
+        data = rpc_to_data(session, rpc);
+        if (!data) {
+            return NC_MSG_ERROR;
+        }
     }
 
     ret = nc_session_lock(session, timeout, __func__);
@@ -1809,7 +3474,13 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         r = NC_MSG_WOULDBLOCK;
     } else {
         /* send RPC, store its message ID */
-        r = nc_send_msg(session, data);
+        if (data) {
+            r = nc_send_msg(session, data);
+        } else if (nc_write_msg(session, NC_MSG_RPC, NULL, NULL, ((struct nc_rpc_act_generic *)rpc)->content.xml_str)) {
+            r = NC_MSG_ERROR;
+        } else {
+            r = NC_MSG_RPC;
+        }
         cur_msgid = session->opts.client.msgid;
     }
     nc_session_unlock(session, timeout, __func__);
@@ -1824,6 +3495,116 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
     return NC_MSG_RPC;
 }
 
+struct nc_rpc_prepared {
+    char *xml;              /* serialized RPC operation */
+};
+
+API struct nc_rpc_prepared *
+nc_rpc_prepare(struct nc_session *session, struct nc_rpc *rpc)
+{
+    struct nc_rpc_prepared *prep;
+    struct lyd_node *data;
+
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG("session");
+        return NULL;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NULL;
+    }
+
+    prep = malloc(sizeof *prep);
+    if (!prep) {
+        ERRMEM;
+        return NULL;
+    }
+    prep->xml = NULL;
+
+    if ((rpc->type == NC_RPC_ACT_GENERIC) && ((struct nc_rpc_act_generic *)rpc)->raw) {
+        /* already serialized */
+        prep->xml = strdup(((struct nc_rpc_act_generic *)rpc)->content.xml_str);
+        if (!prep->xml) {
+            ERRMEM;
+            free(prep);
+            return NULL;
+        }
+        return prep;
+    }
+
+    data = rpc_to_data(session, rpc);
+    if (!data) {
+        free(prep);
+        return NULL;
+    }
+    lyd_print_mem(&prep->xml, data, LYD_XML, LYP_WITHSIBLINGS | LYP_NETCONF);
+    lyd_free(data);
+    if (!prep->xml) {
+        ERR("Session %u: failed to print the RPC.", session->id);
+        free(prep);
+        return NULL;
+    }
+
+    return prep;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_prepared(struct nc_session *session, const struct nc_rpc_prepared *prep, int timeout, uint64_t *msgid)
+{
+    NC_MSG_TYPE r;
+    int ret;
+    uint64_t cur_msgid;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!prep) {
+        ERRARG("prep");
+        return NC_MSG_ERROR;
+    } else if (!msgid) {
+        ERRARG("msgid");
+        return NC_MSG_ERROR;
+    } else if (session->status != NC_STATUS_RUNNING || session->side != NC_CLIENT) {
+        ERR("Session %u: invalid session to send RPCs.", session->id);
+        return NC_MSG_ERROR;
+    }
+
+    ret = nc_session_lock(session, timeout, __func__);
+    if (ret == -1) {
+        /* error */
+        return NC_MSG_ERROR;
+    } else if (!ret) {
+        /* blocking */
+        return NC_MSG_WOULDBLOCK;
+    }
+
+    /* send RPC with only the message-id generated, store it */
+    if (nc_write_msg(session, NC_MSG_RPC, NULL, NULL, prep->xml)) {
+        r = NC_MSG_ERROR;
+    } else {
+        r = NC_MSG_RPC;
+        cur_msgid = session->opts.client.msgid;
+    }
+    nc_session_unlock(session, timeout, __func__);
+
+    if (r != NC_MSG_RPC) {
+        return r;
+    }
+
+    *msgid = cur_msgid;
+    return NC_MSG_RPC;
+}
+
+API void
+nc_rpc_prepared_free(struct nc_rpc_prepared *prep)
+{
+    if (!prep) {
+        return;
+    }
+
+    free(prep->xml);
+    free(prep);
+}
+
 API void
 nc_client_session_set_not_strict(struct nc_session *session)
 {
@@ -1834,3 +3615,849 @@ nc_client_session_set_not_strict(struct nc_session *session)
 
     session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
 }
+
+#ifdef HAVE_EPOLL
+
+/* maximum number of events processed in one nc_client_reactor_process() call */
+#define NC_REACTOR_MAX_EVENTS 64
+
+/* epoll data of the reactor wake up event, other events carry the session index */
+#define NC_REACTOR_WAKEUP UINT64_MAX
+
+struct nc_async_rpc {
+    uint64_t msgid;
+    struct nc_rpc *rpc;
+    void (*reply_clb)(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype, struct nc_reply *reply,
+                      void *user_data);
+    void *user_data;
+    struct lyxml_elem *reply;       /* reply read by a thread receiving another one, to be dispatched */
+    struct nc_async_rpc *next;
+};
+
+struct nc_reactor_session {
+    struct nc_client_reactor *reactor;
+    uint32_t idx;                   /* index in reactor sessions, ACCESS locked with reactor lock */
+    int busy;                       /* being processed by a thread, ACCESS locked with reactor lock */
+    int wake;                       /* to be processed again once it is not busy, ACCESS locked with reactor lock */
+    struct nc_session *session;
+    void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif);
+
+    /* ACCESS locked with pend_lock, lock it after the session lock */
+    struct nc_async_rpc *pending;   /* sent RPCs waiting for their replies */
+    struct nc_async_rpc *ready;     /* sent RPCs with their replies read, in the order they were read */
+    pthread_mutex_t pend_lock;
+};
+
+struct nc_client_reactor {
+    int epfd;
+    int wakefd;                     /* eventfd waking up the threads when stopping them */
+
+    /* ACCESS locked with lock */
+    struct nc_reactor_session **sessions;
+    uint32_t session_count;
+    pthread_mutex_t lock;
+    pthread_cond_t busy_cond;       /* signalled when a session stops being processed */
+
+    pthread_t *threads;
+    uint16_t thread_count;
+    volatile int stop;
+};
+
+static int
+nc_session_get_fd(struct nc_session *session)
+{
+    switch (session->ti_type) {
+    case NC_TI_FD:
+        return session->ti.fd.in;
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        return ssh_get_fd(session->ti.libssh.session);
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        return SSL_get_fd(session->ti.tls);
+#endif
+    default:
+        break;
+    }
+
+    return -1;
+}
+
+/* calls the callbacks of all the pending RPCs with an error and frees them */
+static void
+nc_async_rpc_fail(struct nc_session *session, struct nc_async_rpc *pending)
+{
+    struct nc_async_rpc *next;
+
+    for (; pending; pending = next) {
+        next = pending->next;
+        lyxml_free(session->ctx, pending->reply);
+        pending->reply_clb(session, pending->msgid, NC_MSG_ERROR, NULL, pending->user_data);
+        free(pending);
+    }
+}
+
+/* returns the pending RPC with the message-id removed from the list, or NULL */
+static struct nc_async_rpc *
+nc_reactor_pending_take(struct nc_reactor_session *rs, uint64_t msgid)
+{
+    struct nc_async_rpc **pend_ptr, *pending = NULL;
+
+    /* PEND LOCK */
+    pthread_mutex_lock(&rs->pend_lock);
+    for (pend_ptr = &rs->pending; *pend_ptr; pend_ptr = &(*pend_ptr)->next) {
+        if ((*pend_ptr)->msgid == msgid) {
+            pending = *pend_ptr;
+            *pend_ptr = pending->next;
+            break;
+        }
+    }
+    /* PEND UNLOCK */
+    pthread_mutex_unlock(&rs->pend_lock);
+
+    return pending;
+}
+
+static void
+nc_async_rpc_reply(struct nc_session *session, struct nc_async_rpc *pending, struct lyxml_elem *xml)
+{
+    struct nc_reply *reply;
+    int parseroptions;
+
+    parseroptions = LYD_OPT_NOEXTDEPS | (session->flags & NC_SESSION_CLIENT_NOT_STRICT ? 0 : LYD_OPT_STRICT);
+    reply = parse_reply(session->ctx, xml, pending->rpc, parseroptions);
+    lyxml_free(session->ctx, xml);
+
+    pending->reply_clb(session, pending->msgid, reply ? NC_MSG_REPLY : NC_MSG_ERROR, reply, pending->user_data);
+    nc_reply_free(reply);
+    free(pending);
+}
+
+/* reactor lock is expected to be held, (re)enables a single event for the session,
+ * with now it is also reported when the session can be written to, so almost immediately */
+static int
+nc_reactor_arm(struct nc_client_reactor *reactor, struct nc_reactor_session *rs, int now)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | EPOLLONESHOT | (now ? EPOLLOUT : 0);
+    ev.data.u64 = rs->idx;
+    return epoll_ctl(reactor->epfd, EPOLL_CTL_MOD, nc_session_get_fd(rs->session), &ev);
+}
+
+/* reactor lock is expected to be held and the session not busy, returns the pending RPCs to fail */
+static struct nc_async_rpc *
+nc_reactor_remove(struct nc_client_reactor *reactor, struct nc_reactor_session *rs)
+{
+    struct nc_async_rpc **pend_ptr, *pending;
+    int fd;
+
+    fd = nc_session_get_fd(rs->session);
+    if (fd > -1) {
+        /* the fd may already be closed, ignore errors */
+        epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, fd, NULL);
+    }
+
+    /* move the last session to the freed slot */
+    --reactor->session_count;
+    if (rs->idx < reactor->session_count) {
+        reactor->sessions[rs->idx] = reactor->sessions[reactor->session_count];
+        reactor->sessions[rs->idx]->idx = rs->idx;
+        nc_reactor_arm(reactor, reactor->sessions[rs->idx], 0);
+    }
+    rs->session->opts.client.reactor = NULL;
+
+    /* replies read by other threads fail too, they are not going to be dispatched */
+    for (pend_ptr = &rs->ready; *pend_ptr; pend_ptr = &(*pend_ptr)->next);
+    *pend_ptr = rs->pending;
+    pending = rs->ready;
+    pthread_mutex_destroy(&rs->pend_lock);
+    free(rs);
+
+    return pending;
+}
+
+API struct nc_client_reactor *
+nc_client_reactor_new(void)
+{
+    struct nc_client_reactor *reactor;
+
+    reactor = calloc(1, sizeof *reactor);
+    if (!reactor) {
+        ERRMEM;
+        return NULL;
+    }
+
+    reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epfd == -1) {
+        ERR("Failed to create an epoll instance (%s).", strerror(errno));
+        free(reactor);
+        return NULL;
+    }
+    reactor->wakefd = -1;
+    pthread_mutex_init(&reactor->lock, NULL);
+    pthread_cond_init(&reactor->busy_cond, NULL);
+
+    return reactor;
+}
+
+API void
+nc_client_reactor_free(struct nc_client_reactor *reactor)
+{
+    struct nc_session *session;
+    struct nc_async_rpc *pending;
+
+    if (!reactor) {
+        return;
+    }
+
+    nc_client_reactor_stop_threads(reactor);
+
+    while (reactor->session_count) {
+        /* LOCK */
+        pthread_mutex_lock(&reactor->lock);
+        session = reactor->sessions[reactor->session_count - 1]->session;
+        pending = nc_reactor_remove(reactor, reactor->sessions[reactor->session_count - 1]);
+        /* UNLOCK */
+        pthread_mutex_unlock(&reactor->lock);
+
+        nc_async_rpc_fail(session, pending);
+    }
+
+    if (reactor->wakefd > -1) {
+        close(reactor->wakefd);
+    }
+    close(reactor->epfd);
+    pthread_mutex_destroy(&reactor->lock);
+    pthread_cond_destroy(&reactor->busy_cond);
+    free(reactor->sessions);
+    free(reactor);
+}
+
+API int
+nc_client_reactor_get_fd(const struct nc_client_reactor *reactor)
+{
+    if (!reactor) {
+        ERRARG("reactor");
+        return -1;
+    }
+
+    return reactor->epfd;
+}
+
+API int
+nc_client_reactor_add_session(struct nc_client_reactor *reactor, struct nc_session *session,
+                              void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif))
+{
+    struct nc_reactor_session *rs, **sessions;
+    struct epoll_event ev;
+    int fd, ret = 0;
+
+    if (!reactor) {
+        ERRARG("reactor");
+        return -1;
+    } else if (!session) {
+        ERRARG("session");
+        return -1;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR("Session %u: invalid session to add to a reactor.", session->id);
+        return -1;
+    } else if (session->opts.client.reactor) {
+        ERR("Session %u: session is already added to a reactor.", session->id);
+        return -1;
+    } else if (session->opts.client.ntf_tid) {
+        ERR("Session %u: separate notification thread is running.", session->id);
+        return -1;
+    }
+
+    fd = nc_session_get_fd(session);
+    if (fd < 0) {
+        ERR("Session %u: session without a pollable file descriptor.", session->id);
+        return -1;
+    }
+
+    rs = calloc(1, sizeof *rs);
+    if (!rs) {
+        ERRMEM;
+        return -1;
+    }
+    rs->reactor = reactor;
+    rs->session = session;
+    rs->notif_clb = notif_clb;
+    pthread_mutex_init(&rs->pend_lock, NULL);
+
+    /* LOCK */
+    pthread_mutex_lock(&reactor->lock);
+
+    sessions = realloc(reactor->sessions, (reactor->session_count + 1) * sizeof *reactor->sessions);
+    if (!sessions) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    reactor->sessions = sessions;
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = reactor->session_count;
+    if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        ERR("Session %u: failed to add the session to a reactor (%s).", session->id, strerror(errno));
+        ret = -1;
+        goto cleanup;
+    }
+
+    rs->idx = reactor->session_count;
+    reactor->sessions[reactor->session_count++] = rs;
+    session->opts.client.reactor = rs;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&reactor->lock);
+
+    if (ret) {
+        pthread_mutex_destroy(&rs->pend_lock);
+        free(rs);
+    }
+    return ret;
+}
+
+API int
+nc_client_reactor_del_session(struct nc_client_reactor *reactor, struct nc_session *session)
+{
+    struct nc_async_rpc *pending;
+
+    if (!reactor) {
+        ERRARG("reactor");
+        return -1;
+    } else if (!session || (session->side != NC_CLIENT)) {
+        ERRARG("session");
+        return -1;
+    } else if (!session->opts.client.reactor || (session->opts.client.reactor->reactor != reactor)) {
+        ERR("Session %u: session is not added to the reactor.", session->id);
+        return -1;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&reactor->lock);
+
+    /* wait for any thread processing the session, which may also remove it */
+    while (session->opts.client.reactor && session->opts.client.reactor->busy) {
+        pthread_cond_wait(&reactor->busy_cond, &reactor->lock);
+    }
+    if (!session->opts.client.reactor) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&reactor->lock);
+        return 0;
+    }
+    pending = nc_reactor_remove(reactor, session->opts.client.reactor);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&reactor->lock);
+
+    nc_async_rpc_fail(session, pending);
+    return 0;
+}
+
+void
+nc_client_reactor_session_free(struct nc_session *session)
+{
+    nc_client_reactor_del_session(session->opts.client.reactor->reactor, session);
+}
+
+void
+nc_client_reactor_session_unlocked(struct nc_session *session)
+{
+    struct nc_reactor_session *rs = session->opts.client.reactor;
+
+    if (!session->opts.client.reactor_wait || !rs) {
+        return;
+    }
+    session->opts.client.reactor_wait = 0;
+
+    /* LOCK */
+    pthread_mutex_lock(&rs->reactor->lock);
+    if (rs->busy) {
+        rs->wake = 1;
+    } else if (nc_reactor_arm(rs->reactor, rs, 1)) {
+        ERR("Session %u: failed to re-enable the session in the reactor (%s).", session->id, strerror(errno));
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&rs->reactor->lock);
+}
+
+int
+nc_client_reactor_take_reply(struct nc_session *session, uint64_t msgid, struct lyxml_elem *xml)
+{
+    struct nc_reactor_session *rs = session->opts.client.reactor;
+    struct nc_async_rpc **pend_ptr, *pending;
+
+    if (!rs || !(pending = nc_reactor_pending_take(rs, msgid))) {
+        return 0;
+    }
+    pending->reply = xml;
+
+    /* PEND LOCK */
+    pthread_mutex_lock(&rs->pend_lock);
+    for (pend_ptr = &rs->ready; *pend_ptr; pend_ptr = &(*pend_ptr)->next);
+    *pend_ptr = pending;
+    /* PEND UNLOCK */
+    pthread_mutex_unlock(&rs->pend_lock);
+
+    /* dispatched by the reactor once the session is unlocked */
+    session->opts.client.reactor_wait = 1;
+    return 1;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_async(struct nc_session *session, struct nc_rpc *rpc, int timeout,
+                  void (*reply_clb)(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype,
+                                    struct nc_reply *reply, void *user_data),
+                  void *user_data, uint64_t *msgid)
+{
+    struct nc_reactor_session *rs;
+    struct nc_async_rpc *pending;
+    struct lyxml_elem *xml = NULL;
+    NC_MSG_TYPE r;
+    int locked, dropped = 0;
+
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NC_MSG_ERROR;
+    } else if (!reply_clb) {
+        ERRARG("reply_clb");
+        return NC_MSG_ERROR;
+    } else if (!session->opts.client.reactor) {
+        ERR("Session %u: session is not added to a reactor.", session->id);
+        return NC_MSG_ERROR;
+    }
+    rs = session->opts.client.reactor;
+
+    pending = malloc(sizeof *pending);
+    if (!pending) {
+        ERRMEM;
+        return NC_MSG_ERROR;
+    }
+    pending->rpc = rpc;
+    pending->reply_clb = reply_clb;
+    pending->user_data = user_data;
+    pending->reply = NULL;
+
+    r = nc_send_rpc(session, rpc, timeout, &pending->msgid);
+    if (r != NC_MSG_RPC) {
+        free(pending);
+        return r;
+    }
+    if (msgid) {
+        *msgid = pending->msgid;
+    }
+
+    /* the reply may have already been read and stored, the reactor stores it under the session lock too */
+    locked = nc_session_lock(session, -1, __func__);
+    if (locked == 1) {
+        xml = take_reply(session, pending->msgid);
+        if (!xml && take_dropped(session, pending->msgid)) {
+            dropped = 1;
+        }
+    }
+    if (!xml && !dropped) {
+        /* PEND LOCK */
+        pthread_mutex_lock(&rs->pend_lock);
+        pending->next = rs->pending;
+        rs->pending = pending;
+        /* PEND UNLOCK */
+        pthread_mutex_unlock(&rs->pend_lock);
+    }
+    if (locked == 1) {
+        nc_session_unlock(session, -1, __func__);
+    }
+
+    if (xml) {
+        nc_async_rpc_reply(session, pending, xml);
+    } else if (dropped) {
+        ERR("Session %u: the reply to the RPC with message-id %"PRIu64" was dropped, too many replies were "
+            "received before being requested.", session->id, pending->msgid);
+        pending->next = NULL;
+        nc_async_rpc_fail(session, pending);
+    }
+    return NC_MSG_RPC;
+}
+
+/* read and dispatch all the messages available on a session, returns the number of them or -1 if the session failed,
+ * wait is set if another thread is using the session, which then re-enables it in the reactor */
+static int
+nc_reactor_session_dispatch(struct nc_reactor_session *rs, int *wait)
+{
+    struct nc_session *session = rs->session;
+    struct nc_async_rpc *pending;
+    struct nc_notif *notif;
+    struct lyxml_elem *xml;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    int r, count = 0;
+
+    *wait = 0;
+    while (1) {
+        r = nc_session_lock(session, 0, __func__);
+        if (r == -1) {
+            return -1;
+        } else if (!r) {
+            /* LOCK */
+            pthread_mutex_lock(session->ti_lock);
+            if (*session->ti_inuse) {
+                /* do not wait for it, it is re-enabled once unlocked */
+                session->opts.client.reactor_wait = 1;
+                *wait = 1;
+            }
+            /* UNLOCK */
+            pthread_mutex_unlock(session->ti_lock);
+
+            if (*wait) {
+                return count;
+            }
+            /* unlocked meanwhile */
+            continue;
+        }
+
+        /* messages read by a thread waiting for a reply come first, a message not received whole
+         * is kept in the session until the rest arrives */
+        pending = NULL;
+        xml = take_notif(session);
+        if (xml) {
+            msgtype = NC_MSG_NOTIF;
+        } else {
+            /* PEND LOCK */
+            pthread_mutex_lock(&rs->pend_lock);
+            pending = rs->ready;
+            if (pending) {
+                rs->ready = pending->next;
+            }
+            /* PEND UNLOCK */
+            pthread_mutex_unlock(&rs->pend_lock);
+
+            if (pending) {
+                xml = pending->reply;
+                pending->reply = NULL;
+                msgtype = NC_MSG_REPLY;
+            } else {
+                msgtype = nc_read_msg_nonblock(session, &xml);
+            }
+        }
+
+        if ((msgtype == NC_MSG_REPLY) && !pending) {
+            msgid = get_reply_msgid(xml);
+            pending = nc_reactor_pending_take(rs, msgid);
+            if (!pending) {
+                /* a reply to a synchronously sent RPC or to one still being sent, keep it */
+                if (!msgid || (msgid > session->opts.client.msgid)) {
+                    ERR("Session %u: received an <rpc-reply> with an unexpected message-id, discarding it.", session->id);
+                    lyxml_free(session->ctx, xml);
+                } else if (store_reply(session, msgid, xml)) {
+                    lyxml_free(session->ctx, xml);
+                }
+            }
+        }
+        nc_session_unlock(session, 0, __func__);
+
+        switch (msgtype) {
+        case NC_MSG_WOULDBLOCK:
+            return count;
+
+        case NC_MSG_REPLY:
+            if (pending) {
+                nc_async_rpc_reply(session, pending, xml);
+            }
+            break;
+
+        case NC_MSG_NOTIF:
+            if (!rs->notif_clb) {
+                WRN("Session %u: received a <notification> but no callback is set, discarding it.", session->id);
+                lyxml_free(session->ctx, xml);
+            } else if (!parse_notif(session, xml, &notif)) {
+                rs->notif_clb(session, notif);
+                nc_notif_free(notif);
+            }
+            break;
+
+        case NC_MSG_HELLO:
+            ERR("Session %u: received another <hello> message.", session->id);
+            lyxml_free(session->ctx, xml);
+            break;
+
+        case NC_MSG_RPC:
+            ERR("Session %u: received <rpc> from a NETCONF server.", session->id);
+            lyxml_free(session->ctx, xml);
+            break;
+
+        default:
+            /* NC_MSG_ERROR */
+            return -1;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+API int
+nc_client_reactor_process(struct nc_client_reactor *reactor, int timeout)
+{
+    struct epoll_event events[NC_REACTOR_MAX_EVENTS];
+    struct nc_reactor_session *rs;
+    struct nc_session *session;
+    struct nc_async_rpc *pending;
+    int i, n, r, wait, count = 0;
+
+    if (!reactor) {
+        ERRARG("reactor");
+        return -1;
+    }
+
+    n = epoll_wait(reactor->epfd, events, NC_REACTOR_MAX_EVENTS, timeout);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        ERR("Epoll wait failed (%s).", strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (events[i].data.u64 == NC_REACTOR_WAKEUP) {
+            continue;
+        }
+
+        /* LOCK */
+        pthread_mutex_lock(&reactor->lock);
+
+        /* the event may be stale if sessions were removed meanwhile and every session is processed
+         * by a single thread at a time, it is re-enabled once its processing finishes */
+        if ((events[i].data.u64 >= reactor->session_count) || reactor->sessions[events[i].data.u64]->busy) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&reactor->lock);
+            continue;
+        }
+        rs = reactor->sessions[events[i].data.u64];
+        rs->busy = 1;
+        session = rs->session;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&reactor->lock);
+
+        r = nc_reactor_session_dispatch(rs, &wait);
+
+        /* LOCK */
+        pthread_mutex_lock(&reactor->lock);
+
+        rs->busy = 0;
+        pending = NULL;
+        if (r > -1) {
+            count += r;
+
+            /* when waiting for the session, it is re-enabled by the thread using it, unless it already tried */
+            if ((!wait || rs->wake) && nc_reactor_arm(reactor, rs, rs->wake)) {
+                ERR("Session %u: failed to re-enable the session in the reactor (%s).", session->id, strerror(errno));
+                r = -1;
+            }
+            rs->wake = 0;
+        } else {
+            /* the session is not usable anymore */
+            ERR("Session %u: failed, removing it from the reactor.", session->id);
+        }
+        if (r == -1) {
+            pending = nc_reactor_remove(reactor, rs);
+        }
+        pthread_cond_broadcast(&reactor->busy_cond);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&reactor->lock);
+
+        nc_async_rpc_fail(session, pending);
+    }
+
+    return count;
+}
+
+static void *
+nc_reactor_thread(void *arg)
+{
+    struct nc_client_reactor *reactor = arg;
+
+    while (!reactor->stop) {
+        if (nc_client_reactor_process(reactor, -1) == -1) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+API int
+nc_client_reactor_start_threads(struct nc_client_reactor *reactor, uint16_t thread_count)
+{
+    struct epoll_event ev;
+    int ret;
+
+    if (!reactor) {
+        ERRARG("reactor");
+        return -1;
+    } else if (!thread_count) {
+        ERRARG("thread_count");
+        return -1;
+    } else if (reactor->threads) {
+        ERR("Reactor threads are already running.");
+        return -1;
+    }
+
+    if (reactor->wakefd == -1) {
+        reactor->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (reactor->wakefd == -1) {
+            ERR("Failed to create an eventfd (%s).", strerror(errno));
+            return -1;
+        }
+
+        /* level-triggered and never read so that it wakes up all the threads */
+        ev.events = EPOLLIN;
+        ev.data.u64 = NC_REACTOR_WAKEUP;
+        if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->wakefd, &ev) == -1) {
+            ERR("Failed to add an eventfd to the reactor (%s).", strerror(errno));
+            close(reactor->wakefd);
+            reactor->wakefd = -1;
+            return -1;
+        }
+    }
+
+    reactor->threads = malloc(thread_count * sizeof *reactor->threads);
+    if (!reactor->threads) {
+        ERRMEM;
+        return -1;
+    }
+
+    reactor->stop = 0;
+    for (reactor->thread_count = 0; reactor->thread_count < thread_count; ++reactor->thread_count) {
+        ret = pthread_create(&reactor->threads[reactor->thread_count], NULL, nc_reactor_thread, reactor);
+        if (ret) {
+            ERR("Failed to create a new thread (%s).", strerror(ret));
+            nc_client_reactor_stop_threads(reactor);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+API void
+nc_client_reactor_stop_threads(struct nc_client_reactor *reactor)
+{
+    uint64_t val = 1;
+    uint16_t i;
+
+    if (!reactor || !reactor->threads) {
+        return;
+    }
+
+    reactor->stop = 1;
+    if (write(reactor->wakefd, &val, sizeof val) != sizeof val) {
+        ERR("Failed to wake up the reactor threads (%s).", strerror(errno));
+    }
+    for (i = 0; i < reactor->thread_count; ++i) {
+        pthread_join(reactor->threads[i], NULL);
+    }
+
+    /* reset the eventfd */
+    if (read(reactor->wakefd, &val, sizeof val) != sizeof val) {
+        ERR("Failed to reset the reactor eventfd (%s).", strerror(errno));
+    }
+
+    free(reactor->threads);
+    reactor->threads = NULL;
+    reactor->thread_count = 0;
+}
+
+#else
+
+void
+nc_client_reactor_session_free(struct nc_session *UNUSED(session))
+{
+}
+
+void
+nc_client_reactor_session_unlocked(struct nc_session *UNUSED(session))
+{
+}
+
+int
+nc_client_reactor_take_reply(struct nc_session *UNUSED(session), uint64_t UNUSED(msgid),
+                             struct lyxml_elem *UNUSED(xml))
+{
+    return 0;
+}
+
+API struct nc_client_reactor *
+nc_client_reactor_new(void)
+{
+    ERR("Client reactor is not supported on this system.");
+    return NULL;
+}
+
+API void
+nc_client_reactor_free(struct nc_client_reactor *UNUSED(reactor))
+{
+}
+
+API int
+nc_client_reactor_get_fd(const struct nc_client_reactor *UNUSED(reactor))
+{
+    ERRARG("reactor");
+    return -1;
+}
+
+API int
+nc_client_reactor_add_session(struct nc_client_reactor *UNUSED(reactor), struct nc_session *UNUSED(session),
+                              void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif))
+{
+    (void)notif_clb;
+    ERRARG("reactor");
+    return -1;
+}
+
+API int
+nc_client_reactor_del_session(struct nc_client_reactor *UNUSED(reactor), struct nc_session *UNUSED(session))
+{
+    ERRARG("reactor");
+    return -1;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_async(struct nc_session *session, struct nc_rpc *UNUSED(rpc), int UNUSED(timeout),
+                  void (*reply_clb)(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype,
+                                    struct nc_reply *reply, void *user_data),
+                  void *UNUSED(user_data), uint64_t *UNUSED(msgid))
+{
+    (void)reply_clb;
+    ERR("Session %u: session is not added to a reactor.", session ? session->id : 0);
+    return NC_MSG_ERROR;
+}
+
+API int
+nc_client_reactor_process(struct nc_client_reactor *UNUSED(reactor), int UNUSED(timeout))
+{
+    ERRARG("reactor");
+    return -1;
+}
+
+API int
+nc_client_reactor_start_threads(struct nc_client_reactor *UNUSED(reactor), uint16_t UNUSED(thread_count))
+{
+    ERRARG("reactor");
+    return -1;
+}
+
+API void
+nc_client_reactor_stop_threads(struct nc_client_reactor *UNUSED(reactor))
+{
+}
+
+#endif /* HAVE_EPOLL */
@@ -51,6 +51,37 @@ int nc_client_set_schema_searchpath(const char *path);
  */
 const char *nc_client_get_schema_searchpath(void);
 
+/**
+ * @brief Set a directory for caching YANG schemas retrieved from servers by \<get-schema\>.
+ *
+ * Schemas with a revision are cached as "<name>@<revision>.yang" files, with their content hash
+ * in a ".hash" file, and used instead of downloading them again on later connects, by any
+ * process using the same directory. The directory must exist and be writable.
+ *
+ * @param[in] path Schema cache directory, NULL to disable caching.
+ * @return 0 on success, 1 on (memory allocation) failure.
+ */
+int nc_client_set_schema_cache_dir(const char *path);
+
+/**
+ * @brief Get schema cache directory that was set by nc_client_set_schema_cache_dir().
+ *
+ * @return Schema cache directory, NULL if not set.
+ */
+const char *nc_client_get_schema_cache_dir(void);
+
+/**
+ * @brief Enable or disable sharing of the contexts created for client sessions.
+ *
+ * If enabled, a session connected without a context uses the context of another such session
+ * to a server with the same capabilities (and the same schema searchpath) instead of filling
+ * its own one with all the server models. Shared contexts are freed with their last session.
+ * It is disabled by default.
+ *
+ * @param[in] enabled Whether the contexts are shared or not.
+ */
+void nc_client_set_ctx_pool(int enabled);
+
 /**
  * @brief Initialize libssh and/or libssl/libcrypto for use in the client.
  */
@@ -302,6 +333,27 @@ int nc_client_tls_set_crl_paths(const char *crl_file, const char *crl_dir);
  */
 void nc_client_tls_get_crl_paths(const char **crl_file, const char **crl_dir);
 
+/**
+ * @brief Set the cache of TLS sessions used to resume the sessions on reconnects to the same server.
+ *
+ * A session is remembered for every host and port connected to and offered to the server
+ * on the next connect, which can then skip the full handshake. The cache is flushed whenever
+ * the certificate paths change. By default, up to 256 sessions are cached for their lifetime.
+ *
+ * @param[in] max_count Maximum number of cached sessions, the oldest are forgotten first. 0 disables the cache.
+ * @param[in] ttl Time in seconds a session is cached for, 0 for the lifetime set by the server.
+ */
+void nc_client_tls_set_session_cache(uint32_t max_count, uint32_t ttl);
+
+/**
+ * @brief Get statistics of the TLS session cache.
+ *
+ * @param[out] count Optional number of cached sessions.
+ * @param[out] hits Optional number of resumed handshakes.
+ * @param[out] misses Optional number of full handshakes performed with the cache enabled.
+ */
+void nc_client_tls_get_session_cache_stats(uint32_t *count, uint32_t *hits, uint32_t *misses);
+
 /**
  * @brief Connect to the NETCONF server using TLS transport (via libssl)
  *
@@ -341,6 +393,45 @@ struct nc_session *nc_connect_libssl(SSL *tls, struct ly_ctx *ctx);
 
 #endif /* NC_ENABLED_TLS */
 
+#if defined(NC_ENABLED_SSH) || defined(NC_ENABLED_TLS)
+
+/**
+ * @brief Target of nc_connect_bulk().
+ */
+struct nc_connect_target {
+    NC_TRANSPORT_IMPL ti;   /**< #NC_TI_LIBSSH or #NC_TI_OPENSSL */
+    const char *host;       /**< hostname or address of the server */
+    uint16_t port;          /**< port of the server */
+};
+
+/**
+ * @brief Connect to many NETCONF servers concurrently.
+ *
+ * Each target is connected as by nc_connect_ssh() or nc_connect_tls() with the current client options,
+ * at most \p max_concurrent of them at the same time, so the total time depends on the slowest
+ * handshakes rather than on their sum. Returns once all the targets have been tried.
+ *
+ * Consider enabling the context pool (nc_client_set_ctx_pool()) so that servers with the same
+ * capabilities share a single context. If \p ctx is set, it is shared by all the sessions and the models
+ * missing in it are loaded for one session at a time, so it should preferably include all the required
+ * models already.
+ *
+ * @param[in] targets Array of the servers to connect to.
+ * @param[in] count Number of \p targets.
+ * @param[in] ctx Optional context for all the sessions, same as for nc_connect_ssh().
+ * @param[in] max_concurrent Maximum number of connections being established at the same time, at most 64
+ *            are used.
+ * @param[in] session_clb Function called for every target with its index in \p targets and the new session
+ *            (or NULL if connecting failed), which is then owned by the caller. The calls come from different
+ *            threads and are not serialized, so the callback must be thread-safe.
+ * @param[in] user_data Arbitrary user data passed to \p session_clb.
+ * @return Number of sessions established, -1 on error.
+ */
+int nc_connect_bulk(const struct nc_connect_target *targets, uint32_t count, struct ly_ctx *ctx, uint16_t max_concurrent,
+                    void (*session_clb)(uint32_t idx, struct nc_session *session, void *user_data), void *user_data);
+
+#endif /* NC_ENABLED_SSH || NC_ENABLED_TLS */
+
 /**
  * @brief Get session capabilities.
  *
@@ -354,6 +445,8 @@ const char * const *nc_session_get_cpblts(const struct nc_session *session);
  *
  * @param[in] session Session to check.
  * @param[in] capab Capability to look for, capability with any additional suffix will match.
+ *            If it is a whole capability URI, the first capability with it is returned, otherwise
+ *            the first matching capability in the strcmp() order.
  * @return Matching capability, NULL if none found.
  */
 const char *nc_session_cpblt(const struct nc_session *session, const char *capab);
@@ -366,6 +459,42 @@ const char *nc_session_cpblt(const struct nc_session *session, const char *capab
  */
 int nc_session_ntf_thread_running(const struct nc_session *session);
 
+/**
+ * @brief Set limits of the queue of notifications received while waiting for an RPC reply
+ *        on a session with a notification thread. Notifications not fitting the queue are dropped.
+ *
+ * @param[in] max_count Maximum number of queued notifications, 0 for no limit (default).
+ * @param[in] max_size Maximum estimated memory of queued notifications in bytes, 0 for no limit (default).
+ */
+void nc_client_set_notif_queue_limits(uint32_t max_count, size_t max_size);
+
+/**
+ * @brief Set limits of the table of RPC replies received before being requested, for example replies
+ *        to RPCs whose nc_recv_reply() timed out. Replies not fitting the table are dropped,
+ *        nc_recv_reply() then returns #NC_MSG_ERROR for them.
+ *
+ * @param[in] max_count Maximum number of stored replies, 0 for no limit (default 1024).
+ * @param[in] max_size Maximum estimated memory of stored replies in bytes, 0 for no limit (default).
+ */
+void nc_client_set_reply_queue_limits(uint32_t max_count, size_t max_size);
+
+/**
+ * @brief Get the current state of the session message queues.
+ *
+ * The values are read without locking the session so they are only informative.
+ *
+ * @param[in] session Client session.
+ * @param[out] reply_count Optional number of RPC replies received before being requested.
+ * @param[out] reply_size Optional estimated memory of these replies in bytes.
+ * @param[out] reply_dropped Optional number of replies dropped because the table was full.
+ * @param[out] notif_count Optional number of queued notifications.
+ * @param[out] notif_size Optional estimated memory of queued notifications in bytes.
+ * @param[out] notif_dropped Optional number of notifications dropped because the queue was full.
+ * @return 0 on success, -1 on error.
+ */
+int nc_session_get_queue_stats(const struct nc_session *session, uint32_t *reply_count, size_t *reply_size,
+                               uint32_t *reply_dropped, uint32_t *notif_count, size_t *notif_size, uint32_t *notif_dropped);
+
 /**
  * @brief Receive NETCONF RPC reply.
  *
@@ -375,6 +504,10 @@ int nc_session_ntf_thread_running(const struct nc_session *session);
  * that the reply data in these cases should not be validated with \b LYD_OPT_RPCREPLY,
  * but \b LYD_OPT_GET and \b LYD_OPT_GETCONFIG, respectively.
  *
+ * Several RPCs can be sent before receiving any replies. Replies to other sent RPCs
+ * read while waiting for the one with \p msgid are stored in the session and returned
+ * by later calls for their message IDs, regardless of the order they arrived in.
+ *
  * @param[in] session NETCONF session from which the function gets data. It must be the
  *            client side session object.
  * @param[in] rpc Original RPC this should be the reply to.
@@ -388,11 +521,44 @@ int nc_session_ntf_thread_running(const struct nc_session *session);
  *         #NC_MSG_WOULDBLOCK if \p timeout has elapsed,
  *         #NC_MSG_ERROR if reading has failed,
  *         #NC_MSG_NOTIF if a notification was read instead (call this function again to get the reply), and
- *         #NC_MSG_REPLY_ERR_MSGID if a reply with missing or wrong message-id was received.
+ *         #NC_MSG_REPLY_ERR_MSGID if a reply with missing, invalid, or never sent message-id was received.
  */
 NC_MSG_TYPE nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout,
                           int parseroptions, struct nc_reply **reply);
 
+/**
+ * @brief Receive NETCONF RPC reply to \<get\> or \<get-config\>, passing the data to a callback
+ * subtree by subtree.
+ *
+ * Works as nc_recv_reply(), but the reply data are not collected into a single tree. Each top-level
+ * data subtree is parsed as soon as it is received and given to \p data_clb together with its XML
+ * serialization, then freed. The memory needed therefore does not depend on the size of the reply,
+ * only on the size of its largest top-level subtree. On success, the \p reply is of type #NC_RPL_DATA
+ * with no data, \<rpc-error\> replies are returned as by nc_recv_reply().
+ *
+ * The subtrees are validated separately, so constraints referencing nodes from another
+ * top-level subtree cannot be checked.
+ *
+ * @param[in] session NETCONF session from which the function gets data. It must be the
+ *            client side session object.
+ * @param[in] rpc Original \<get\> or \<get-config\> RPC this should be the reply to.
+ * @param[in] msgid Expected message ID of the reply.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ *            waiting and 0 for immediate return if data are not available on the wire.
+ * @param[in] parseroptions libyang parseroptions flags, same as for nc_recv_reply().
+ * @param[in] data_clb Callback for every top-level data subtree. \p subtree can be NULL if it was not
+ *            recognized and the session is not strict. It is called with the session locked, so it must not use
+ *            the \p session. Non-zero return value stops processing of the reply, which is then skipped
+ *            and #NC_MSG_ERROR returned.
+ * @param[in] user_data Arbitrary user data passed to \p data_clb.
+ * @param[out] reply Resulting object of NETCONF RPC reply.
+ * @return Same values as nc_recv_reply().
+ */
+NC_MSG_TYPE nc_recv_reply_stream(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout,
+                                 int parseroptions, int (*data_clb)(struct nc_session *session,
+                                 const struct lyd_node *subtree, const char *xml, void *user_data),
+                                 void *user_data, struct nc_reply **reply);
+
 /**
  * @brief Receive NETCONF Notification.
  *
@@ -417,10 +583,51 @@ NC_MSG_TYPE nc_recv_notif(struct nc_session* session, int timeout, struct nc_not
  *            \<notificationComplete\>). Parameters are the session the notification was received on
  *            and the notification itself.
  * @return 0 if the thread was successfully created, -1 on error.
+ *
+ * For many sessions, consider a reactor with its own threads (nc_client_reactor_start_threads()),
+ * which does not need a thread for every session.
  */
 int nc_recv_notif_dispatch(struct nc_session *session,
                            void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif));
 
+/**
+ * @brief Receive NETCONF Notification without parsing it into a libyang data tree.
+ *
+ * Meant for forwarding high rates of notifications, only the eventTime and the notification
+ * root element are found and the message is returned as received, no XML tree is built.
+ * The notification can still be parsed later with nc_notif_raw_parse().
+ *
+ * @param[in] session NETCONF session from which the function gets data. It must be the
+ *            client side session object.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ *            waiting and 0 for immediate return if data are not available on the wire.
+ * @param[out] notif Resulting raw Notification, free with nc_notif_raw_free().
+ * @return Same values as nc_recv_notif().
+ */
+NC_MSG_TYPE nc_recv_notif_raw(struct nc_session *session, int timeout, struct nc_notif_raw **notif);
+
+/**
+ * @brief Receive raw NETCONF Notifications in a separate thread, same as nc_recv_notif_dispatch()
+ *        but without parsing them (see nc_recv_notif_raw()).
+ *
+ * @param[in] session Netconf session to read notifications from.
+ * @param[in] notif_clb Function that is called for every received notification (including
+ *            \<notificationComplete\>). Parameters are the session the notification was received on
+ *            and the raw notification, which is freed once the callback returns.
+ * @return 0 if the thread was successfully created, -1 on error.
+ */
+int nc_recv_notif_dispatch_raw(struct nc_session *session,
+                               void (*notif_clb)(struct nc_session *session, const struct nc_notif_raw *notif));
+
+/**
+ * @brief Parse a raw NETCONF Notification into a libyang data tree.
+ *
+ * @param[in] session NETCONF session the notification was received on.
+ * @param[in] notif Raw Notification.
+ * @return Parsed Notification, free with nc_notif_free(), NULL on error.
+ */
+struct nc_notif *nc_notif_raw_parse(struct nc_session *session, const struct nc_notif_raw *notif);
+
 /**
  * @brief Send NETCONF RPC message via the session.
  *
@@ -436,6 +643,161 @@ int nc_recv_notif_dispatch(struct nc_session *session,
  */
 NC_MSG_TYPE nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid);
 
+/**
+ * @brief NETCONF RPC serialized in advance so that it can be sent repeatedly.
+ */
+struct nc_rpc_prepared;
+
+/**
+ * @brief Create and serialize an RPC once to be sent many times by nc_send_rpc_prepared().
+ *
+ * It can be sent on any session to a server supporting the same modules as \p session.
+ * Replies are received by nc_recv_reply() with the original \p rpc.
+ *
+ * @param[in] session NETCONF session whose context is used for creating the RPC.
+ * @param[in] rpc NETCONF RPC object to prepare.
+ * @return Prepared RPC, NULL on error.
+ */
+struct nc_rpc_prepared *nc_rpc_prepare(struct nc_session *session, struct nc_rpc *rpc);
+
+/**
+ * @brief Send a prepared NETCONF RPC message via the session, only its message ID is generated.
+ *
+ * @param[in] session NETCONF session where the RPC will be written.
+ * @param[in] prep Prepared RPC.
+ * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
+ *            waiting and 0 for return if data cannot be sent immediately.
+ * @param[out] msgid If RPC was successfully sent, this is it's message ID.
+ * @return #NC_MSG_RPC on success,
+ *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_send_rpc_prepared(struct nc_session *session, const struct nc_rpc_prepared *prep, int timeout,
+                                 uint64_t *msgid);
+
+/**
+ * @brief Free a prepared RPC.
+ *
+ * @param[in] prep Prepared RPC to free.
+ */
+void nc_rpc_prepared_free(struct nc_rpc_prepared *prep);
+
+/**
+ * @brief Client reactor multiplexing reading from several NETCONF sessions.
+ *
+ * Available only on systems supporting epoll.
+ */
+struct nc_client_reactor;
+
+/**
+ * @brief Create a client reactor.
+ *
+ * @return New reactor, NULL on error.
+ */
+struct nc_client_reactor *nc_client_reactor_new(void);
+
+/**
+ * @brief Free a client reactor. Sessions are only removed from it, pending asynchronous RPCs fail.
+ *
+ * @param[in] reactor Reactor to free.
+ */
+void nc_client_reactor_free(struct nc_client_reactor *reactor);
+
+/**
+ * @brief Get the file descriptor of a reactor. It becomes readable whenever any of its sessions
+ *        has data to read so it can be integrated into an external event loop.
+ *
+ * @param[in] reactor Reactor to use.
+ * @return Reactor file descriptor, -1 on error.
+ */
+int nc_client_reactor_get_fd(const struct nc_client_reactor *reactor);
+
+/**
+ * @brief Add a session to a reactor. All the messages received on the session are then read
+ *        only by nc_client_reactor_process(), replies to RPCs sent by nc_send_rpc() are kept
+ *        for nc_recv_reply(). Notifications and replies to nc_send_rpc_async() read by
+ *        nc_recv_reply() are passed to the reactor and dispatched by it.
+ *
+ * A session can be added to a single reactor and there cannot be a notification thread
+ * (nc_recv_notif_dispatch()) running on it. Several NETCONF sessions sharing a single SSH
+ * session are not supported.
+ *
+ * @param[in] reactor Reactor to add to.
+ * @param[in] session Client session to add.
+ * @param[in] notif_clb Optional function called for every received notification.
+ *            If not set, notifications are discarded.
+ * @return 0 on success, -1 on error.
+ */
+int nc_client_reactor_add_session(struct nc_client_reactor *reactor, struct nc_session *session,
+                                  void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif));
+
+/**
+ * @brief Remove a session from a reactor, all its pending asynchronous RPCs fail.
+ *        Also performed by nc_session_free().
+ *
+ * @param[in] reactor Reactor to remove from.
+ * @param[in] session Session to remove.
+ * @return 0 on success, -1 on error.
+ */
+int nc_client_reactor_del_session(struct nc_client_reactor *reactor, struct nc_session *session);
+
+/**
+ * @brief Read and dispatch all the messages available on the sessions of a reactor.
+ *
+ * Callbacks are called from this function and must not remove or free any sessions
+ * of the reactor. A session that fails while reading is removed from the reactor.
+ * The function can be called by several threads at once, each session is then being
+ * processed by a single thread at a time so its messages are dispatched in order.
+ * It never waits for the rest of a message, it is kept with the session until it arrives.
+ *
+ * @param[in] reactor Reactor to process.
+ * @param[in] timeout Timeout for waiting for any data in milliseconds. Use negative value for
+ *            infinite waiting and 0 for immediate return.
+ * @return Number of dispatched messages (0 on timeout), -1 on error.
+ */
+int nc_client_reactor_process(struct nc_client_reactor *reactor, int timeout);
+
+/**
+ * @brief Start a fixed pool of threads processing a reactor, which is useful for receiving
+ *        notifications on many sessions instead of using nc_recv_notif_dispatch() for each of them.
+ *
+ * @param[in] reactor Reactor to process.
+ * @param[in] thread_count Number of threads to start.
+ * @return 0 on success, -1 on error.
+ */
+int nc_client_reactor_start_threads(struct nc_client_reactor *reactor, uint16_t thread_count);
+
+/**
+ * @brief Stop all the threads processing a reactor. Also performed by nc_client_reactor_free().
+ *
+ * @param[in] reactor Reactor with running threads.
+ */
+void nc_client_reactor_stop_threads(struct nc_client_reactor *reactor);
+
+/**
+ * @brief Send NETCONF RPC message via a session added to a reactor without waiting for its reply.
+ *
+ * The reply is dispatched from nc_client_reactor_process() (or directly from this function
+ * if it has already been received) by calling \p reply_clb. Its \p msgtype is #NC_MSG_REPLY
+ * with the parsed \p reply that is freed after the callback returns, or #NC_MSG_ERROR with
+ * NULL \p reply if the reply could not be parsed or the session was removed from the reactor.
+ *
+ * @param[in] session NETCONF session added to a reactor.
+ * @param[in] rpc NETCONF RPC object to send. It must not be freed until \p reply_clb is called.
+ * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
+ *            waiting and 0 for return if data cannot be sent immediately.
+ * @param[in] reply_clb Function called with the reply.
+ * @param[in] user_data Arbitrary user data passed to \p reply_clb.
+ * @param[out] msgid Optional message ID of the sent RPC.
+ * @return #NC_MSG_RPC on success,
+ *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_send_rpc_async(struct nc_session *session, struct nc_rpc *rpc, int timeout,
+                              void (*reply_clb)(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype,
+                                                struct nc_reply *reply, void *user_data),
+                              void *user_data, uint64_t *msgid);
+
 /**
  * @brief Make a session not strict when sending RPCs and receiving RPC replies. In other words,
  *        it will silently skip unknown nodes without an error.
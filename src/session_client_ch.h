@@ -238,6 +238,23 @@ int nc_client_tls_ch_set_crl_paths(const char *crl_file, const char *crl_dir);
  */
 void nc_client_tls_ch_get_crl_paths(const char **crl_file, const char **crl_dir);
 
+/**
+ * @brief Set the cache of Call Home TLS sessions, see nc_client_tls_set_session_cache().
+ *
+ * @param[in] max_count Maximum number of cached sessions, the oldest are forgotten first. 0 disables the cache.
+ * @param[in] ttl Time in seconds a session is cached for, 0 for the lifetime set by the server.
+ */
+void nc_client_tls_ch_set_session_cache(uint32_t max_count, uint32_t ttl);
+
+/**
+ * @brief Get statistics of the Call Home TLS session cache.
+ *
+ * @param[out] count Optional number of cached sessions.
+ * @param[out] hits Optional number of resumed handshakes.
+ * @param[out] misses Optional number of full handshakes performed with the cache enabled.
+ */
+void nc_client_tls_ch_get_session_cache_stats(uint32_t *count, uint32_t *hits, uint32_t *misses);
+
 #endif /* NC_ENABLED_TLS */
 
 #endif /* NC_SESSION_CLIENT_CH_H_ */
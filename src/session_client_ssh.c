@@ -26,6 +26,7 @@
 #include <termios.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <poll.h>
 #include <pwd.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -908,6 +909,40 @@ nc_client_ssh_ch_del_bind(const char *address, uint16_t port)
     return nc_client_ch_del_bind(address, port, NC_TI_LIBSSH);
 }
 
+/* wait for the SSH socket to become ready instead of sleeping, returns 0 if the timeout elapsed */
+static int
+ssh_wait_socket(ssh_session ssh_sess, struct timespec *ts_timeout)
+{
+    struct pollfd fds;
+    struct timespec ts_cur;
+    int timeout = -1;
+
+    if (ts_timeout) {
+        nc_gettimespec(&ts_cur);
+        timeout = nc_difftimespec(&ts_cur, ts_timeout);
+        if (timeout < 1) {
+            return 0;
+        }
+    }
+
+    fds.fd = ssh_get_fd(ssh_sess);
+    if (fds.fd == -1) {
+        /* no socket to wait on */
+        usleep(NC_TIMEOUT_STEP);
+        return 1;
+    }
+    fds.events = POLLIN;
+    if (ssh_get_poll_flags(ssh_sess) & SSH_WRITE_PENDING) {
+        fds.events |= POLLOUT;
+    }
+    fds.revents = 0;
+
+    /* errors and EINTR are left to the following libssh call */
+    poll(&fds, 1, timeout);
+
+    return 1;
+}
+
 /* Establish a secure SSH connection and authenticate.
  * Host, port, username, and a connected socket is expected to be set.
  */
@@ -921,16 +956,14 @@ connect_ssh_session(struct nc_session *session, struct nc_client_ssh_opts *opts,
     char *s, *answer, echo;
     ssh_key pubkey, privkey;
     ssh_session ssh_sess;
-    struct timespec ts_timeout, ts_cur;
+    struct timespec ts_timeout;
 
     ssh_sess = session->ti.libssh.session;
 
     nc_gettimespec(&ts_timeout);
     nc_addtimespec(&ts_timeout, NC_TRANSPORT_TIMEOUT);
     while ((ret = ssh_connect(ssh_sess)) == SSH_AGAIN) {
-        usleep(NC_TIMEOUT_STEP);
-        nc_gettimespec(&ts_cur);
-        if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
+        if (!ssh_wait_socket(ssh_sess, &ts_timeout)) {
             break;
         }
     }
@@ -953,12 +986,8 @@ connect_ssh_session(struct nc_session *session, struct nc_client_ssh_opts *opts,
         nc_addtimespec(&ts_timeout, timeout);
     }
     while ((ret_auth = ssh_userauth_none(ssh_sess, NULL)) == SSH_AUTH_AGAIN) {
-        usleep(NC_TIMEOUT_STEP);
-        if (timeout > -1) {
-            nc_gettimespec(&ts_cur);
-            if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                break;
-            }
+        if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+            break;
         }
     }
     if (ret_auth == SSH_AUTH_AGAIN) {
@@ -1019,12 +1048,8 @@ connect_ssh_session(struct nc_session *session, struct nc_client_ssh_opts *opts,
                 nc_addtimespec(&ts_timeout, timeout);
             }
             while ((ret_auth = ssh_userauth_password(ssh_sess, session->username, s)) == SSH_AUTH_AGAIN) {
-                usleep(NC_TIMEOUT_STEP);
-                if (timeout > -1) {
-                    nc_gettimespec(&ts_cur);
-                    if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                        break;
-                    }
+                if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+                    break;
                 }
             }
             memset(s, 0, strlen(s));
@@ -1043,12 +1068,8 @@ connect_ssh_session(struct nc_session *session, struct nc_client_ssh_opts *opts,
             while (((ret_auth = ssh_userauth_kbdint(ssh_sess, NULL, NULL)) == SSH_AUTH_INFO)
                     || (ret_auth == SSH_AUTH_AGAIN)) {
                 if (ret_auth == SSH_AUTH_AGAIN) {
-                    usleep(NC_TIMEOUT_STEP);
-                    if (timeout > -1) {
-                        nc_gettimespec(&ts_cur);
-                        if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                            break;
-                        }
+                    if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+                        break;
                     }
                     continue;
                 }
@@ -1113,12 +1134,8 @@ connect_ssh_session(struct nc_session *session, struct nc_client_ssh_opts *opts,
                     nc_addtimespec(&ts_timeout, timeout);
                 }
                 while ((ret_auth = ssh_userauth_try_publickey(ssh_sess, NULL, pubkey)) == SSH_AUTH_AGAIN) {
-                    usleep(NC_TIMEOUT_STEP);
-                    if (timeout > -1) {
-                        nc_gettimespec(&ts_cur);
-                        if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                            break;
-                        }
+                    if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+                        break;
                     }
                 }
                 ssh_key_free(pubkey);
@@ -1153,12 +1170,8 @@ connect_ssh_session(struct nc_session *session, struct nc_client_ssh_opts *opts,
                     nc_addtimespec(&ts_timeout, timeout);
                 }
                 while ((ret_auth = ssh_userauth_publickey(ssh_sess, NULL, privkey)) == SSH_AUTH_AGAIN) {
-                    usleep(NC_TIMEOUT_STEP);
-                    if (timeout > -1) {
-                        nc_gettimespec(&ts_cur);
-                        if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                            break;
-                        }
+                    if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+                        break;
                     }
                 }
                 ssh_key_free(privkey);
@@ -1203,7 +1216,7 @@ open_netconf_channel(struct nc_session *session, int timeout)
 {
     ssh_session ssh_sess;
     int ret;
-    struct timespec ts_timeout, ts_cur;
+    struct timespec ts_timeout;
 
     ssh_sess = session->ti.libssh.session;
 
@@ -1224,12 +1237,8 @@ open_netconf_channel(struct nc_session *session, int timeout)
     }
     session->ti.libssh.channel = ssh_channel_new(ssh_sess);
     while ((ret = ssh_channel_open_session(session->ti.libssh.channel)) == SSH_AGAIN) {
-        usleep(NC_TIMEOUT_STEP);
-        if (timeout > -1) {
-            nc_gettimespec(&ts_cur);
-            if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                break;
-            }
+        if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+            break;
         }
     }
     if (ret == SSH_AGAIN) {
@@ -1250,12 +1259,8 @@ open_netconf_channel(struct nc_session *session, int timeout)
         nc_addtimespec(&ts_timeout, timeout);
     }
     while ((ret = ssh_channel_request_subsystem(session->ti.libssh.channel, "netconf")) == SSH_AGAIN) {
-        usleep(NC_TIMEOUT_STEP);
-        if (timeout > -1) {
-            nc_gettimespec(&ts_cur);
-            if (nc_difftimespec(&ts_cur, &ts_timeout) < 1) {
-                break;
-            }
+        if (!ssh_wait_socket(ssh_sess, (timeout > -1) ? &ts_timeout : NULL)) {
+            break;
         }
     }
     if (ret == SSH_AGAIN) {
@@ -1406,13 +1411,13 @@ _nc_connect_libssh(ssh_session ssh_session, struct ly_ctx *ctx, struct nc_client
 
     /* store information into the dictionary */
     if (host) {
-        session->host = lydict_insert_zc(ctx, host);
+        session->host = lydict_insert_zc(session->ctx, host);
     }
     if (port) {
         session->port = port;
     }
     if (username) {
-        session->username = lydict_insert_zc(ctx, username);
+        session->username = lydict_insert_zc(session->ctx, username);
     }
 
     return session;
@@ -1533,9 +1538,9 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
     }
 
     /* store information into the dictionary */
-    session->host = lydict_insert(ctx, host, 0);
+    session->host = lydict_insert(session->ctx, host, 0);
     session->port = port;
-    session->username = lydict_insert(ctx, username, 0);
+    session->username = lydict_insert(session->ctx, username, 0);
 
     return session;
 
@@ -1611,9 +1616,9 @@ nc_connect_ssh_channel(struct nc_session *session, struct ly_ctx *ctx)
     }
 
     /* store information into session and the dictionary */
-    new_session->host = lydict_insert(ctx, session->host, 0);
+    new_session->host = lydict_insert(new_session->ctx, session->host, 0);
     new_session->port = session->port;
-    new_session->username = lydict_insert(ctx, session->username, 0);
+    new_session->username = lydict_insert(new_session->ctx, session->username, 0);
 
     /* append to the session ring list */
     if (!session->ti.libssh.next) {
@@ -17,7 +17,9 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <libyang/libyang.h>
@@ -30,11 +32,16 @@
 #include "libnetconf.h"
 
 extern struct nc_client_opts client_opts;
-static struct nc_client_tls_opts tls_opts;
-static struct nc_client_tls_opts tls_ch_opts;
+static struct nc_client_tls_opts tls_opts = {.sess_max = NC_TLS_SESS_CACHE_SIZE};
+static struct nc_client_tls_opts tls_ch_opts = {.sess_max = NC_TLS_SESS_CACHE_SIZE};
 
 static int tlsauth_ch;
 
+/* building of the SSL contexts and the session caches of both options */
+static pthread_mutex_t tls_lock = PTHREAD_MUTEX_INITIALIZER;
+/* SSL ex_data index of struct tls_sess_key */
+static int tls_sess_idx = -1;
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L // >= 1.1.0
 
 static int
@@ -227,6 +234,228 @@ tlsauth_verify_callback(int preverify_ok, X509_STORE_CTX *x509_ctx)
 
 #endif
 
+/* key of the cached session of an SSL structure, stored as its ex_data */
+struct tls_sess_key {
+    struct nc_client_tls_opts *opts;
+    char *host;
+    uint16_t port;
+};
+
+static uint32_t
+tls_sess_hash(const char *host, uint16_t port)
+{
+    uint32_t hash = 2166136261U;
+
+    /* FNV-1a */
+    for (; *host; ++host) {
+        hash ^= (unsigned char)*host;
+        hash *= 16777619U;
+    }
+    hash ^= port & 0xFF;
+    hash *= 16777619U;
+    hash ^= port >> 8;
+    hash *= 16777619U;
+
+    return hash % NC_TLS_SESS_BUCKETS;
+}
+
+/* tls_lock is expected to be held */
+static struct nc_tls_sess **
+tls_sess_find(struct nc_client_tls_opts *opts, const char *host, uint16_t port)
+{
+    struct nc_tls_sess **link;
+
+    for (link = &opts->sess_cache[tls_sess_hash(host, port)]; *link; link = &(*link)->next) {
+        if (((*link)->port == port) && !strcmp((*link)->host, host)) {
+            break;
+        }
+    }
+
+    return link;
+}
+
+/* tls_lock is expected to be held */
+static void
+tls_sess_del(struct nc_client_tls_opts *opts, struct nc_tls_sess **link)
+{
+    struct nc_tls_sess *entry;
+
+    entry = *link;
+    *link = entry->next;
+    SSL_SESSION_free(entry->sess);
+    free(entry->host);
+    free(entry);
+    --opts->sess_count;
+}
+
+static int
+tls_sess_expired(struct nc_client_tls_opts *opts, struct nc_tls_sess *entry, time_t now)
+{
+    if (opts->sess_ttl && (now - entry->stored >= (time_t)opts->sess_ttl)) {
+        return 1;
+    }
+    if (now >= (time_t)(SSL_SESSION_get_time(entry->sess) + SSL_SESSION_get_timeout(entry->sess))) {
+        return 1;
+    }
+    return 0;
+}
+
+/* tls_lock is expected to be held, remove expired sessions and then the oldest ones to keep at most max */
+static void
+tls_sess_evict(struct nc_client_tls_opts *opts, uint32_t max)
+{
+    struct nc_tls_sess **link, **oldest;
+    time_t now;
+    uint32_t i;
+
+    now = time(NULL);
+    for (i = 0; i < NC_TLS_SESS_BUCKETS; ++i) {
+        for (link = &opts->sess_cache[i]; *link; ) {
+            if (!max || tls_sess_expired(opts, *link, now)) {
+                tls_sess_del(opts, link);
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    while (opts->sess_count > max) {
+        oldest = NULL;
+        for (i = 0; i < NC_TLS_SESS_BUCKETS; ++i) {
+            for (link = &opts->sess_cache[i]; *link; link = &(*link)->next) {
+                if (!oldest || ((*link)->stored < (*oldest)->stored)) {
+                    oldest = link;
+                }
+            }
+        }
+        tls_sess_del(opts, oldest);
+    }
+}
+
+static void
+tls_sess_key_free(void *UNUSED(parent), void *ptr, CRYPTO_EX_DATA *UNUSED(ad), int UNUSED(idx), long UNUSED(argl),
+                  void *UNUSED(argp))
+{
+    struct tls_sess_key *key = (struct tls_sess_key *)ptr;
+
+    if (key) {
+        free(key->host);
+        free(key);
+    }
+}
+
+/* OpenSSL new session callback, a new session (or TLS 1.3 ticket) was received from the server */
+static int
+tls_sess_new_clb(SSL *tls, SSL_SESSION *sess)
+{
+    struct tls_sess_key *key;
+    struct nc_client_tls_opts *opts;
+    struct nc_tls_sess **link, *entry;
+    int ret = 0;
+
+    key = SSL_get_ex_data(tls, tls_sess_idx);
+    if (!key) {
+        return 0;
+    }
+    opts = key->opts;
+
+    /* LOCK */
+    pthread_mutex_lock(&tls_lock);
+
+    if (!opts->sess_max) {
+        goto cleanup;
+    }
+
+    link = tls_sess_find(opts, key->host, key->port);
+    if (*link) {
+        entry = *link;
+        SSL_SESSION_free(entry->sess);
+    } else {
+        if (opts->sess_count >= opts->sess_max) {
+            tls_sess_evict(opts, opts->sess_max - 1);
+            link = tls_sess_find(opts, key->host, key->port);
+        }
+
+        entry = malloc(sizeof *entry);
+        if (!entry) {
+            ERRMEM;
+            goto cleanup;
+        }
+        entry->host = strdup(key->host);
+        if (!entry->host) {
+            ERRMEM;
+            free(entry);
+            goto cleanup;
+        }
+        entry->port = key->port;
+        entry->next = NULL;
+        *link = entry;
+        ++opts->sess_count;
+    }
+    /* we keep the reference */
+    entry->sess = sess;
+    entry->stored = time(NULL);
+    ret = 1;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_lock);
+    return ret;
+}
+
+/* tls_lock is expected to be held, remember the server of a new TLS connection and offer its cached session, if any */
+static void
+tls_sess_attach(struct nc_client_tls_opts *opts, SSL *tls, const char *host, uint16_t port)
+{
+    struct tls_sess_key *key;
+    struct nc_tls_sess **link;
+
+    if (!opts->sess_max || (tls_sess_idx == -1)) {
+        return;
+    }
+
+    key = malloc(sizeof *key);
+    if (!key) {
+        ERRMEM;
+        return;
+    }
+    key->opts = opts;
+    key->host = strdup(host);
+    key->port = port;
+    if (!key->host || !SSL_set_ex_data(tls, tls_sess_idx, key)) {
+        ERRMEM;
+        free(key->host);
+        free(key);
+        return;
+    }
+
+    link = tls_sess_find(opts, host, port);
+    if (*link && tls_sess_expired(opts, *link, time(NULL))) {
+        tls_sess_del(opts, link);
+    } else if (*link) {
+        SSL_set_session(tls, (*link)->sess);
+    }
+}
+
+/* count a finished handshake */
+static void
+tls_sess_count(struct nc_client_tls_opts *opts, SSL *tls)
+{
+    /* LOCK */
+    pthread_mutex_lock(&tls_lock);
+
+    if (opts->sess_max) {
+        if (SSL_session_reused(tls)) {
+            ++opts->sess_hits;
+        } else {
+            ++opts->sess_misses;
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_lock);
+}
+
 static void
 _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts)
 {
@@ -234,6 +463,7 @@ _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts)
     free(opts->key_path);
     free(opts->ca_file);
     free(opts->ca_dir);
+    tls_sess_evict(opts, 0);
     SSL_CTX_free(opts->tls_ctx);
 
     free(opts->crl_file);
@@ -472,6 +702,65 @@ nc_client_tls_ch_get_crl_paths(const char **crl_file, const char **crl_dir)
     _nc_client_tls_get_crl_paths(crl_file, crl_dir, &tls_ch_opts);
 }
 
+static void
+_nc_client_tls_set_session_cache(uint32_t max_count, uint32_t ttl, struct nc_client_tls_opts *opts)
+{
+    /* LOCK */
+    pthread_mutex_lock(&tls_lock);
+
+    opts->sess_max = max_count;
+    opts->sess_ttl = ttl;
+    tls_sess_evict(opts, max_count);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_lock);
+}
+
+API void
+nc_client_tls_set_session_cache(uint32_t max_count, uint32_t ttl)
+{
+    _nc_client_tls_set_session_cache(max_count, ttl, &tls_opts);
+}
+
+API void
+nc_client_tls_ch_set_session_cache(uint32_t max_count, uint32_t ttl)
+{
+    _nc_client_tls_set_session_cache(max_count, ttl, &tls_ch_opts);
+}
+
+static void
+_nc_client_tls_get_session_cache_stats(uint32_t *count, uint32_t *hits, uint32_t *misses,
+                                       struct nc_client_tls_opts *opts)
+{
+    /* LOCK */
+    pthread_mutex_lock(&tls_lock);
+
+    if (count) {
+        *count = opts->sess_count;
+    }
+    if (hits) {
+        *hits = opts->sess_hits;
+    }
+    if (misses) {
+        *misses = opts->sess_misses;
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_lock);
+}
+
+API void
+nc_client_tls_get_session_cache_stats(uint32_t *count, uint32_t *hits, uint32_t *misses)
+{
+    _nc_client_tls_get_session_cache_stats(count, hits, misses, &tls_opts);
+}
+
+API void
+nc_client_tls_ch_get_session_cache_stats(uint32_t *count, uint32_t *hits, uint32_t *misses)
+{
+    _nc_client_tls_get_session_cache_stats(count, hits, misses, &tls_ch_opts);
+}
+
 API int
 nc_client_tls_ch_add_bind_listen(const char *address, uint16_t port)
 {
@@ -484,8 +773,9 @@ nc_client_tls_ch_del_bind(const char *address, uint16_t port)
     return nc_client_ch_del_bind(address, port, NC_TI_OPENSSL);
 }
 
+/* tls_lock is expected to be held */
 static int
-nc_client_tls_update_opts(struct nc_client_tls_opts *opts)
+_nc_client_tls_update_opts(struct nc_client_tls_opts *opts)
 {
     char *key;
     X509_LOOKUP *lookup;
@@ -527,6 +817,14 @@ nc_client_tls_update_opts(struct nc_client_tls_opts *opts)
             ERR("Failed to load the locations of trusted CA certificates (%s).", ERR_reason_error_string(ERR_get_error()));
             return -1;
         }
+
+        /* sessions are cached per server, not by OpenSSL, see tls_sess_new_clb() */
+        SSL_CTX_set_session_cache_mode(opts->tls_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(opts->tls_ctx, tls_sess_new_clb);
+
+        /* the cached sessions were established with the previous settings */
+        tls_sess_evict(opts, 0);
+        opts->tls_ctx_change = 0;
     }
 
     if (opts->crl_store_change || (!opts->crl_store && (opts->crl_file || opts->crl_dir))) {
@@ -565,15 +863,46 @@ nc_client_tls_update_opts(struct nc_client_tls_opts *opts)
                 return -1;
             }
         }
+        opts->crl_store_change = 0;
     }
 
     return 0;
 }
 
+/* create a TLS connection structure with the current options, the context may be rebuilt only while holding tls_lock */
+static SSL *
+nc_client_tls_new(struct nc_client_tls_opts *opts, const char *host, uint16_t port)
+{
+    SSL *tls = NULL;
+
+    /* LOCK */
+    pthread_mutex_lock(&tls_lock);
+
+    if (tls_sess_idx == -1) {
+        tls_sess_idx = SSL_get_ex_new_index(0, NULL, NULL, NULL, tls_sess_key_free);
+    }
+    if (_nc_client_tls_update_opts(opts)) {
+        goto cleanup;
+    }
+
+    if (!(tls = SSL_new(opts->tls_ctx))) {
+        ERR("Failed to create a new TLS session structure (%s).", ERR_reason_error_string(ERR_get_error()));
+        goto cleanup;
+    }
+    tls_sess_attach(opts, tls, host, port);
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_lock);
+
+    return tls;
+}
+
 API struct nc_session *
 nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
 {
     struct nc_session *session = NULL;
+    SSL *tls;
     int sock, verify, ret;
     struct timespec ts_timeout, ts_cur;
 
@@ -592,7 +921,7 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     }
 
     /* create/update TLS structures */
-    if (nc_client_tls_update_opts(&tls_opts)) {
+    if (!(tls = nc_client_tls_new(&tls_opts, host, port))) {
         return NULL;
     }
 
@@ -600,6 +929,7 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     session = nc_new_session(0);
     if (!session) {
         ERRMEM;
+        SSL_free(tls);
         return NULL;
     }
     session->status = NC_STATUS_STARTING;
@@ -612,10 +942,7 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
 
     /* fill the session */
     session->ti_type = NC_TI_OPENSSL;
-    if (!(session->ti.tls = SSL_new(tls_opts.tls_ctx))) {
-        ERR("Failed to create a new TLS session structure (%s).", ERR_reason_error_string(ERR_get_error()));
-        goto fail;
-    }
+    session->ti.tls = tls;
 
     /* create and assign socket */
     sock = nc_sock_connect(host, port);
@@ -654,6 +981,7 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
         }
         goto fail;
     }
+    tls_sess_count(&tls_opts, session->ti.tls);
 
     /* check certificate verification result */
     verify = SSL_get_verify_result(session->ti.tls);
@@ -693,9 +1021,9 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     }
 
     /* store information into session and the dictionary */
-    session->host = lydict_insert(ctx, host, 0);
+    session->host = lydict_insert(session->ctx, host, 0);
     session->port = port;
-    session->username = lydict_insert(ctx, "certificate-based", 0);
+    session->username = lydict_insert(session->ctx, "certificate-based", 0);
 
     return session;
 
@@ -776,13 +1104,7 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
     struct nc_session *session;
     struct timespec ts_timeout, ts_cur;
 
-    if (nc_client_tls_update_opts(&tls_ch_opts)) {
-        close(sock);
-        return NULL;
-    }
-
-    if (!(tls = SSL_new(tls_ch_opts.tls_ctx))) {
-        ERR("Failed to create new TLS session structure (%s).", ERR_reason_error_string(ERR_get_error()));
+    if (!(tls = nc_client_tls_new(&tls_ch_opts, host, port))) {
         close(sock);
         return NULL;
     }
@@ -824,6 +1146,7 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
         SSL_free(tls);
         return NULL;
     }
+    tls_sess_count(&tls_ch_opts, tls);
 
     /* check certificate verification result */
     verify = SSL_get_verify_result(tls);
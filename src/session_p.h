@@ -17,7 +17,10 @@
 #define NC_SESSION_PRIVATE_H_
 
 #include <stdint.h>
+#include <sys/types.h>
 #include <pthread.h>
+#include <poll.h>
+#include <netinet/in.h>
 
 #include <libyang/libyang.h>
 
@@ -36,6 +39,16 @@
 #   define NC_SSH_TIMEOUT 10
 /* number of all supported authentication methods */
 #   define NC_SSH_AUTH_COUNT 3
+/* length of an authorized key fingerprint (SHA1) */
+#   define NC_SSH_AUTHKEY_FP_LEN 20
+/* minimal number of seconds between checks of public key files for changes */
+#   define NC_SSH_AUTHKEY_CHECK_INTERVAL 1
+/* number of remembered successful password verifications */
+#   define NC_SSH_PASSWD_CACHE_SIZE 32
+/* size of the crypt(3) setting used for remembered password verifications */
+#   define NC_SSH_PASSWD_SETTING_LEN 40
+/* size of a remembered password verification digest (SHA-256 crypt string) */
+#   define NC_SSH_PASSWD_DIGEST_LEN 80
 
 /* ACCESS unlocked */
 struct nc_client_ssh_opts {
@@ -69,6 +82,9 @@ struct nc_server_ssh_opts {
     uint8_t hostkey_count;
     const char *banner;
 
+    /* configured SSH bind with the host keys loaded, created on the first accept, ACCESS locked with sbind_lock */
+    ssh_bind sbind;
+
     int auth_methods;
     uint16_t auth_attempts;
     uint16_t auth_timeout;
@@ -81,6 +97,13 @@ struct nc_server_ssh_opts {
 #   include <openssl/bio.h>
 #   include <openssl/ssl.h>
 
+/* number of supported cert-to-name fingerprint algorithms (MD5, SHA-1, SHA-224, SHA-256, SHA-384, SHA-512) */
+#   define NC_TLS_CTN_FP_ALG_COUNT 6
+/* number of buckets of the client TLS session cache */
+#   define NC_TLS_SESS_BUCKETS 64
+/* default maximum number of sessions in the client TLS session cache */
+#   define NC_TLS_SESS_CACHE_SIZE 256
+
 /* ACCESS unlocked */
 struct nc_client_tls_opts {
     char *cert_path;
@@ -94,6 +117,20 @@ struct nc_client_tls_opts {
     char *crl_dir;
     int8_t crl_store_change;
     X509_STORE *crl_store;
+
+    /* ACCESS locked with the TLS options lock, resumable sessions of the servers connected to */
+    struct nc_tls_sess {
+        char *host;
+        uint16_t port;
+        SSL_SESSION *sess;
+        time_t stored;
+        struct nc_tls_sess *next;
+    } *sess_cache[NC_TLS_SESS_BUCKETS];
+    uint32_t sess_count;
+    uint32_t sess_max;          /* 0 disables the cache */
+    uint32_t sess_ttl;          /* in seconds, 0 for the lifetime of the sessions */
+    uint32_t sess_hits;         /* resumed handshakes */
+    uint32_t sess_misses;       /* full handshakes */
 };
 
 /* ACCESS locked, separate locks */
@@ -111,14 +148,67 @@ struct nc_server_tls_opts {
         NC_TLS_CTN_MAPTYPE map_type;
         const char *name;
         struct nc_ctn *next;
+
+        uint8_t fp_alg;                     /* fingerprint algorithm (1 - MD5, ..., 6 - SHA-512), 0 if not valid */
+        uint8_t fp_len;
+        unsigned char fp[EVP_MAX_MD_SIZE];  /* binary fingerprint */
+        struct nc_ctn *idx_next;            /* next entry in the same ctn_idx bucket */
     } *ctn;
+
+    /* hash index of ctn entries by their binary fingerprint, one for each algorithm */
+    struct {
+        struct nc_ctn **buckets;
+        uint32_t size;                      /* always a power of 2 */
+        uint32_t count;
+    } ctn_idx[NC_TLS_CTN_FP_ALG_COUNT];
 };
 
 #endif /* NC_ENABLED_TLS */
 
+/* number of buckets of the per-host pre-authentication connection table */
+#define NC_PREAUTH_HOST_BUCKETS 256
+
+/* TCP options of listening and accepted sockets, 0 means system default */
+struct nc_tcp_opts {
+    int nodelay;                /* set TCP_NODELAY */
+    int keepalive;              /* set SO_KEEPALIVE */
+    uint16_t ka_idle_time;      /* TCP_KEEPIDLE in seconds */
+    uint16_t ka_max_probes;     /* TCP_KEEPCNT */
+    uint16_t ka_probe_interval; /* TCP_KEEPINTVL in seconds */
+    int sndbuf;                 /* SO_SNDBUF in bytes */
+    int rcvbuf;                 /* SO_RCVBUF in bytes */
+    uint32_t user_timeout;      /* TCP_USER_TIMEOUT in milliseconds */
+    int backlog;                /* listen() backlog, NC_REVERSE_QUEUE if 0 */
+};
+
 /* ACCESS unlocked */
 struct nc_client_opts {
     char *schema_searchpath;
+    char *schema_cache_dir;
+
+    /* ACCESS unlocked, notification queue limits of every session, 0 for no limit */
+    uint32_t notif_queue_max;
+    size_t notif_queue_max_size;
+
+    /* ACCESS unlocked, limits of replies stored before being requested of every session, 0 for no limit */
+    uint32_t reply_queue_max;
+    size_t reply_queue_max_size;
+
+    /* ACCESS locked with ctx_pool_lock, contexts shared by sessions to servers with the same capabilities */
+    int ctx_pool_enabled;
+    struct nc_ctx_pool {
+        uint64_t hash;
+        char **cpblts;              /* sorted server capabilities the context was filled for */
+        char *searchpath;           /* schema searchpath the context was created with */
+        struct ly_ctx *ctx;
+        uint32_t refs;
+        int not_strict;             /* some server modules failed to load */
+        struct nc_ctx_pool *next;
+    } *ctx_pool;
+    pthread_mutex_t ctx_pool_lock;
+
+    /* serializes filling of contexts supplied by the caller, which can be shared by sessions being connected concurrently */
+    pthread_mutex_t shared_ctx_lock;
 
     struct nc_bind {
         const char *address;
@@ -127,6 +217,7 @@ struct nc_client_opts {
         int pollin;
     } *ch_binds;
     NC_TRANSPORT_IMPL *ch_bind_ti;
+    struct pollfd *ch_bind_pfds;
     uint16_t ch_bind_count;
 };
 
@@ -140,6 +231,12 @@ struct nc_server_opts {
     unsigned int capabilities_count;
     const char **capabilities;
 
+    /* ACCESS locked with cpblt_lock, cache of the server capabilities of ctx */
+    const char **cpblts;
+    char *cpblts_xml;           /* <capability> elements of the server <hello> */
+    uint32_t cpblts_ctx_sig;    /* signature of the ctx modules the cache was built for */
+    pthread_mutex_t cpblt_lock;
+
     /* ACCESS unlocked */
     uint16_t hello_timeout;
     uint16_t idle_timeout;
@@ -158,27 +255,75 @@ struct nc_server_opts {
 #endif
 
 #ifdef NC_ENABLED_SSH
-    /* ACCESS locked with authkey_lock */
-    struct {
+    /* ACCESS locked, add/remove authkeys, reload changed key files - WRITE authkey_lock
+     *                look up authkeys - READ authkey_lock */
+    struct nc_authkey {
         const char *path;
         const char *base64;
         NC_SSH_KEY_TYPE type;
         const char *username;
+
+        ssh_key key;                        /* parsed key, NULL if it could not be imported */
+        time_t mtime;                       /* modification time of path when the key was imported */
+        off_t size;                         /* size of path when the key was imported */
+        ino_t ino;                          /* inode of path when the key was imported */
+        unsigned char fp[NC_SSH_AUTHKEY_FP_LEN];  /* SHA1 fingerprint of key */
+        int32_t next;                       /* next key in the same authkey_idx bucket, -1 if none */
     } *authkeys;
     uint16_t authkey_count;
-    pthread_mutex_t authkey_lock;
+    int32_t *authkey_idx;                   /* hash index of authkeys by their fingerprint, -1 for empty buckets */
+    uint32_t authkey_idx_size;              /* always a power of 2, 0 if the index could not be allocated */
+    pthread_rwlock_t authkey_lock;
+    time_t authkey_check;                   /* last check of key files for changes, ACCESS locked with authkey_check_lock */
+    pthread_mutex_t authkey_check_lock;
 
     int (*hostkey_clb)(const char *name, void *user_data, char **privkey_path, char **privkey_data, int *privkey_data_rsa);
     void *hostkey_data;
     void (*hostkey_data_free)(void *data);
+
+    /* ACCESS locked with passwd_lock */
+    uint16_t passwd_auth_max;
+    uint16_t passwd_auth_running;
+    uint16_t passwd_cache_timeout;
+    char passwd_cache_setting[NC_SSH_PASSWD_SETTING_LEN];
+    struct {
+        const char *username;
+        char digest[NC_SSH_PASSWD_DIGEST_LEN];
+        time_t expire;
+    } passwd_cache[NC_SSH_PASSWD_CACHE_SIZE];
+    pthread_mutex_t passwd_lock;
+
+    /* ACCESS locked, create/use cached SSH binds of endpoints (nc_server_ssh_opts sbind) - sbind_lock,
+     *                free them - WRITE endpt_lock or CH client lock */
+    pthread_mutex_t sbind_lock;
 #endif
 
+    /* ACCESS locked with preauth_lock, connections accepted but without a finished handshake yet */
+    uint16_t preauth_max;
+    uint16_t preauth_max_per_host;
+    uint16_t conn_rate_per_host;        /* new connections per second */
+    uint16_t preauth_count;
+    struct nc_preauth_host {
+        char addr[INET6_ADDRSTRLEN];
+        uint16_t preauth_count;
+        uint16_t rate_count;
+        time_t rate_start;
+        struct nc_preauth_host *next;
+    } *preauth_hosts[NC_PREAUTH_HOST_BUCKETS];
+    uint32_t preauth_rejected_max;
+    uint32_t preauth_rejected_host_max;
+    uint32_t preauth_rejected_rate;
+    pthread_mutex_t preauth_lock;
+
     /* ACCESS locked, add/remove endpts/binds - bind_lock + WRITE endpt_lock (strict order!)
      *                modify endpts - WRITE endpt_lock
      *                access endpts - READ endpt_lock
      *                modify/poll binds - bind_lock */
     struct nc_bind *binds;
+    struct pollfd *bind_pfds;   /* for polling binds, at least as many items as binds */
     pthread_mutex_t bind_lock;
+    int reuseport;      /* every accepting thread listens on its own SO_REUSEPORT sockets, binds are not listening */
+    uint32_t bind_gen;  /* changed on every binds modification, accessed with endpt_lock */
     struct nc_endpt {
         const char *name;
         NC_TRANSPORT_IMPL ti;
@@ -190,6 +335,7 @@ struct nc_server_opts {
             struct nc_server_tls_opts *tls;
 #endif
         } opts;
+        struct nc_tcp_opts tcp;
     } *endpts;
     uint16_t endpt_count;
     pthread_rwlock_t endpt_lock;
@@ -242,12 +388,38 @@ struct nc_server_opts {
  */
 #define NC_CLIENT_NOTIF_THREAD_SLEEP 10000
 
+/**
+ * Default maximum number of RPC replies received before being requested stored on a session.
+ */
+#define NC_CLIENT_REPLY_QUEUE_MAX 1024
+
+/**
+ * Maximum number of threads connecting to servers in nc_connect_bulk().
+ */
+#define NC_CLIENT_BULK_THREADS_MAX 64
+
+/**
+ * Maximum number of \<get-schema\> RPCs sent in advance without having received their replies.
+ */
+#define NC_CLIENT_GETSCHEMA_WINDOW 16
+
 /**
  * Timeout in msec for transport-related data to arrive (ssh_handle_key_exchange(), SSL_accept(), SSL_connect()).
  * It can be quite a lot on slow machines (waiting for TLS cert-to-name resolution, ...).
  */
 #define NC_TRANSPORT_TIMEOUT 10000
 
+/**
+ * Timeout in msec for a single TCP connection attempt in nc_sock_connect().
+ */
+#define NC_SOCK_CONNECT_TIMEOUT 10000
+
+/**
+ * Delay in msec after which nc_sock_connect() tries the next address of a host even though
+ * the previous attempts are still in progress (Connection Attempt Delay of RFC 8305).
+ */
+#define NC_SOCK_CONNECT_DELAY 250
+
 /**
  * Timeout in msec for acquiring a lock of a session (used with a condition, so higher numbers could be required
  * only in case of extreme concurrency).
@@ -298,11 +470,27 @@ typedef enum {
 #define NC_VERSION_10_ENDTAG "]]>]]>"
 #define NC_VERSION_10_ENDTAG_LEN 6
 
+struct nc_reactor_session;
+
+/**
+ * @brief Message being read, kept in the session so that it can be read in parts.
+ */
+struct nc_msg_read {
+    char *msg;                   /**< message data read so far, without the framing */
+    size_t len;                  /**< length of msg */
+    size_t size;                 /**< allocated size of msg */
+    uint64_t chunk_left;         /**< bytes left to read of the current chunk (chunked framing) */
+    char frame[24];              /**< chunk delimiter read so far (chunked framing) */
+    uint8_t frame_len;           /**< length of frame */
+};
+
 /**
  * @brief Container to serialize PRC messages
  */
 struct nc_msg_cont {
     struct lyxml_elem *msg;
+    uint64_t msgid;              /**< message-id of an RPC reply */
+    size_t size;                 /**< estimated memory of a stored reply or queued notification */
     struct nc_msg_cont *next;
 };
 
@@ -343,6 +531,7 @@ struct nc_session {
         SSL *tls;
 #endif
     } ti;                          /**< transport implementation data */
+    struct nc_msg_read rd;         /**< message being read */
     const char *username;
     const char *host;
     uint16_t port;
@@ -354,18 +543,64 @@ struct nc_session {
 #define NC_SESSION_SHAREDCTX 0x01
 #define NC_SESSION_CALLHOME 0x02
 
+/* well-known server capabilities (their URIs without parameters) of a client session */
+#define NC_CPBLT_BASE_10 0x0001
+#define NC_CPBLT_BASE_11 0x0002
+#define NC_CPBLT_WRITABLE_RUNNING 0x0004
+#define NC_CPBLT_CANDIDATE 0x0008
+#define NC_CPBLT_CONFIRMED_COMMIT 0x0010
+#define NC_CPBLT_ROLLBACK_ON_ERROR 0x0020
+#define NC_CPBLT_VALIDATE 0x0040
+#define NC_CPBLT_STARTUP 0x0080
+#define NC_CPBLT_URL 0x0100
+#define NC_CPBLT_XPATH 0x0200
+#define NC_CPBLT_WITH_DEFAULTS 0x0400
+#define NC_CPBLT_NOTIFICATION 0x0800
+#define NC_CPBLT_INTERLEAVE 0x1000
+#define NC_CPBLT_MONITORING 0x2000
+
     union {
         struct {
             /* client side only data */
             uint64_t msgid;
             char **cpblts;                 /**< list of server's capabilities on client side */
-            struct nc_msg_cont *replies;   /**< queue for RPC replies received instead of notifications */
+            uint32_t cpblt_bits;           /**< well-known server's capabilities, NC_CPBLT_* */
+            uint32_t *cpblt_idx;           /**< hash index of cpblts by their URI without parameters, items are
+                                                indices + 1, 0 is an empty slot */
+            uint32_t cpblt_idx_size;       /**< number of cpblt_idx slots, always a power of 2 */
+            char **cpblt_sorted;           /**< cpblts sorted by strcmp(), for prefix lookups */
+            uint32_t cpblt_count;          /**< number of cpblts */
+            struct nc_msg_cont **replies;  /**< hash table of RPC replies received before being requested, by message-id */
+            uint32_t reply_buckets;        /**< number of replies buckets, always a power of 2 */
+            uint32_t reply_count;          /**< number of stored replies */
+            size_t reply_size;             /**< estimated memory of stored replies */
+            uint32_t reply_dropped;        /**< number of replies dropped because the table was full */
+            uint64_t *dropped;             /**< message-ids of the dropped replies not requested yet */
+            uint32_t dropped_count;        /**< number of dropped message-ids */
+            uint64_t *discard;             /**< message-ids of sent RPCs whose replies are not wanted anymore */
+            uint32_t discard_count;        /**< number of discard message-ids */
             struct nc_msg_cont *notifs;    /**< queue for notifications received instead of RPC reply */
+            struct nc_msg_cont *notifs_tail; /**< last notification in the queue */
+            uint32_t notif_count;          /**< number of queued notifications */
+            size_t notif_size;             /**< estimated memory of queued notifications */
+            uint32_t notif_dropped;        /**< number of notifications dropped because the queue was full */
             volatile pthread_t *ntf_tid;   /**< running notifications receiving thread */
+            struct nc_reactor_session *reactor; /**< entry of the reactor the session is added to, if any */
+            int reactor_wait;              /**< the session is to be re-enabled in its reactor once unlocked,
+                                                protected by ti_lock */
+            struct {
+                struct ly_ctx *ctx;        /**< context the modules are from */
+                const struct lys_module *ietfnc;
+                const struct lys_module *ietfncwd;
+                const struct lys_module *ietfncmon;
+                const struct lys_module *notifs;
+            } mods;                        /**< cached modules used for creating RPCs, filled with the context */
 
             /* client flags */
             /* some server modules failed to load so the data from them will be ignored - not use strict flag for parsing */
 #           define NC_SESSION_CLIENT_NOT_STRICT 0x40
+            /* context is from the client context pool */
+#           define NC_SESSION_CLIENT_POOLCTX 0x80
         } client;
         struct {
             /* server side only data */
@@ -422,6 +657,7 @@ struct nc_pollsession {
 struct nc_ntf_thread_arg {
     struct nc_session *session;
     void (*notif_clb)(struct nc_session *session, const struct nc_notif *notif);
+    void (*notif_raw_clb)(struct nc_session *session, const struct nc_notif_raw *notif);
 };
 
 void *nc_realloc(void *ptr, size_t size);
@@ -458,6 +694,15 @@ int nc_ps_unlock(struct nc_pollsession *ps, uint8_t id, const char *func);
  */
 int nc_ctx_check_and_fill(struct nc_session *session);
 
+/**
+ * @brief Drop the reply to a sent RPC nobody is going to receive, now or once it arrives.
+ *
+ * @param[in] session Client session.
+ * @param[in] msgid Message-id of the RPC.
+ * @return 0 on success, -1 on error.
+ */
+int nc_session_discard_reply(struct nc_session *session, uint64_t msgid);
+
 /**
  * @brief Perform NETCONF handshake on \p session.
  *
@@ -467,9 +712,18 @@ int nc_ctx_check_and_fill(struct nc_session *session);
  */
 NC_MSG_TYPE nc_handshake(struct nc_session *session);
 
+/**
+ * @brief Drop the cached server capabilities, they are created again for the next \<hello\>.
+ * Must be called whenever an option affecting the capabilities (not the context) changes.
+ */
+void nc_server_clear_cpblts_cache(void);
+
 /**
  * @brief Create a socket connection.
  *
+ * All the addresses of \p host are tried with non-blocking connects, alternating the address families
+ * and staggered by #NC_SOCK_CONNECT_DELAY, the first one to connect is used (RFC 8305).
+ *
  * @param[in] host Hostname to connect to.
  * @param[in] port Port to connect on.
  * @return Connected socket or -1 on error.
@@ -492,14 +746,28 @@ int nc_sock_accept(int sock, int timeout, char **peer_host, uint16_t *peer_port)
  *
  * @param[in] address IP address to listen on.
  * @param[in] port Port to listen on.
+ * @param[in] tcp_opts TCP options to apply to the socket. Can be NULL.
+ * @param[in] reuseport Whether to set SO_REUSEPORT so that more sockets can listen on the same address and port.
  * @return Listening socket, -1 on error.
  */
-int nc_sock_listen(const char *address, uint16_t port);
+int nc_sock_listen(const char *address, uint16_t port, const struct nc_tcp_opts *tcp_opts, int reuseport);
+
+/**
+ * @brief Apply TCP options to a socket.
+ *
+ * @param[in] sock Socket to modify.
+ * @param[in] tcp_opts TCP options to apply.
+ * @param[in] listening Whether \p sock is a listening socket (buffer sizes and backlog) or
+ *                      an accepted connection (the rest of the options).
+ * @return 0 on success, -1 on error (already logged).
+ */
+int nc_sock_set_tcp_opts(int sock, const struct nc_tcp_opts *tcp_opts, int listening);
 
 /**
  * @brief Accept a new connection on a listening socket.
  *
  * @param[in] binds Structure with the listening sockets.
+ * @param[in] pfd Array of at least \p bind_count items used for polling \p binds.
  * @param[in] bind_count Number of \p binds.
  * @param[in] timeout Timeout for accepting.
  * @param[out] host Host of the remote peer. Can be NULL.
@@ -507,7 +775,8 @@ int nc_sock_listen(const char *address, uint16_t port);
  * @param[out] idx Index of the bind that was accepted. Can be NULL.
  * @return Accepted socket of the new connection, -1 on error.
  */
-int nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, char **host, uint16_t *port, uint16_t *idx);
+int nc_sock_accept_binds(struct nc_bind *binds, struct pollfd *pfd, uint16_t bind_count, int timeout, char **host,
+                         uint16_t *port, uint16_t *idx);
 
 /**
  * @brief Lock endpoint structures for reading and the specific endpoint.
@@ -556,6 +825,48 @@ int nc_client_ch_add_bind_listen(const char *address, uint16_t port, NC_TRANSPOR
  */
 int nc_client_ch_del_bind(const char *address, uint16_t port, NC_TRANSPORT_IMPL ti);
 
+/**
+ * @brief Remove a client session from its reactor, all its pending asynchronous RPCs fail.
+ *
+ * @param[in] session Client session added to a reactor.
+ */
+void nc_client_reactor_session_free(struct nc_session *session);
+
+/**
+ * @brief Re-enable a client session in its reactor if the reactor is waiting for it.
+ * Called with ti_lock held once the session is unlocked.
+ *
+ * @param[in] session Client session just unlocked.
+ */
+void nc_client_reactor_session_unlocked(struct nc_session *session);
+
+/**
+ * @brief Pass a reply to an asynchronous RPC read by another thread to the reactor of the session.
+ * Session lock is expected to be held.
+ *
+ * @param[in] session Client session.
+ * @param[in] msgid Message ID of the reply.
+ * @param[in] xml Reply, spent on success.
+ * @return 1 if the reply is dispatched by the reactor, 0 if it is not a reply to an asynchronous RPC.
+ */
+int nc_client_reactor_take_reply(struct nc_session *session, uint64_t msgid, struct lyxml_elem *xml);
+
+/**
+ * @brief Release a context from the client context pool, destroy it if not used anymore.
+ *
+ * @param[in] ctx Context of a session with #NC_SESSION_CLIENT_POOLCTX flag.
+ */
+void nc_client_ctx_pool_release(struct ly_ctx *ctx);
+
+/**
+ * @brief Hash of a capability URI (without parameters) for the client session capability index.
+ *
+ * @param[in] uri Capability URI.
+ * @param[in] len Length of \p uri.
+ * @return Hash of \p uri.
+ */
+uint32_t nc_cpblt_hash(const char *uri, size_t len);
+
 /**
  * @brief Connect to a listening NETCONF client using Call Home.
  *
@@ -667,6 +978,58 @@ NC_MSG_TYPE nc_read_msg_poll(struct nc_session* session, int timeout, struct lyx
  */
 NC_MSG_TYPE nc_read_msg(struct nc_session* session, struct lyxml_elem **data);
 
+/**
+ * @brief Read message from the wire without blocking.
+ *
+ * Reads only the data available, a partially received message is kept in the session and
+ * the next reading of the session, blocking or not, continues with it.
+ *
+ * @param[in] session NETCONF session from which the message is being read.
+ * @param[out] data XML tree built from the read data.
+ * @return Type of the read message, same as nc_read_msg_poll(). #NC_MSG_WOULDBLOCK is returned
+ * if the whole message has not been received yet.
+ */
+NC_MSG_TYPE nc_read_msg_nonblock(struct nc_session *session, struct lyxml_elem **data);
+
+/**
+ * @brief Read message from the wire, returning a notification as received.
+ *
+ * Same as nc_read_msg_poll(), but a \<notification\> is not transformed into libyang XML tree. It is only
+ * scanned for its eventTime and content root element and the received string itself is returned in \p notif.
+ *
+ * @param[in] session NETCONF session from which the message is being read.
+ * @param[in] timeout Timeout in milliseconds. Negative value means infinite timeout,
+ *            zero value causes to return immediately.
+ * @param[out] data XML tree built from the read data, if it is not a notification.
+ * @param[out] notif Raw notification, if \p data was not built.
+ * @return Type of the read message, same as nc_read_msg_poll().
+ */
+NC_MSG_TYPE nc_read_msg_notif_raw_poll(struct nc_session *session, int timeout, struct lyxml_elem **data,
+                                       struct nc_notif_raw **notif);
+
+/**
+ * @brief Read message from the wire, passing data subtrees of the expected reply to a callback.
+ *
+ * The message is processed as it is being received. If it is the \<rpc-reply\> with \p msgid, each
+ * top-level child of its \<data\> element is cut out as an XML string, completed with the namespace
+ * declarations inherited from its ancestors, and passed to \p clb. Only the rest of the message
+ * is transformed into libyang XML tree, so the memory needed does not depend on the size of the data.
+ * Any other message is returned whole, as by nc_read_msg_poll().
+ *
+ * @param[in] session NETCONF session from which the message is being read.
+ * @param[in] timeout Timeout in milliseconds. Negative value means infinite timeout,
+ *            zero value causes to return immediately.
+ * @param[in] msgid Message ID of the reply to split.
+ * @param[in] clb Callback for the data subtrees, non-zero return value means an error. The remaining subtrees
+ *            are then skipped and #NC_MSG_ERROR is returned once the whole message is read.
+ * @param[in] clb_arg Arbitrary argument passed to \p clb.
+ * @param[out] data XML tree built from the read data, without the data subtrees.
+ * @return Type of the read message, same as nc_read_msg_poll().
+ */
+NC_MSG_TYPE nc_read_msg_split_poll(struct nc_session *session, int timeout, uint64_t msgid,
+                                   int (*clb)(const char *xml, size_t len, void *arg), void *clb_arg,
+                                   struct lyxml_elem **data);
+
 /**
  * @brief Write message into wire.
  *
@@ -679,11 +1042,18 @@ NC_MSG_TYPE nc_read_msg(struct nc_session* session, struct lyxml_elem **data);
  *     Required parameter.
  *     `message-id` attribute is added automatically and default namespace is set to #NC_NS_BASE.
  *     Optional parameter.
+ *   - `const char *op_xml;` - already serialized operation, used if \p op is NULL.
  * - #NC_MSG_REPLY
  *   - `struct lyxml_node *rpc_elem;` - root of the RPC object to reply to. Required parameter.
  *   - `struct nc_server_reply *reply;` - RPC reply. Required parameter.
  * - #NC_MSG_NOTIF
  *   - TODO: content
+ * - #NC_MSG_HELLO
+ *   - `const char **capabilities;` - NULL-terminated list of capabilities. Can be NULL if the next but one
+ *     parameter is set.
+ *   - `uint32_t *sid;` - session ID to send, NULL on client side.
+ *   - `const char *cpblts_xml;` - already serialized \<capability\> elements written instead of \p capabilities.
+ *     Can be NULL.
  * @return 0 on success
  */
 int nc_write_msg(struct nc_session *session, int type, ...);
@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -33,8 +34,13 @@
 
 struct nc_server_opts server_opts = {
 #ifdef NC_ENABLED_SSH
-    .authkey_lock = PTHREAD_MUTEX_INITIALIZER,
+    .authkey_lock = PTHREAD_RWLOCK_INITIALIZER,
+    .authkey_check_lock = PTHREAD_MUTEX_INITIALIZER,
+    .passwd_lock = PTHREAD_MUTEX_INITIALIZER,
+    .sbind_lock = PTHREAD_MUTEX_INITIALIZER,
 #endif
+    .cpblt_lock = PTHREAD_MUTEX_INITIALIZER,
+    .preauth_lock = PTHREAD_MUTEX_INITIALIZER,
     .bind_lock = PTHREAD_MUTEX_INITIALIZER,
     .endpt_lock = PTHREAD_RWLOCK_INITIALIZER,
     .ch_client_lock = PTHREAD_RWLOCK_INITIALIZER
@@ -131,7 +137,78 @@ nc_session_set_term_reason(struct nc_session *session, NC_SESSION_TERM_REASON re
 }
 
 int
-nc_sock_listen(const char *address, uint16_t port)
+nc_sock_set_tcp_opts(int sock, const struct nc_tcp_opts *tcp_opts, int listening)
+{
+    int opt;
+
+    if (listening) {
+        /* buffer sizes are inherited by accepted sockets, the receive buffer must be set before listen() */
+        if (tcp_opts->sndbuf && setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &tcp_opts->sndbuf, sizeof tcp_opts->sndbuf)) {
+            ERR("Could not set SO_SNDBUF socket option (%s).", strerror(errno));
+            return -1;
+        }
+        if (tcp_opts->rcvbuf && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &tcp_opts->rcvbuf, sizeof tcp_opts->rcvbuf)) {
+            ERR("Could not set SO_RCVBUF socket option (%s).", strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    if (tcp_opts->nodelay) {
+        opt = 1;
+        if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof opt)) {
+            ERR("Could not set TCP_NODELAY socket option (%s).", strerror(errno));
+            return -1;
+        }
+    }
+
+    if (tcp_opts->keepalive) {
+        opt = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof opt)) {
+            ERR("Could not set SO_KEEPALIVE socket option (%s).", strerror(errno));
+            return -1;
+        }
+
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPCNT) && defined(TCP_KEEPINTVL)
+        opt = tcp_opts->ka_idle_time;
+        if (opt && setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &opt, sizeof opt)) {
+            ERR("Could not set TCP_KEEPIDLE socket option (%s).", strerror(errno));
+            return -1;
+        }
+        opt = tcp_opts->ka_max_probes;
+        if (opt && setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &opt, sizeof opt)) {
+            ERR("Could not set TCP_KEEPCNT socket option (%s).", strerror(errno));
+            return -1;
+        }
+        opt = tcp_opts->ka_probe_interval;
+        if (opt && setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &opt, sizeof opt)) {
+            ERR("Could not set TCP_KEEPINTVL socket option (%s).", strerror(errno));
+            return -1;
+        }
+#else
+        if (tcp_opts->ka_idle_time || tcp_opts->ka_max_probes || tcp_opts->ka_probe_interval) {
+            WRN("Keepalive parameters not supported on this system, using the defaults.");
+        }
+#endif
+    }
+
+    if (tcp_opts->user_timeout) {
+#ifdef TCP_USER_TIMEOUT
+        opt = tcp_opts->user_timeout;
+        if (setsockopt(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, &opt, sizeof opt)) {
+            ERR("Could not set TCP_USER_TIMEOUT socket option (%s).", strerror(errno));
+            return -1;
+        }
+#else
+        WRN("TCP_USER_TIMEOUT not supported on this system, ignoring.");
+#endif
+    }
+
+    return 0;
+}
+
+int
+nc_sock_listen(const char *address, uint16_t port, const struct nc_tcp_opts *tcp_opts, int reuseport)
 {
     const int optVal = 1;
     const socklen_t optLen = sizeof(optVal);
@@ -159,6 +236,22 @@ nc_sock_listen(const char *address, uint16_t port)
         goto fail;
     }
 
+#ifdef SO_REUSEPORT
+    if (reuseport && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (void *)&optVal, optLen)) {
+        ERR("Could not set SO_REUSEPORT socket option (%s).", strerror(errno));
+        goto fail;
+    }
+#else
+    if (reuseport) {
+        ERRINT;
+        goto fail;
+    }
+#endif
+
+    if (tcp_opts && nc_sock_set_tcp_opts(sock, tcp_opts, 1)) {
+        goto fail;
+    }
+
     bzero(&saddr, sizeof(struct sockaddr_storage));
     if (is_ipv4) {
         saddr4 = (struct sockaddr_in *)&saddr;
@@ -193,7 +286,7 @@ nc_sock_listen(const char *address, uint16_t port)
         }
     }
 
-    if (listen(sock, NC_REVERSE_QUEUE) == -1) {
+    if (listen(sock, (tcp_opts && tcp_opts->backlog) ? tcp_opts->backlog : NC_REVERSE_QUEUE) == -1) {
         ERR("Unable to start listening on \"%s\" port %d (%s).", address, port, strerror(errno));
         goto fail;
     }
@@ -209,21 +302,15 @@ fail:
 }
 
 int
-nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, char **host, uint16_t *port, uint16_t *idx)
+nc_sock_accept_binds(struct nc_bind *binds, struct pollfd *pfd, uint16_t bind_count, int timeout, char **host,
+                     uint16_t *port, uint16_t *idx)
 {
     sigset_t sigmask, origmask;
     uint16_t i, j, pfd_count;
-    struct pollfd *pfd;
     struct sockaddr_storage saddr;
     socklen_t saddr_len = sizeof(saddr);
     int ret, sock = -1, flags;
 
-    pfd = malloc(bind_count * sizeof *pfd);
-    if (!pfd) {
-        ERRMEM;
-        return -1;
-    }
-
     for (i = 0, pfd_count = 0; i < bind_count; ++i) {
         if (binds[i].sock < 0) {
             /* invalid socket */
@@ -251,11 +338,9 @@ nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, ch
 
         if (!ret) {
             /* we timeouted */
-            free(pfd);
             return 0;
         } else if (ret == -1) {
             ERR("Poll failed (%s).", strerror(errno));
-            free(pfd);
             return -1;
         }
 
@@ -279,7 +364,6 @@ nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, ch
             }
         }
     }
-    free(pfd);
 
     if (sock == -1) {
         ERRINT;
@@ -461,7 +545,16 @@ API void
 nc_server_destroy(void)
 {
     unsigned int i;
+    struct nc_preauth_host *ph;
 
+    nc_server_clear_cpblts_cache();
+    for (i = 0; i < NC_PREAUTH_HOST_BUCKETS; ++i) {
+        while (server_opts.preauth_hosts[i]) {
+            ph = server_opts.preauth_hosts[i];
+            server_opts.preauth_hosts[i] = ph->next;
+            free(ph);
+        }
+    }
     for (i = 0; i < server_opts.capabilities_count; i++) {
         lydict_remove(server_opts.ctx, server_opts.capabilities[i]);
     }
@@ -473,6 +566,7 @@ nc_server_destroy(void)
 #endif
 #ifdef NC_ENABLED_SSH
     nc_server_ssh_del_authkey(NULL, NULL, 0, NULL);
+    nc_server_ssh_set_passwd_cache_timeout(0);
 
     if (server_opts.hostkey_data && server_opts.hostkey_data_free) {
         server_opts.hostkey_data_free(server_opts.hostkey_data);
@@ -502,6 +596,7 @@ nc_server_set_capab_withdefaults(NC_WD_MODE basic_mode, int also_supported)
 
     server_opts.wd_basic_mode = basic_mode;
     server_opts.wd_also_supported = also_supported;
+    nc_server_clear_cpblts_cache();
     return 0;
 }
 
@@ -539,6 +634,7 @@ nc_server_set_capability(const char *value)
     }
     server_opts.capabilities = new;
     server_opts.capabilities[server_opts.capabilities_count - 1] = lydict_insert(server_opts.ctx, value, 0);
+    nc_server_clear_cpblts_cache();
 
     return EXIT_SUCCESS;
 }
@@ -1561,6 +1657,7 @@ nc_server_add_endpt(const char *name, NC_TRANSPORT_IMPL ti)
     }
     server_opts.endpts[server_opts.endpt_count - 1].name = lydict_insert(server_opts.ctx, name, 0);
     server_opts.endpts[server_opts.endpt_count - 1].ti = ti;
+    memset(&server_opts.endpts[server_opts.endpt_count - 1].tcp, 0, sizeof server_opts.endpts[server_opts.endpt_count - 1].tcp);
 
     server_opts.binds = nc_realloc(server_opts.binds, server_opts.endpt_count * sizeof *server_opts.binds);
     if (!server_opts.binds) {
@@ -1569,10 +1666,18 @@ nc_server_add_endpt(const char *name, NC_TRANSPORT_IMPL ti)
         goto cleanup;
     }
 
+    server_opts.bind_pfds = nc_realloc(server_opts.bind_pfds, server_opts.endpt_count * sizeof *server_opts.bind_pfds);
+    if (!server_opts.bind_pfds) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+
     server_opts.binds[server_opts.endpt_count - 1].address = NULL;
     server_opts.binds[server_opts.endpt_count - 1].port = 0;
     server_opts.binds[server_opts.endpt_count - 1].sock = -1;
     server_opts.binds[server_opts.endpt_count - 1].pollin = 0;
+    ++server_opts.bind_gen;
 
     switch (ti) {
 #ifdef NC_ENABLED_SSH
@@ -1656,10 +1761,11 @@ nc_server_endpt_set_address_port(const char *endpt_name, const char *address, ui
         address = bind->address;
     }
 
-    /* we have all the information we need to create a listening socket */
-    if (address && port) {
+    /* we have all the information we need to create a listening socket,
+     * accepting threads create their own sockets in the reuseport mode */
+    if (address && port && !server_opts.reuseport) {
         /* create new socket, close the old one */
-        sock = nc_sock_listen(address, port);
+        sock = nc_sock_listen(address, port, &endpt->tcp, 0);
         if (sock == -1) {
             ret = -1;
             goto cleanup;
@@ -1677,6 +1783,7 @@ nc_server_endpt_set_address_port(const char *endpt_name, const char *address, ui
     } else {
         bind->port = port;
     }
+    ++server_opts.bind_gen;
 
     if (sock > -1) {
 #if defined(NC_ENABLED_SSH) && defined(NC_ENABLED_TLS)
@@ -1710,6 +1817,168 @@ nc_server_endpt_set_port(const char *endpt_name, uint16_t port)
     return nc_server_endpt_set_address_port(endpt_name, NULL, port);
 }
 
+API int
+nc_server_endpt_set_tcp_nodelay(const char *endpt_name, int enable)
+{
+    struct nc_endpt *endpt;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
+    if (!endpt) {
+        return -1;
+    }
+    endpt->tcp.nodelay = (enable ? 1 : 0);
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return 0;
+}
+
+API int
+nc_server_endpt_enable_keepalives(const char *endpt_name, int enable)
+{
+    struct nc_endpt *endpt;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
+    if (!endpt) {
+        return -1;
+    }
+    endpt->tcp.keepalive = (enable ? 1 : 0);
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return 0;
+}
+
+API int
+nc_server_endpt_set_keepalives(const char *endpt_name, uint16_t idle_time, uint16_t max_probes, uint16_t probe_interval)
+{
+    struct nc_endpt *endpt;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
+    if (!endpt) {
+        return -1;
+    }
+    endpt->tcp.ka_idle_time = idle_time;
+    endpt->tcp.ka_max_probes = max_probes;
+    endpt->tcp.ka_probe_interval = probe_interval;
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return 0;
+}
+
+API int
+nc_server_endpt_set_user_timeout(const char *endpt_name, uint32_t timeout)
+{
+    struct nc_endpt *endpt;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
+    if (!endpt) {
+        return -1;
+    }
+    endpt->tcp.user_timeout = timeout;
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return 0;
+}
+
+API int
+nc_server_endpt_set_buffers(const char *endpt_name, int sndbuf, int rcvbuf)
+{
+    struct nc_endpt *endpt;
+    uint16_t i;
+    int ret = 0;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if (sndbuf < 0) {
+        ERRARG("sndbuf");
+        return -1;
+    } else if (rcvbuf < 0) {
+        ERRARG("rcvbuf");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, &i);
+    if (!endpt) {
+        return -1;
+    }
+    endpt->tcp.sndbuf = sndbuf;
+    endpt->tcp.rcvbuf = rcvbuf;
+
+    /* apply to the current listening socket, if any */
+    if (server_opts.binds[i].sock > -1) {
+        ret = nc_sock_set_tcp_opts(server_opts.binds[i].sock, &endpt->tcp, 1);
+    }
+    ++server_opts.bind_gen;
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return ret;
+}
+
+API int
+nc_server_endpt_set_backlog(const char *endpt_name, int backlog)
+{
+    struct nc_endpt *endpt;
+    uint16_t i;
+    int ret = 0;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if (backlog < 0) {
+        ERRARG("backlog");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, &i);
+    if (!endpt) {
+        return -1;
+    }
+    endpt->tcp.backlog = backlog;
+
+    /* calling listen() again on a listening socket just updates its backlog */
+    if ((server_opts.binds[i].sock > -1)
+            && (listen(server_opts.binds[i].sock, backlog ? backlog : NC_REVERSE_QUEUE) == -1)) {
+        ERR("Failed to change the backlog of endpoint \"%s\" (%s).", endpt_name, strerror(errno));
+        ret = -1;
+    }
+    ++server_opts.bind_gen;
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return ret;
+}
+
 API int
 nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
 {
@@ -1758,6 +2027,8 @@ nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
         }
         free(server_opts.binds);
         server_opts.binds = NULL;
+        free(server_opts.bind_pfds);
+        server_opts.bind_pfds = NULL;
 
         server_opts.endpt_count = 0;
 
@@ -1796,6 +2067,8 @@ nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
                 if (!server_opts.endpt_count) {
                     free(server_opts.binds);
                     server_opts.binds = NULL;
+                    free(server_opts.bind_pfds);
+                    server_opts.bind_pfds = NULL;
                     free(server_opts.endpts);
                     server_opts.endpts = NULL;
                 } else if (i < server_opts.endpt_count) {
@@ -1811,6 +2084,45 @@ nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
         }
     }
 
+    if (!ret) {
+        ++server_opts.bind_gen;
+    }
+
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+    return ret;
+}
+
+API int
+nc_server_set_reuseport(int enable)
+{
+    int ret = 0;
+
+#ifndef SO_REUSEPORT
+    if (enable) {
+        ERR("SO_REUSEPORT is not supported on this system.");
+        return -1;
+    }
+#endif
+
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
+
+    /* ENDPT WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+
+    if (server_opts.endpt_count) {
+        ERR("Reuseport mode can be changed only with no endpoints.");
+        ret = -1;
+    } else {
+        server_opts.reuseport = (enable ? 1 : 0);
+        ++server_opts.bind_gen;
+    }
+
     /* ENDPT UNLOCK */
     pthread_rwlock_unlock(&server_opts.endpt_lock);
 
@@ -1820,6 +2132,356 @@ nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
     return ret;
 }
 
+API void
+nc_server_set_preauth_limits(uint16_t max, uint16_t max_per_host)
+{
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.preauth_lock);
+    server_opts.preauth_max = max;
+    server_opts.preauth_max_per_host = max_per_host;
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.preauth_lock);
+}
+
+API void
+nc_server_set_conn_rate_limit(uint16_t per_host)
+{
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.preauth_lock);
+    server_opts.conn_rate_per_host = per_host;
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.preauth_lock);
+}
+
+API void
+nc_server_get_preauth_stats(uint16_t *preauth_count, uint32_t *rejected_max, uint32_t *rejected_host_max,
+                            uint32_t *rejected_rate)
+{
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.preauth_lock);
+    if (preauth_count) {
+        *preauth_count = server_opts.preauth_count;
+    }
+    if (rejected_max) {
+        *rejected_max = server_opts.preauth_rejected_max;
+    }
+    if (rejected_host_max) {
+        *rejected_host_max = server_opts.preauth_rejected_host_max;
+    }
+    if (rejected_rate) {
+        *rejected_rate = server_opts.preauth_rejected_rate;
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.preauth_lock);
+}
+
+static uint32_t
+nc_preauth_host_bucket(const char *addr)
+{
+    uint32_t hash = 0;
+
+    for (; *addr; ++addr) {
+        hash = hash * 31 + (unsigned char)*addr;
+    }
+    return hash % NC_PREAUTH_HOST_BUCKETS;
+}
+
+/**
+ * @brief Check the limits for a new connection from a host and account for it.
+ *
+ * @param[in] addr Address of the peer.
+ * @param[out] ph Host entry to pass to nc_server_preauth_release().
+ * @return 0 if the connection is allowed, 1 if it is rejected, -1 on error.
+ */
+static int
+nc_server_preauth_acquire(const char *addr, struct nc_preauth_host **ph)
+{
+    struct nc_preauth_host *iter, *prev = NULL, *host = NULL;
+    uint32_t bucket;
+    time_t now;
+    int ret = 0;
+
+    now = time(NULL);
+    bucket = nc_preauth_host_bucket(addr);
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.preauth_lock);
+
+    /* find the host and free the unused entries on the way */
+    iter = server_opts.preauth_hosts[bucket];
+    while (iter) {
+        if (!strcmp(iter->addr, addr)) {
+            host = iter;
+        } else if (!iter->preauth_count && (iter->rate_start != now)) {
+            if (prev) {
+                prev->next = iter->next;
+            } else {
+                server_opts.preauth_hosts[bucket] = iter->next;
+            }
+            free(iter);
+            iter = (prev ? prev->next : server_opts.preauth_hosts[bucket]);
+            continue;
+        }
+        prev = iter;
+        iter = iter->next;
+    }
+
+    if (server_opts.preauth_max && (server_opts.preauth_count >= server_opts.preauth_max)) {
+        ++server_opts.preauth_rejected_max;
+        ret = 1;
+        goto cleanup;
+    }
+
+    if (!host) {
+        host = calloc(1, sizeof *host);
+        if (!host) {
+            ERRMEM;
+            ret = -1;
+            goto cleanup;
+        }
+        strncpy(host->addr, addr, sizeof host->addr - 1);
+        host->next = server_opts.preauth_hosts[bucket];
+        server_opts.preauth_hosts[bucket] = host;
+    }
+
+    if (host->rate_start != now) {
+        host->rate_start = now;
+        host->rate_count = 0;
+    }
+    if (server_opts.conn_rate_per_host && (host->rate_count >= server_opts.conn_rate_per_host)) {
+        ++server_opts.preauth_rejected_rate;
+        ret = 1;
+        goto cleanup;
+    }
+    if (server_opts.preauth_max_per_host && (host->preauth_count >= server_opts.preauth_max_per_host)) {
+        ++server_opts.preauth_rejected_host_max;
+        ret = 1;
+        goto cleanup;
+    }
+
+    ++host->rate_count;
+    ++host->preauth_count;
+    ++server_opts.preauth_count;
+    *ph = host;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.preauth_lock);
+
+    return ret;
+}
+
+static void
+nc_server_preauth_release(struct nc_preauth_host *ph)
+{
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.preauth_lock);
+    --ph->preauth_count;
+    --server_opts.preauth_count;
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.preauth_lock);
+}
+
+/* listening sockets of one accepting thread in the reuseport mode */
+struct nc_thread_binds {
+    struct nc_bind *binds;  /* matching server_opts.binds, with own copies of addresses */
+    uint16_t count;
+    struct pollfd *pfds;    /* for polling binds, resized only when the number of binds changes */
+    uint16_t pfd_count;
+    uint32_t gen;           /* server_opts.bind_gen the binds were created for */
+};
+
+static pthread_key_t thread_binds_key;
+static pthread_once_t thread_binds_once = PTHREAD_ONCE_INIT;
+
+static void
+nc_thread_binds_clear(struct nc_thread_binds *tb)
+{
+    uint16_t i;
+
+    for (i = 0; i < tb->count; ++i) {
+        if (tb->binds[i].sock > -1) {
+            close(tb->binds[i].sock);
+        }
+        free((char *)tb->binds[i].address);
+    }
+    free(tb->binds);
+    tb->binds = NULL;
+    tb->count = 0;
+}
+
+static void
+nc_thread_binds_free(void *arg)
+{
+    struct nc_thread_binds *tb = arg;
+
+    nc_thread_binds_clear(tb);
+    free(tb->pfds);
+    free(tb);
+}
+
+static void
+nc_thread_binds_make_key(void)
+{
+    pthread_key_create(&thread_binds_key, nc_thread_binds_free);
+}
+
+/* ENDPT READ LOCK is expected to be held */
+static int
+nc_thread_binds_update(struct nc_thread_binds *tb)
+{
+    struct nc_bind *binds, *bind;
+    uint16_t i, j;
+    int listening = 0;
+
+    binds = calloc(server_opts.endpt_count, sizeof *binds);
+    if (!binds) {
+        ERRMEM;
+        return -1;
+    }
+
+    if (tb->pfd_count != server_opts.endpt_count) {
+        free(tb->pfds);
+        tb->pfds = malloc(server_opts.endpt_count * sizeof *tb->pfds);
+        if (!tb->pfds) {
+            ERRMEM;
+            tb->pfd_count = 0;
+            free(binds);
+            return -1;
+        }
+        tb->pfd_count = server_opts.endpt_count;
+    }
+
+    for (i = 0; i < server_opts.endpt_count; ++i) {
+        bind = &server_opts.binds[i];
+        binds[i].sock = -1;
+        if (!bind->address || !bind->port) {
+            continue;
+        }
+
+        /* keep the socket if this thread is already listening on the same address and port */
+        for (j = 0; j < tb->count; ++j) {
+            if ((tb->binds[j].sock > -1) && (tb->binds[j].port == bind->port) && !strcmp(tb->binds[j].address, bind->address)) {
+                break;
+            }
+        }
+
+        if (j < tb->count) {
+            memcpy(&binds[i], &tb->binds[j], sizeof *binds);
+            tb->binds[j].address = NULL;
+            tb->binds[j].sock = -1;
+
+            /* options of the endpoint may have changed */
+            nc_sock_set_tcp_opts(binds[i].sock, &server_opts.endpts[i].tcp, 1);
+            listen(binds[i].sock, server_opts.endpts[i].tcp.backlog ? server_opts.endpts[i].tcp.backlog : NC_REVERSE_QUEUE);
+        } else {
+            binds[i].address = strdup(bind->address);
+            if (!binds[i].address) {
+                ERRMEM;
+                continue;
+            }
+            binds[i].port = bind->port;
+            binds[i].sock = nc_sock_listen(bind->address, bind->port, &server_opts.endpts[i].tcp, 1);
+            if (binds[i].sock > -1) {
+                VRB("Listening on %s:%u with a thread socket.", bind->address, bind->port);
+            }
+        }
+
+        if (binds[i].sock > -1) {
+            listening = 1;
+        }
+    }
+
+    /* close sockets of the removed or changed endpoints */
+    nc_thread_binds_clear(tb);
+
+    tb->binds = binds;
+    tb->count = server_opts.endpt_count;
+    tb->gen = server_opts.bind_gen;
+
+    if (!listening) {
+        ERR("No listening sockets to accept sessions on.");
+        return -1;
+    }
+    return 0;
+}
+
+/* on success returns with ENDPT READ LOCK held */
+static int
+nc_accept_reuseport(int timeout, char **host, uint16_t *port, uint16_t *bind_idx)
+{
+    struct nc_thread_binds *tb;
+    uint32_t gen;
+    uint16_t i, bind_port;
+    int sock;
+
+    pthread_once(&thread_binds_once, nc_thread_binds_make_key);
+
+    tb = pthread_getspecific(thread_binds_key);
+    if (!tb) {
+        /* gen 0 never matches the current generation, which is changed by adding an endpoint */
+        tb = calloc(1, sizeof *tb);
+        if (!tb) {
+            ERRMEM;
+            return -1;
+        }
+        pthread_setspecific(thread_binds_key, tb);
+    }
+
+    /* ENDPT READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+    if (!server_opts.endpt_count) {
+        nc_thread_binds_clear(tb);
+        ERR("No endpoints to accept sessions on.");
+        /* ENDPT UNLOCK */
+        pthread_rwlock_unlock(&server_opts.endpt_lock);
+        return -1;
+    }
+
+    if ((tb->gen != server_opts.bind_gen) && nc_thread_binds_update(tb)) {
+        /* ENDPT UNLOCK */
+        pthread_rwlock_unlock(&server_opts.endpt_lock);
+        return -1;
+    }
+    gen = tb->gen;
+
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* wait for a new connection on the own sockets without holding any lock */
+    sock = nc_sock_accept_binds(tb->binds, tb->pfds, tb->count, timeout, host, port, bind_idx);
+    if (sock < 1) {
+        return sock;
+    }
+
+    /* ENDPT READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+    if (gen != server_opts.bind_gen) {
+        /* endpoints were changed meanwhile, find the one the connection was accepted on */
+        bind_port = tb->binds[*bind_idx].port;
+        for (i = 0; i < server_opts.endpt_count; ++i) {
+            if ((server_opts.binds[i].port == bind_port) && server_opts.binds[i].address
+                    && !strcmp(server_opts.binds[i].address, tb->binds[*bind_idx].address)) {
+                break;
+            }
+        }
+        if (i == server_opts.endpt_count) {
+            VRB("Endpoint of the accepted connection was removed, closing it.");
+            /* ENDPT UNLOCK */
+            pthread_rwlock_unlock(&server_opts.endpt_lock);
+            close(sock);
+            free(*host);
+            *host = NULL;
+            return 0;
+        }
+        *bind_idx = i;
+    }
+
+    return sock;
+}
+
 API NC_MSG_TYPE
 nc_accept(int timeout, struct nc_session **session)
 {
@@ -1827,6 +2489,7 @@ nc_accept(int timeout, struct nc_session **session)
     int sock, ret;
     char *host = NULL;
     uint16_t port, bind_idx;
+    struct nc_preauth_host *preauth = NULL;
 
     if (!server_opts.ctx) {
         ERRINIT;
@@ -1839,33 +2502,61 @@ nc_accept(int timeout, struct nc_session **session)
     /* BIND LOCK */
     pthread_mutex_lock(&server_opts.bind_lock);
 
-    if (!server_opts.endpt_count) {
-        ERR("No endpoints to accept sessions on.");
+    if (server_opts.reuseport) {
         /* BIND UNLOCK */
         pthread_mutex_unlock(&server_opts.bind_lock);
-        return NC_MSG_ERROR;
-    }
 
-    ret = nc_sock_accept_binds(server_opts.binds, server_opts.endpt_count, timeout, &host, &port, &bind_idx);
-    if (ret < 1) {
-        /* BIND UNLOCK */
-        pthread_mutex_unlock(&server_opts.bind_lock);
-        free(host);
-        if (!ret) {
-            return NC_MSG_WOULDBLOCK;
+        ret = nc_accept_reuseport(timeout, &host, &port, &bind_idx);
+        if (ret < 1) {
+            free(host);
+            if (!ret) {
+                return NC_MSG_WOULDBLOCK;
+            }
+            return NC_MSG_ERROR;
+        }
+        /* ENDPT READ LOCK held */
+    } else {
+        if (!server_opts.endpt_count) {
+            ERR("No endpoints to accept sessions on.");
+            /* BIND UNLOCK */
+            pthread_mutex_unlock(&server_opts.bind_lock);
+            return NC_MSG_ERROR;
+        }
+
+        ret = nc_sock_accept_binds(server_opts.binds, server_opts.bind_pfds, server_opts.endpt_count, timeout, &host, &port, &bind_idx);
+        if (ret < 1) {
+            /* BIND UNLOCK */
+            pthread_mutex_unlock(&server_opts.bind_lock);
+            free(host);
+            if (!ret) {
+                return NC_MSG_WOULDBLOCK;
+            }
+            return NC_MSG_ERROR;
         }
-        return NC_MSG_ERROR;
-    }
 
-    /* switch bind_lock for endpt_lock, so that another thread can accept another session */
-    /* ENDPT READ LOCK */
-    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+        /* switch bind_lock for endpt_lock, so that another thread can accept another session */
+        /* ENDPT READ LOCK */
+        pthread_rwlock_rdlock(&server_opts.endpt_lock);
 
-    /* BIND UNLOCK */
-    pthread_mutex_unlock(&server_opts.bind_lock);
+        /* BIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.bind_lock);
+    }
 
     sock = ret;
 
+    /* check the connection limits before allocating anything for the new session */
+    ret = nc_server_preauth_acquire(host ? host : "", &preauth);
+    if (ret) {
+        if (ret == 1) {
+            VRB("Connection from %s rejected, pre-authentication limits reached.", host ? host : "<unknown>");
+        }
+        /* ENDPT UNLOCK */
+        pthread_rwlock_unlock(&server_opts.endpt_lock);
+        close(sock);
+        free(host);
+        return (ret == 1) ? NC_MSG_WOULDBLOCK : NC_MSG_ERROR;
+    }
+
     *session = nc_new_session(0);
     if (!(*session)) {
         ERRMEM;
@@ -1886,6 +2577,12 @@ nc_accept(int timeout, struct nc_session **session)
     pthread_cond_init((*session)->ti_cond, NULL);
     *(*session)->ti_inuse = 0;
 
+    if (nc_sock_set_tcp_opts(sock, &server_opts.endpts[bind_idx].tcp, 0)) {
+        close(sock);
+        msgtype = NC_MSG_ERROR;
+        goto cleanup;
+    }
+
     /* sock gets assigned to session or closed */
 #ifdef NC_ENABLED_SSH
     if (server_opts.endpts[bind_idx].ti == NC_TI_LIBSSH) {
@@ -1934,6 +2631,7 @@ nc_accept(int timeout, struct nc_session **session)
 
     /* NETCONF handshake */
     msgtype = nc_handshake(*session);
+    nc_server_preauth_release(preauth);
     if (msgtype != NC_MSG_HELLO) {
         nc_session_free(*session, NULL);
         *session = NULL;
@@ -1948,6 +2646,7 @@ cleanup:
     /* ENDPT UNLOCK */
     pthread_rwlock_unlock(&server_opts.endpt_lock);
 
+    nc_server_preauth_release(preauth);
     nc_session_free(*session, NULL);
     *session = NULL;
     return msgtype;
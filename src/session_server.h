@@ -154,7 +154,8 @@ uint16_t nc_server_get_idle_timeout(void);
  * @brief Get all the server capabilities as will be sent to every client.
  *
  * A few capabilities (with-defaults, interleave) depend on the current
- * server options.
+ * server options. Capabilities of the server context are cached and created
+ * again only after its modules or features or these options change.
  *
  * @param[in] ctx Context to read most capabilities from.
  * @return Array of capabilities stored in the \p ctx dictionary, NULL on error.
@@ -333,6 +334,118 @@ int nc_server_endpt_set_address(const char *endpt_name, const char *address);
  */
 int nc_server_endpt_set_port(const char *endpt_name, uint16_t port);
 
+/**
+ * @brief Set TCP_NODELAY on the sessions accepted on an endpoint, which
+ *        disables the Nagle algorithm and lowers the latency of small replies.
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] enable Whether to set TCP_NODELAY, disabled by default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_endpt_set_tcp_nodelay(const char *endpt_name, int enable);
+
+/**
+ * @brief Enable TCP keepalives on the sessions accepted on an endpoint.
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] enable Whether to enable keepalives, disabled by default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_endpt_enable_keepalives(const char *endpt_name, int enable);
+
+/**
+ * @brief Set TCP keepalive parameters of an endpoint. They take effect only
+ *        if keepalives are enabled (nc_server_endpt_enable_keepalives()).
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] idle_time Idle time in seconds before sending the first probe, 0 for the system default.
+ * @param[in] max_probes Number of unanswered probes before dropping the connection, 0 for the system default.
+ * @param[in] probe_interval Interval between probes in seconds, 0 for the system default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_endpt_set_keepalives(const char *endpt_name, uint16_t idle_time, uint16_t max_probes,
+                                   uint16_t probe_interval);
+
+/**
+ * @brief Set TCP_USER_TIMEOUT on the sessions accepted on an endpoint, the maximum
+ *        time transmitted data may remain unacknowledged before the connection is dropped.
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] timeout Timeout in milliseconds, 0 for the system default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_endpt_set_user_timeout(const char *endpt_name, uint32_t timeout);
+
+/**
+ * @brief Set socket buffer sizes of an endpoint. They are applied to the listening
+ *        socket right away and inherited by all the sessions accepted on it.
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] sndbuf SO_SNDBUF size in bytes, 0 for the system default.
+ * @param[in] rcvbuf SO_RCVBUF size in bytes, 0 for the system default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_endpt_set_buffers(const char *endpt_name, int sndbuf, int rcvbuf);
+
+/**
+ * @brief Set the listen backlog of an endpoint, the number of established connections
+ *        waiting to be accepted. Applied to the listening socket right away.
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] backlog Listen backlog, 0 for the default (5).
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_endpt_set_backlog(const char *endpt_name, int backlog);
+
+/**
+ * @brief Limit the number of connections in the pre-authentication state, which lasts
+ *        from accepting a connection until its NETCONF handshake is finished.
+ *
+ * Connections over the limits are closed right after being accepted, before any
+ * transport (SSH/TLS) processing.
+ *
+ * @param[in] max Maximum number of all such connections, 0 for no limit (default).
+ * @param[in] max_per_host Maximum number of such connections from a single address, 0 for no limit (default).
+ */
+void nc_server_set_preauth_limits(uint16_t max, uint16_t max_per_host);
+
+/**
+ * @brief Limit the rate of new connections from a single address.
+ *
+ * Connections over the limit are closed right after being accepted.
+ *
+ * @param[in] per_host Maximum number of new connections from a single address per second, 0 for no limit (default).
+ */
+void nc_server_set_conn_rate_limit(uint16_t per_host);
+
+/**
+ * @brief Get the current number of connections in the pre-authentication state and
+ *        the counters of connections rejected because of the limits.
+ *
+ * @param[out] preauth_count Current number of connections in the pre-authentication state. Can be NULL.
+ * @param[out] rejected_max Connections rejected because of the global limit. Can be NULL.
+ * @param[out] rejected_host_max Connections rejected because of the per-address limit. Can be NULL.
+ * @param[out] rejected_rate Connections rejected because of the rate limit. Can be NULL.
+ */
+void nc_server_get_preauth_stats(uint16_t *preauth_count, uint32_t *rejected_max, uint32_t *rejected_host_max,
+                                 uint32_t *rejected_rate);
+
+/**
+ * @brief Switch the reuseport accepting mode.
+ *
+ * In this mode every thread calling nc_accept() listens on its own SO_REUSEPORT
+ * sockets of all the endpoints, the kernel balances new connections among them
+ * and no lock is held while waiting for a connection. The sockets are created
+ * on the first nc_accept() call of a thread and recreated only when the endpoints
+ * change, any errors are reported by nc_accept(). They are closed when the thread exits.
+ *
+ * Can only be changed with no endpoints added.
+ *
+ * @param[in] enable Whether to use the reuseport mode, disabled by default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_set_reuseport(int enable);
+
 /**
  * @brief Accept new sessions on all the listening endpoints.
  *
@@ -390,6 +503,8 @@ int nc_server_ssh_add_authkey(const char *pubkey_base64, NC_SSH_KEY_TYPE type, c
  * @brief Add an authorized client SSH public key. This public key can be used for
  *        publickey authentication (for any SSH connection, even Call Home) afterwards.
  *
+ * The key is read right away and read again only when the file modification time changes.
+ *
  * @param[in] pubkey_path Path to the public key.
  * @param[in] username Username that the client with the public key must use.
  * @return 0 on success, -1 on error.
@@ -408,6 +523,26 @@ int nc_server_ssh_add_authkey_path(const char *pubkey_path, const char *username
 int nc_server_ssh_del_authkey(const char *pubkey_path, const char *pubkey_base64, NC_SSH_KEY_TYPE type,
                               const char *username);
 
+/**
+ * @brief Set the maximum number of password verifications (password and keyboard-interactive
+ *        authentication) running at the same time. Hashing a password is expensive so limiting
+ *        it keeps the other server threads responsive during connection storms. Verifications
+ *        over the limit fail right away without waiting, the client can try again. Unlimited by default.
+ *
+ * @param[in] max_running Maximum number of concurrent verifications, 0 for unlimited.
+ */
+void nc_server_ssh_set_passwd_auth_max(uint16_t max_running);
+
+/**
+ * @brief Set how long a successful password verification is remembered. Following authentications
+ *        of the same user with the same password during this time are accepted without hashing
+ *        the password again. Any change of the user password invalidates the remembered verification.
+ *        Disabled by default.
+ *
+ * @param[in] cache_timeout Number of seconds a verification is remembered, 0 disables (and clears) the cache.
+ */
+void nc_server_ssh_set_passwd_cache_timeout(uint16_t cache_timeout);
+
 /**
  * @brief Add endpoint SSH host keys the server will identify itself with. Only the name is set, the key itself
  *        wil be retrieved using a callback.
@@ -424,6 +559,10 @@ int nc_server_ssh_endpt_add_hostkey(const char *endpt_name, const char *name, in
  *        a maximum of one key of each type will be used during SSH authentication, later keys replacing
  *        the earlier ones.
  *
+ * The keys are retrieved and loaded in memory on the first accept on an endpoint (or Call Home client) and
+ * then reused. They are loaded again only after the endpoint host keys or banner change or after this
+ * function is called again.
+ *
  * @param[in] hostkey_clb Callback that should return the key itself. Zero return indicates success, non-zero
  *                        an error. On success exactly ONE of \p privkey_path or \p privkey_data is expected
  *                        to be set. The one set will be freed.
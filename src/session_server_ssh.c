@@ -15,6 +15,7 @@
 #define _GNU_SOURCE
 #define _POSIX_SOURCE
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -30,47 +31,44 @@
 
 extern struct nc_server_opts server_opts;
 
-static char *
-base64der_key_to_tmp_file(const char *in, int rsa)
+static ssh_key
+base64der_key_import(const char *in, int rsa)
 {
-    char path[12] = "/tmp/XXXXXX";
-    int fd, written;
-    mode_t umode;
-    FILE *file;
+    char *pem;
+    int ret;
+    ssh_key key = NULL;
 
     if (in == NULL) {
         return NULL;
     }
 
-    umode = umask(0600);
-    fd = mkstemp(path);
-    umask(umode);
-    if (fd == -1) {
+    /* wrap the key into a PEM structure, only in memory */
+    if (asprintf(&pem, "-----BEGIN %s PRIVATE KEY-----\n%s\n-----END %s PRIVATE KEY-----",
+                 (rsa ? "RSA" : "DSA"), in, (rsa ? "RSA" : "DSA")) == -1) {
+        ERRMEM;
         return NULL;
     }
 
-    file = fdopen(fd, "r");
-    if (!file) {
-        close(fd);
-        return NULL;
-    }
+    ret = ssh_pki_import_privkey_base64(pem, NULL, NULL, NULL, &key);
 
-    /* write the key into the file */
-    written = fwrite("-----BEGIN ", 1, 11, file);
-    written += fwrite((rsa ? "RSA" : "DSA"), 1, 3, file);
-    written += fwrite(" PRIVATE KEY-----\n", 1, 18, file);
-    written += fwrite(in, 1, strlen(in), file);
-    written += fwrite("\n-----END ", 1, 10, file);
-    written += fwrite((rsa ? "RSA" : "DSA"), 1, 3, file);
-    written += fwrite(" PRIVATE KEY-----", 1, 17, file);
+    /* do not leave the private key lying around in freed memory */
+    memset(pem, 0, strlen(pem));
+    free(pem);
 
-    fclose(file);
-    if ((unsigned)written != 62 + strlen(in)) {
-        unlink(path);
+    if (ret != SSH_OK) {
         return NULL;
     }
+    return key;
+}
 
-    return strdup(path);
+static void
+nc_server_ssh_clear_bind(struct nc_server_ssh_opts *opts)
+{
+    /* the bind is created again with the current options on the next accept */
+    if (opts->sbind) {
+        ssh_bind_free(opts->sbind);
+        opts->sbind = NULL;
+    }
 }
 
 static int
@@ -108,6 +106,7 @@ nc_server_ssh_add_hostkey(const char *name, int16_t idx, struct nc_server_ssh_op
     }
     opts->hostkeys[idx] = lydict_insert(server_opts.ctx, name, 0);
 
+    nc_server_ssh_clear_bind(opts);
     return 0;
 }
 
@@ -152,6 +151,8 @@ nc_server_ssh_set_hostkey_clb(int (*hostkey_clb)(const char *name, void *user_da
                                                  char **privkey_data, int *privkey_data_rsa),
                               void *user_data, void (*free_user_data)(void *user_data))
 {
+    uint16_t i;
+
     if (!hostkey_clb) {
         ERRARG("hostkey_clb");
         return;
@@ -160,6 +161,27 @@ nc_server_ssh_set_hostkey_clb(int (*hostkey_clb)(const char *name, void *user_da
     server_opts.hostkey_clb = hostkey_clb;
     server_opts.hostkey_data = user_data;
     server_opts.hostkey_data_free = free_user_data;
+
+    /* the keys may have changed, they will be loaded again on the next accept */
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+    for (i = 0; i < server_opts.endpt_count; ++i) {
+        if (server_opts.endpts[i].ti == NC_TI_LIBSSH) {
+            nc_server_ssh_clear_bind(server_opts.endpts[i].opts.ssh);
+        }
+    }
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.ch_client_lock);
+    for (i = 0; i < server_opts.ch_client_count; ++i) {
+        if (server_opts.ch_clients[i].ti == NC_TI_LIBSSH) {
+            nc_server_ssh_clear_bind(server_opts.ch_clients[i].opts.ssh);
+        }
+    }
+    /* UNLOCK */
+    pthread_rwlock_unlock(&server_opts.ch_client_lock);
 }
 
 static int
@@ -204,6 +226,7 @@ remove_idx:
         }
     }
 
+    nc_server_ssh_clear_bind(opts);
     return 0;
 }
 
@@ -292,6 +315,8 @@ nc_server_ssh_mov_hostkey(const char *key_mov, const char *key_after, struct nc_
         opts->hostkeys[after_idx] = bckup;
     }
 
+    /* key order matters */
+    nc_server_ssh_clear_bind(opts);
     return 0;
 }
 
@@ -348,6 +373,7 @@ nc_server_ssh_mod_hostkey(const char *name, const char *new_name, struct nc_serv
         if (!strcmp(opts->hostkeys[i], name)) {
             lydict_remove(server_opts.ctx, opts->hostkeys[i]);
             opts->hostkeys[i] = lydict_insert(server_opts.ctx, new_name, 0);
+            nc_server_ssh_clear_bind(opts);
             return 0;
         }
     }
@@ -367,7 +393,7 @@ nc_server_ssh_endpt_mod_hostkey(const char *endpt_name, const char *name, const
     if (!endpt) {
         return -1;
     }
-    ret = nc_server_ssh_mov_hostkey(name, new_name, endpt->opts.ssh);
+    ret = nc_server_ssh_mod_hostkey(name, new_name, endpt->opts.ssh);
     /* UNLOCK */
     pthread_rwlock_unlock(&server_opts.endpt_lock);
 
@@ -404,6 +430,7 @@ nc_server_ssh_set_banner(const char *banner, struct nc_server_ssh_opts *opts)
         lydict_remove(server_opts.ctx, opts->banner);
     }
     opts->banner = lydict_insert(server_opts.ctx, banner, 0);
+    nc_server_ssh_clear_bind(opts);
     return 0;
 }
 
@@ -588,28 +615,162 @@ nc_server_ssh_ch_client_set_auth_timeout(const char *client_name, uint16_t auth_
     return ret;
 }
 
+/* authkey WRITE lock is expected to be held */
+static void
+authkey_import(uint16_t i)
+{
+    struct stat st;
+    unsigned char *hash;
+    size_t hlen;
+    int ret = SSH_ERROR;
+
+    ssh_key_free(server_opts.authkeys[i].key);
+    server_opts.authkeys[i].key = NULL;
+    server_opts.authkeys[i].mtime = 0;
+    server_opts.authkeys[i].size = 0;
+    server_opts.authkeys[i].ino = 0;
+
+    switch (server_opts.authkeys[i].type) {
+    case NC_SSH_KEY_UNKNOWN:
+        if (stat(server_opts.authkeys[i].path, &st)) {
+            ret = SSH_EOF;
+            break;
+        }
+        server_opts.authkeys[i].mtime = st.st_mtime;
+        server_opts.authkeys[i].size = st.st_size;
+        server_opts.authkeys[i].ino = st.st_ino;
+        ret = ssh_pki_import_pubkey_file(server_opts.authkeys[i].path, &server_opts.authkeys[i].key);
+        break;
+    case NC_SSH_KEY_DSA:
+        ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_DSS, &server_opts.authkeys[i].key);
+        break;
+    case NC_SSH_KEY_RSA:
+        ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_RSA, &server_opts.authkeys[i].key);
+        break;
+    case NC_SSH_KEY_ECDSA:
+        ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_ECDSA, &server_opts.authkeys[i].key);
+        break;
+    }
+
+    if (ret == SSH_EOF) {
+        WRN("Failed to import a public key of \"%s\" (File access problem).", server_opts.authkeys[i].username);
+    } else if (ret == SSH_ERROR) {
+        WRN("Failed to import a public key of \"%s\" (SSH error).", server_opts.authkeys[i].username);
+    }
+    if (ret != SSH_OK) {
+        server_opts.authkeys[i].key = NULL;
+        return;
+    }
+
+    hash = NULL;
+    if (ssh_get_publickey_hash(server_opts.authkeys[i].key, SSH_PUBLICKEY_HASH_SHA1, &hash, &hlen)
+            || (hlen != NC_SSH_AUTHKEY_FP_LEN)) {
+        WRN("Failed to get a public key fingerprint of \"%s\".", server_opts.authkeys[i].username);
+        if (hash) {
+            ssh_clean_pubkey_hash(&hash);
+        }
+        ssh_key_free(server_opts.authkeys[i].key);
+        server_opts.authkeys[i].key = NULL;
+        return;
+    }
+    memcpy(server_opts.authkeys[i].fp, hash, NC_SSH_AUTHKEY_FP_LEN);
+    ssh_clean_pubkey_hash(&hash);
+}
+
+static uint32_t
+authkey_fp_bucket(const unsigned char *fp)
+{
+    /* fingerprint bytes are uniformly distributed */
+    return (((uint32_t)fp[0] << 24) | ((uint32_t)fp[1] << 16) | ((uint32_t)fp[2] << 8) | fp[3])
+           & (server_opts.authkey_idx_size - 1);
+}
+
+/* authkey WRITE lock is expected to be held */
+static void
+authkey_idx_insert(uint16_t i)
+{
+    uint32_t bucket;
+
+    if (!server_opts.authkeys[i].key) {
+        /* nothing to index */
+        return;
+    }
+
+    bucket = authkey_fp_bucket(server_opts.authkeys[i].fp);
+    server_opts.authkeys[i].next = server_opts.authkey_idx[bucket];
+    server_opts.authkey_idx[bucket] = i;
+}
+
+/* authkey WRITE lock is expected to be held */
+static int
+authkey_idx_rebuild(void)
+{
+    uint32_t size, i;
+
+    /* keep the load factor at most 1 */
+    for (size = 16; size < server_opts.authkey_count; size <<= 1);
+
+    if (size != server_opts.authkey_idx_size) {
+        server_opts.authkey_idx = nc_realloc(server_opts.authkey_idx, size * sizeof *server_opts.authkey_idx);
+        if (!server_opts.authkey_idx) {
+            server_opts.authkey_idx_size = 0;
+            ERRMEM;
+            return -1;
+        }
+        server_opts.authkey_idx_size = size;
+    }
+
+    for (i = 0; i < server_opts.authkey_idx_size; ++i) {
+        server_opts.authkey_idx[i] = -1;
+    }
+    for (i = 0; i < server_opts.authkey_count; ++i) {
+        authkey_idx_insert(i);
+    }
+
+    return 0;
+}
+
 static int
 _nc_server_ssh_add_authkey(const char *pubkey_path, const char *pubkey_base64, NC_SSH_KEY_TYPE type,
                           const char *username)
 {
-    /* LOCK */
-    pthread_mutex_lock(&server_opts.authkey_lock);
+    uint16_t i;
+    int ret = 0;
+    struct nc_authkey *new;
 
-    ++server_opts.authkey_count;
-    server_opts.authkeys = nc_realloc(server_opts.authkeys, server_opts.authkey_count * sizeof *server_opts.authkeys);
-    if (!server_opts.authkeys) {
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.authkey_lock);
+
+    /* on failure the keys and their index stay as they were */
+    new = realloc(server_opts.authkeys, (server_opts.authkey_count + 1) * sizeof *server_opts.authkeys);
+    if (!new) {
         ERRMEM;
-        return -1;
+        ret = -1;
+        goto cleanup;
+    }
+    server_opts.authkeys = new;
+    i = server_opts.authkey_count++;
+    server_opts.authkeys[i].path = lydict_insert(server_opts.ctx, pubkey_path, 0);
+    server_opts.authkeys[i].base64 = lydict_insert(server_opts.ctx, pubkey_base64, 0);
+    server_opts.authkeys[i].type = type;
+    server_opts.authkeys[i].username = lydict_insert(server_opts.ctx, username, 0);
+    server_opts.authkeys[i].key = NULL;
+    server_opts.authkeys[i].next = -1;
+
+    /* parse the key only once now */
+    authkey_import(i);
+
+    if (server_opts.authkey_count > server_opts.authkey_idx_size) {
+        ret = authkey_idx_rebuild();
+    } else {
+        authkey_idx_insert(i);
     }
-    server_opts.authkeys[server_opts.authkey_count - 1].path = lydict_insert(server_opts.ctx, pubkey_path, 0);
-    server_opts.authkeys[server_opts.authkey_count - 1].base64 = lydict_insert(server_opts.ctx, pubkey_base64, 0);
-    server_opts.authkeys[server_opts.authkey_count - 1].type = type;
-    server_opts.authkeys[server_opts.authkey_count - 1].username = lydict_insert(server_opts.ctx, username, 0);
 
+cleanup:
     /* UNLOCK */
-    pthread_mutex_unlock(&server_opts.authkey_lock);
+    pthread_rwlock_unlock(&server_opts.authkey_lock);
 
-    return 0;
+    return ret;
 }
 
 API int
@@ -650,29 +811,36 @@ nc_server_ssh_del_authkey(const char *pubkey_path, const char *pubkey_base64, NC
     uint32_t i;
     int ret = -1;
 
-    /* LOCK */
-    pthread_mutex_lock(&server_opts.authkey_lock);
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.authkey_lock);
 
     if (!pubkey_path && !pubkey_base64 && !type && !username) {
         for (i = 0; i < server_opts.authkey_count; ++i) {
             lydict_remove(server_opts.ctx, server_opts.authkeys[i].path);
             lydict_remove(server_opts.ctx, server_opts.authkeys[i].base64);
             lydict_remove(server_opts.ctx, server_opts.authkeys[i].username);
+            ssh_key_free(server_opts.authkeys[i].key);
 
             ret = 0;
         }
         free(server_opts.authkeys);
         server_opts.authkeys = NULL;
         server_opts.authkey_count = 0;
+
+        free(server_opts.authkey_idx);
+        server_opts.authkey_idx = NULL;
+        server_opts.authkey_idx_size = 0;
     } else {
-        for (i = 0; i < server_opts.authkey_count; ++i) {
-            if ((!pubkey_path || !strcmp(server_opts.authkeys[i].path, pubkey_path))
-                    && (!pubkey_base64 || strcmp(server_opts.authkeys[i].base64, pubkey_base64))
+        for (i = 0; i < server_opts.authkey_count; ) {
+            if ((!pubkey_path || (server_opts.authkeys[i].path && !strcmp(server_opts.authkeys[i].path, pubkey_path)))
+                    && (!pubkey_base64 || (server_opts.authkeys[i].base64
+                    && !strcmp(server_opts.authkeys[i].base64, pubkey_base64)))
                     && (!type || (server_opts.authkeys[i].type == type))
                     && (!username || !strcmp(server_opts.authkeys[i].username, username))) {
                 lydict_remove(server_opts.ctx, server_opts.authkeys[i].path);
                 lydict_remove(server_opts.ctx, server_opts.authkeys[i].base64);
                 lydict_remove(server_opts.ctx, server_opts.authkeys[i].username);
+                ssh_key_free(server_opts.authkeys[i].key);
 
                 --server_opts.authkey_count;
                 if (i < server_opts.authkey_count) {
@@ -684,12 +852,19 @@ nc_server_ssh_del_authkey(const char *pubkey_path, const char *pubkey_base64, NC
                 }
 
                 ret = 0;
+                /* check the moved key on the same index */
+                continue;
             }
+            ++i;
+        }
+
+        if (!ret && authkey_idx_rebuild()) {
+            ret = -1;
         }
     }
 
     /* UNLOCK */
-    pthread_mutex_unlock(&server_opts.authkey_lock);
+    pthread_rwlock_unlock(&server_opts.authkey_lock);
 
     return ret;
 }
@@ -702,6 +877,7 @@ nc_server_ssh_clear_opts(struct nc_server_ssh_opts *opts)
         lydict_remove(server_opts.ctx, opts->banner);
         opts->banner = NULL;
     }
+    nc_server_ssh_clear_bind(opts);
 }
 
 static char *
@@ -769,21 +945,231 @@ auth_password_compare_pwd(const char *pass_hash, const char *pass_clear)
     return strcmp(new_pass_hash, pass_hash);
 }
 
+/* generate a crypt(3) setting with a random salt for the SHA-256 method with the fewest rounds */
+static int
+auth_password_cache_setting(char setting[NC_SSH_PASSWD_SETTING_LEN])
+{
+    const char *salt_chars = "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    unsigned char rnd[16];
+    FILE *urandom;
+    size_t i;
+    int len;
+
+    urandom = fopen("/dev/urandom", "r");
+    if (!urandom) {
+        return -1;
+    }
+    if (fread(rnd, 1, sizeof rnd, urandom) != sizeof rnd) {
+        fclose(urandom);
+        return -1;
+    }
+    fclose(urandom);
+
+    len = sprintf(setting, "$5$rounds=1000$");
+    for (i = 0; i < sizeof rnd; ++i) {
+        setting[len++] = salt_chars[rnd[i] & 0x3f];
+    }
+    setting[len++] = '$';
+    setting[len] = '\0';
+
+    return 0;
+}
+
+API void
+nc_server_ssh_set_passwd_auth_max(uint16_t max_running)
+{
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.passwd_lock);
+
+    server_opts.passwd_auth_max = max_running;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.passwd_lock);
+}
+
+API void
+nc_server_ssh_set_passwd_cache_timeout(uint16_t cache_timeout)
+{
+    uint16_t i;
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.passwd_lock);
+
+    if (cache_timeout && !server_opts.passwd_cache_timeout) {
+        /* new salt so that the digests cannot be precomputed */
+        if (auth_password_cache_setting(server_opts.passwd_cache_setting)) {
+            ERR("Failed to generate a password cache salt, cache not enabled.");
+            cache_timeout = 0;
+        }
+    }
+
+    if (!cache_timeout) {
+        for (i = 0; i < NC_SSH_PASSWD_CACHE_SIZE; ++i) {
+            lydict_remove(server_opts.ctx, server_opts.passwd_cache[i].username);
+        }
+        memset(server_opts.passwd_cache, 0, sizeof server_opts.passwd_cache);
+    }
+    server_opts.passwd_cache_timeout = cache_timeout;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.passwd_lock);
+}
+
+/* salted digest of a verified password, the stored hash is included so that any password change invalidates it,
+ * it is much cheaper than the usual password hashes but still not a plain hash */
+static int
+auth_password_digest(const char *setting, const char *pass_hash, const char *pass_clear,
+                     char digest[NC_SSH_PASSWD_DIGEST_LEN])
+{
+    struct crypt_data cdata;
+    char *key, *hash;
+
+    if (asprintf(&key, "%s:%s", pass_hash, pass_clear) == -1) {
+        ERRMEM;
+        return -1;
+    }
+
+    cdata.initialized = 0;
+    hash = crypt_r(key, setting, &cdata);
+    free(key);
+    if (!hash || (hash[0] != '$') || (strlen(hash) >= NC_SSH_PASSWD_DIGEST_LEN)) {
+        return -1;
+    }
+
+    strcpy(digest, hash);
+    return 0;
+}
+
+/* passwd_lock is expected to be held, returns index of the valid verification of the user in the cache or -1 */
+static int
+auth_password_cache_find(const char *username, time_t now)
+{
+    int i;
+
+    for (i = 0; i < NC_SSH_PASSWD_CACHE_SIZE; ++i) {
+        if (server_opts.passwd_cache[i].username && (server_opts.passwd_cache[i].expire > now)
+                && !strcmp(server_opts.passwd_cache[i].username, username)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* passwd_lock is expected to be held */
 static void
-nc_sshcb_auth_password(struct nc_session *session, ssh_message msg)
+auth_password_cache_add(const char *username, const char *digest, time_t now)
+{
+    int i, victim = 0;
+
+    for (i = 0; i < NC_SSH_PASSWD_CACHE_SIZE; ++i) {
+        if (server_opts.passwd_cache[i].username && !strcmp(server_opts.passwd_cache[i].username, username)) {
+            /* replace the previous verification of this user */
+            victim = i;
+            break;
+        }
+        /* otherwise replace the entry expiring first (empty entries expire at 0) */
+        if (server_opts.passwd_cache[i].expire < server_opts.passwd_cache[victim].expire) {
+            victim = i;
+        }
+    }
+
+    lydict_remove(server_opts.ctx, server_opts.passwd_cache[victim].username);
+    server_opts.passwd_cache[victim].username = lydict_insert(server_opts.ctx, username, 0);
+    strcpy(server_opts.passwd_cache[victim].digest, digest);
+    server_opts.passwd_cache[victim].expire = now + server_opts.passwd_cache_timeout;
+}
+
+/* 0 on successful verification, non-zero otherwise */
+static int
+auth_password_verify(const char *username, const char *pass_clear)
 {
     char *pass_hash;
+    char setting[NC_SSH_PASSWD_SETTING_LEN], cached[NC_SSH_PASSWD_DIGEST_LEN], digest[NC_SSH_PASSWD_DIGEST_LEN];
+    struct timespec ts_cur;
+    int ret, cache, idx;
 
-    pass_hash = auth_password_get_pwd_hash(session->username);
-    if (pass_hash && !auth_password_compare_pwd(pass_hash, ssh_message_auth_password(msg))) {
+    pass_hash = auth_password_get_pwd_hash(username);
+    if (!pass_hash) {
+        return 1;
+    }
+
+    nc_gettimespec(&ts_cur);
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.passwd_lock);
+
+    if (server_opts.passwd_auth_max && (server_opts.passwd_auth_running >= server_opts.passwd_auth_max)) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&server_opts.passwd_lock);
+
+        /* do not make the thread wait, the client can try again */
+        WRN("Too many concurrent password verifications, user \"%s\" not verified.", username);
+        free(pass_hash);
+        return 1;
+    }
+    ++server_opts.passwd_auth_running;
+
+    cache = (server_opts.passwd_cache_timeout ? 1 : 0);
+    idx = -1;
+    if (cache) {
+        strcpy(setting, server_opts.passwd_cache_setting);
+        idx = auth_password_cache_find(username, ts_cur.tv_sec);
+        if (idx > -1) {
+            strcpy(cached, server_opts.passwd_cache[idx].digest);
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.passwd_lock);
+
+    /* a digest is computed before the verification only if the user has been verified recently */
+    ret = 1;
+    if ((idx > -1) && !auth_password_digest(setting, pass_hash, pass_clear, digest)) {
+        if (!strcmp(digest, cached)) {
+            VRB("User \"%s\" password verification remembered.", username);
+            ret = 0;
+            cache = 0;
+        }
+    } else {
+        digest[0] = '\0';
+    }
+
+    if (ret) {
+        /* the expensive part */
+        ret = auth_password_compare_pwd(pass_hash, pass_clear);
+        if (!ret && cache && !digest[0] && auth_password_digest(setting, pass_hash, pass_clear, digest)) {
+            cache = 0;
+        }
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.passwd_lock);
+
+    --server_opts.passwd_auth_running;
+
+    /* the cache could have been switched meanwhile, the digest must use the current salt */
+    if (!ret && cache && server_opts.passwd_cache_timeout && !strcmp(setting, server_opts.passwd_cache_setting)) {
+        auth_password_cache_add(username, digest, ts_cur.tv_sec);
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.passwd_lock);
+
+    free(pass_hash);
+    return ret;
+}
+
+static void
+nc_sshcb_auth_password(struct nc_session *session, ssh_message msg)
+{
+    if (!auth_password_verify(session->username, ssh_message_auth_password(msg))) {
         VRB("User \"%s\" authenticated.", session->username);
         ssh_message_auth_reply_success(msg, 0);
         session->flags |= NC_SESSION_SSH_AUTHENTICATED;
-        free(pass_hash);
         return;
     }
 
-    free(pass_hash);
     ++session->opts.server.ssh_auth_attempts;
     VRB("Failed user \"%s\" authentication attempt (#%d).", session->username, session->opts.server.ssh_auth_attempts);
     ssh_message_reply_default(msg);
@@ -792,8 +1178,6 @@ nc_sshcb_auth_password(struct nc_session *session, ssh_message msg)
 static void
 nc_sshcb_auth_kbdint(struct nc_session *session, ssh_message msg)
 {
-    char *pass_hash;
-
     if (!ssh_message_auth_kbdint_is_response(msg)) {
         const char *prompts[] = {"Password: "};
         char echo[] = {0};
@@ -804,12 +1188,7 @@ nc_sshcb_auth_kbdint(struct nc_session *session, ssh_message msg)
             ssh_message_reply_default(msg);
             return;
         }
-        pass_hash = auth_password_get_pwd_hash(session->username);
-        if (!pass_hash) {
-            ssh_message_reply_default(msg);
-            return;
-        }
-        if (!auth_password_compare_pwd(pass_hash, ssh_userauth_kbdint_getanswer(session->ti.libssh.session, 0))) {
+        if (!auth_password_verify(session->username, ssh_userauth_kbdint_getanswer(session->ti.libssh.session, 0))) {
             VRB("User \"%s\" authenticated.", session->username);
             session->flags |= NC_SESSION_SSH_AUTHENTICATED;
             ssh_message_auth_reply_success(msg, 0);
@@ -818,60 +1197,129 @@ nc_sshcb_auth_kbdint(struct nc_session *session, ssh_message msg)
             VRB("Failed user \"%s\" authentication attempt (#%d).", session->username, session->opts.server.ssh_auth_attempts);
             ssh_message_reply_default(msg);
         }
-        free(pass_hash);
     }
 }
 
-static const char *
-auth_pubkey_compare_key(ssh_key key)
+/* authkey lock is expected to be held, mtime alone misses changes within the same second */
+static int
+auth_pubkey_file_changed(uint16_t i)
 {
-    uint32_t i;
-    ssh_key pub_key;
-    const char *username = NULL;
-    int ret = 0;
+    struct stat st;
 
-    /* LOCK */
-    pthread_mutex_lock(&server_opts.authkey_lock);
+    if (stat(server_opts.authkeys[i].path, &st)) {
+        /* file was removed, if it existed */
+        return server_opts.authkeys[i].mtime ? 1 : 0;
+    }
+
+    return (st.st_mtime != server_opts.authkeys[i].mtime) || (st.st_size != server_opts.authkeys[i].size)
+            || (st.st_ino != server_opts.authkeys[i].ino);
+}
+
+/* authkey READ lock is expected to be held */
+static int
+auth_pubkey_files_changed(void)
+{
+    uint16_t i;
+    time_t now;
+
+    /* do not stat the files on every authentication attempt */
+    now = time(NULL);
+    /* CHECK LOCK */
+    pthread_mutex_lock(&server_opts.authkey_check_lock);
+    if ((now >= server_opts.authkey_check) && (now - server_opts.authkey_check < NC_SSH_AUTHKEY_CHECK_INTERVAL)) {
+        /* CHECK UNLOCK */
+        pthread_mutex_unlock(&server_opts.authkey_check_lock);
+        return 0;
+    }
+    server_opts.authkey_check = now;
+    /* CHECK UNLOCK */
+    pthread_mutex_unlock(&server_opts.authkey_check_lock);
 
     for (i = 0; i < server_opts.authkey_count; ++i) {
-        switch (server_opts.authkeys[i].type) {
-        case NC_SSH_KEY_UNKNOWN:
-            ret = ssh_pki_import_pubkey_file(server_opts.authkeys[i].path, &pub_key);
-            break;
-        case NC_SSH_KEY_DSA:
-            ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_DSS, &pub_key);
-            break;
-        case NC_SSH_KEY_RSA:
-            ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_RSA, &pub_key);
-            break;
-        case NC_SSH_KEY_ECDSA:
-            ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_ECDSA, &pub_key);
-            break;
+        if ((server_opts.authkeys[i].type == NC_SSH_KEY_UNKNOWN) && auth_pubkey_file_changed(i)) {
+            return 1;
         }
+    }
 
-        if (ret == SSH_EOF) {
-            WRN("Failed to import a public key of \"%s\" (File access problem).", server_opts.authkeys[i].username);
-            continue;
-        } else if (ret == SSH_ERROR) {
-            WRN("Failed to import a public key of \"%s\" (SSH error).", server_opts.authkeys[i].username);
+    return 0;
+}
+
+/* authkey WRITE lock is expected to be held */
+static void
+auth_pubkey_reload_files(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < server_opts.authkey_count; ++i) {
+        if ((server_opts.authkeys[i].type != NC_SSH_KEY_UNKNOWN) || !auth_pubkey_file_changed(i)) {
             continue;
         }
 
-        if (!ssh_key_cmp(key, pub_key, SSH_KEY_CMP_PUBLIC)) {
-            ssh_key_free(pub_key);
-            break;
+        VRB("Public key file \"%s\" changed, reloading it.", server_opts.authkeys[i].path);
+        authkey_import(i);
+    }
+
+    authkey_idx_rebuild();
+}
+
+static const char *
+auth_pubkey_compare_key(ssh_key key)
+{
+    int32_t i;
+    unsigned char *hash;
+    size_t hlen;
+    const char *username = NULL;
+
+    hash = NULL;
+    if (ssh_get_publickey_hash(key, SSH_PUBLICKEY_HASH_SHA1, &hash, &hlen) || (hlen != NC_SSH_AUTHKEY_FP_LEN)) {
+        ERR("Failed to get the presented public key fingerprint.");
+        if (hash) {
+            ssh_clean_pubkey_hash(&hash);
         }
+        return NULL;
+    }
 
-        ssh_key_free(pub_key);
+    /* READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.authkey_lock);
+
+    if (auth_pubkey_files_changed()) {
+        /* UNLOCK */
+        pthread_rwlock_unlock(&server_opts.authkey_lock);
+        /* WRITE LOCK */
+        pthread_rwlock_wrlock(&server_opts.authkey_lock);
+
+        /* someone else may have reloaded them in the meantime, but it does not matter */
+        auth_pubkey_reload_files();
+
+        /* UNLOCK */
+        pthread_rwlock_unlock(&server_opts.authkey_lock);
+        /* READ LOCK */
+        pthread_rwlock_rdlock(&server_opts.authkey_lock);
     }
 
-    if (i < server_opts.authkey_count) {
-        username = server_opts.authkeys[i].username;
+    if (server_opts.authkey_idx_size) {
+        for (i = server_opts.authkey_idx[authkey_fp_bucket(hash)]; i > -1; i = server_opts.authkeys[i].next) {
+            if (!memcmp(server_opts.authkeys[i].fp, hash, NC_SSH_AUTHKEY_FP_LEN)
+                    && !ssh_key_cmp(key, server_opts.authkeys[i].key, SSH_KEY_CMP_PUBLIC)) {
+                username = server_opts.authkeys[i].username;
+                break;
+            }
+        }
+    } else {
+        /* the index could not be allocated */
+        for (i = 0; i < server_opts.authkey_count; ++i) {
+            if (server_opts.authkeys[i].key && !memcmp(server_opts.authkeys[i].fp, hash, NC_SSH_AUTHKEY_FP_LEN)
+                    && !ssh_key_cmp(key, server_opts.authkeys[i].key, SSH_KEY_CMP_PUBLIC)) {
+                username = server_opts.authkeys[i].username;
+                break;
+            }
+        }
     }
 
     /* UNLOCK */
-    pthread_mutex_unlock(&server_opts.authkey_lock);
+    pthread_rwlock_unlock(&server_opts.authkey_lock);
 
+    ssh_clean_pubkey_hash(&hash);
     return username;
 }
 
@@ -1284,6 +1732,7 @@ nc_ssh_bind_add_hostkeys(ssh_bind sbind, const char **hostkeys, uint8_t hostkey_
     uint8_t i;
     char *privkey_path, *privkey_data;
     int privkey_data_rsa, ret;
+    ssh_key key;
 
     if (!server_opts.hostkey_clb) {
         ERR("Callback for retrieving SSH host keys not set.");
@@ -1297,26 +1746,29 @@ nc_ssh_bind_add_hostkeys(ssh_bind sbind, const char **hostkeys, uint8_t hostkey_
             return -1;
         }
 
+        key = NULL;
         if (privkey_data) {
-            privkey_path = base64der_key_to_tmp_file(privkey_data, privkey_data_rsa);
-            if (!privkey_path) {
-                ERR("Temporarily storing a host key into a file failed (%s).", strerror(errno));
-                free(privkey_data);
-                return -1;
+            key = base64der_key_import(privkey_data, privkey_data_rsa);
+        } else if (privkey_path) {
+            if (ssh_pki_import_privkey_file(privkey_path, NULL, NULL, NULL, &key) != SSH_OK) {
+                key = NULL;
             }
         }
 
-        ret = ssh_bind_options_set(sbind, SSH_BIND_OPTIONS_HOSTKEY, privkey_path);
-
         /* cleanup */
-        if (privkey_data && unlink(privkey_path)) {
-            WRN("Removing a temporary host key file \"%s\" failed (%s).", privkey_path, strerror(errno));
-        }
         free(privkey_path);
         free(privkey_data);
 
+        if (!key) {
+            ERR("Failed to import hostkey \"%s\".", hostkeys[i]);
+            return -1;
+        }
+
+        /* the bind takes over the key */
+        ret = ssh_bind_options_set(sbind, SSH_BIND_OPTIONS_IMPORT_KEY, key);
         if (ret != SSH_OK) {
             ERR("Failed to set hostkey \"%s\" (%s).", hostkeys[i], ssh_get_error(sbind));
+            ssh_key_free(key);
             return -1;
         }
     }
@@ -1324,10 +1776,33 @@ nc_ssh_bind_add_hostkeys(ssh_bind sbind, const char **hostkeys, uint8_t hostkey_
     return 0;
 }
 
+/* sbind_lock is expected to be held */
+static int
+nc_ssh_bind_create(struct nc_server_ssh_opts *opts)
+{
+    ssh_bind sbind;
+
+    sbind = ssh_bind_new();
+    if (!sbind) {
+        ERR("Failed to create an SSH bind.");
+        return -1;
+    }
+
+    if (nc_ssh_bind_add_hostkeys(sbind, opts->hostkeys, opts->hostkey_count)) {
+        ssh_bind_free(sbind);
+        return -1;
+    }
+    if (opts->banner) {
+        ssh_bind_options_set(sbind, SSH_BIND_OPTIONS_BANNER, opts->banner);
+    }
+
+    opts->sbind = sbind;
+    return 0;
+}
+
 int
 nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
 {
-    ssh_bind sbind;
     struct nc_server_ssh_opts *opts;
     int libssh_auth_methods = 0, ret;
     struct timespec ts_timeout, ts_cur;
@@ -1354,33 +1829,31 @@ nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
     }
     ssh_set_auth_methods(session->ti.libssh.session, libssh_auth_methods);
 
-    sbind = ssh_bind_new();
-    if (!sbind) {
-        ERR("Failed to create an SSH bind.");
-        close(sock);
-        return -1;
-    }
+    ssh_set_message_callback(session->ti.libssh.session, nc_sshcb_msg, session);
+    /* remember that this session was just set as nc_sshcb_msg() parameter */
+    session->flags |= NC_SESSION_SSH_MSG_CB;
 
-    if (nc_ssh_bind_add_hostkeys(sbind, opts->hostkeys, opts->hostkey_count)) {
+    /* SBIND LOCK */
+    pthread_mutex_lock(&server_opts.sbind_lock);
+
+    /* load the host keys only once, the bind is reused for all the following connections */
+    if (!opts->sbind && nc_ssh_bind_create(opts)) {
+        /* SBIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.sbind_lock);
         close(sock);
-        ssh_bind_free(sbind);
         return -1;
     }
-    if (opts->banner) {
-        ssh_bind_options_set(sbind, SSH_BIND_OPTIONS_BANNER, opts->banner);
-    }
 
-    ssh_set_message_callback(session->ti.libssh.session, nc_sshcb_msg, session);
-    /* remember that this session was just set as nc_sshcb_msg() parameter */
-    session->flags |= NC_SESSION_SSH_MSG_CB;
-
-    if (ssh_bind_accept_fd(sbind, session->ti.libssh.session, sock) == SSH_ERROR) {
-        ERR("SSH failed to accept a new connection (%s).", ssh_get_error(sbind));
+    if (ssh_bind_accept_fd(opts->sbind, session->ti.libssh.session, sock) == SSH_ERROR) {
+        ERR("SSH failed to accept a new connection (%s).", ssh_get_error(opts->sbind));
+        /* SBIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.sbind_lock);
         close(sock);
-        ssh_bind_free(sbind);
         return -1;
     }
-    ssh_bind_free(sbind);
+
+    /* SBIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.sbind_lock);
 
     ssh_set_blocking(session->ti.libssh.session, 0);
 
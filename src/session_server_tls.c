@@ -68,22 +68,6 @@ asn1time_to_str(const ASN1_TIME *t)
     return cp;
 }
 
-static void
-digest_to_str(const unsigned char *digest, unsigned int dig_len, char **str)
-{
-    unsigned int i;
-
-    *str = malloc(dig_len * 3);
-    if (!*str) {
-        ERRMEM;
-        return;
-    }
-    for (i = 0; i < dig_len - 1; ++i) {
-        sprintf((*str) + (i * 3), "%02x:", digest[i]);
-    }
-    sprintf((*str) + (i * 3), "%02x", digest[i]);
-}
-
 /* return NULL - SSL error can be retrieved */
 static X509 *
 base64der_to_cert(const char *in)
@@ -303,179 +287,238 @@ nc_tls_ctn_get_username_from_cert(X509 *client_cert, NC_TLS_CTN_MAPTYPE map_type
     return 0;
 }
 
-/* return: 0 - OK, 1 - no match, -1 - error */
+static const EVP_MD *
+nc_tls_ctn_alg_md(uint8_t fp_alg, const char **alg_name)
+{
+    switch (fp_alg) {
+    case 1:
+        *alg_name = "MD5";
+        return EVP_md5();
+    case 2:
+        *alg_name = "SHA-1";
+        return EVP_sha1();
+    case 3:
+        *alg_name = "SHA-224";
+        return EVP_sha224();
+    case 4:
+        *alg_name = "SHA-256";
+        return EVP_sha256();
+    case 5:
+        *alg_name = "SHA-384";
+        return EVP_sha384();
+    case 6:
+        *alg_name = "SHA-512";
+        return EVP_sha512();
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
 static int
-nc_tls_cert_to_name(struct nc_ctn *ctn_first, X509 *cert, NC_TLS_CTN_MAPTYPE *map_type, const char **name)
+hex_to_val(char c)
 {
-    char *digest_md5 = NULL, *digest_sha1 = NULL, *digest_sha224 = NULL;
-    char *digest_sha256 = NULL, *digest_sha384 = NULL, *digest_sha512 = NULL;
-    unsigned char *buf = malloc(64);
-    unsigned int buf_len = 64;
-    int ret = 0;
-    struct nc_ctn *ctn;
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    } else if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    } else if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
 
-    if (!buf) {
-        ERRMEM;
-        return -1;
+/* fingerprint "XX:YY:YY:...", XX being the algorithm, YY the digest, to binary */
+static void
+nc_tls_ctn_parse_fingerprint(struct nc_ctn *ctn)
+{
+    const char *ptr;
+    const char *alg_name;
+    int hi, lo, alg = 0, len = -1;
+
+    ctn->fp_alg = 0;
+    ctn->fp_len = 0;
+
+    ptr = ctn->fingerprint;
+    while (1) {
+        if (((hi = hex_to_val(ptr[0])) < 0) || ((lo = hex_to_val(ptr[1])) < 0)) {
+            goto invalid;
+        }
+
+        if (len == -1) {
+            alg = (hi << 4) | lo;
+        } else if (len < EVP_MAX_MD_SIZE) {
+            ctn->fp[len] = (hi << 4) | lo;
+        } else {
+            goto invalid;
+        }
+        ++len;
+
+        ptr += 2;
+        if (!ptr[0]) {
+            break;
+        } else if (ptr[0] != ':') {
+            goto invalid;
+        }
+        ++ptr;
     }
 
-    if (!ctn_first || !cert || !map_type || !name) {
-        free(buf);
-        return -1;
+    if ((len < 1) || !nc_tls_ctn_alg_md(alg, &alg_name)) {
+        goto invalid;
     }
 
-    for (ctn = ctn_first; ctn; ctn = ctn->next) {
-        /* first make sure the entry is valid */
-        if (!ctn->fingerprint || !ctn->map_type || ((ctn->map_type == NC_TLS_CTN_SPECIFIED) && !ctn->name)) {
-            VRB("Cert verify CTN: entry with id %u not valid, skipping.", ctn->id);
-            continue;
+    ctn->fp_alg = alg;
+    ctn->fp_len = len;
+    return;
+
+invalid:
+    WRN("Unknown fingerprint algorithm or invalid fingerprint used (%s), it will never match.", ctn->fingerprint);
+}
+
+static uint32_t
+nc_tls_ctn_fp_bucket(const unsigned char *fp, uint8_t fp_len, uint32_t size)
+{
+    uint32_t hash = 0;
+    uint8_t i;
+
+    /* digest bytes are uniformly distributed */
+    for (i = 0; (i < fp_len) && (i < 4); ++i) {
+        hash = (hash << 8) | fp[i];
+    }
+    return hash & (size - 1);
+}
+
+static void
+nc_tls_ctn_idx_del(struct nc_ctn *ctn, struct nc_server_tls_opts *opts)
+{
+    struct nc_ctn **iter;
+    uint8_t a;
+
+    if (!ctn->fp_alg) {
+        /* not indexed */
+        return;
+    }
+
+    a = ctn->fp_alg - 1;
+    for (iter = &opts->ctn_idx[a].buckets[nc_tls_ctn_fp_bucket(ctn->fp, ctn->fp_len, opts->ctn_idx[a].size)];
+            *iter; iter = &(*iter)->idx_next) {
+        if (*iter == ctn) {
+            *iter = ctn->idx_next;
+            ctn->idx_next = NULL;
+            --opts->ctn_idx[a].count;
+            break;
         }
+    }
 
-        /* MD5 */
-        if (!strncmp(ctn->fingerprint, "01", 2)) {
-            if (!digest_md5) {
-                if (X509_digest(cert, EVP_md5(), buf, &buf_len) != 1) {
-                    ERR("Calculating MD5 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_md5);
-            }
+    if (!opts->ctn_idx[a].count) {
+        free(opts->ctn_idx[a].buckets);
+        opts->ctn_idx[a].buckets = NULL;
+        opts->ctn_idx[a].size = 0;
+    }
+}
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_md5)) {
-                /* we got ourselves a winner! */
-                VRB("Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
-            }
+static int
+nc_tls_ctn_idx_add(struct nc_ctn *ctn, struct nc_server_tls_opts *opts)
+{
+    struct nc_ctn **buckets, *iter, *next;
+    uint32_t size, i, b;
+    uint8_t a;
 
-        /* SHA-1 */
-        } else if (!strncmp(ctn->fingerprint, "02", 2)) {
-            if (!digest_sha1) {
-                if (X509_digest(cert, EVP_sha1(), buf, &buf_len) != 1) {
-                    ERR("Calculating SHA-1 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha1);
-            }
+    if (!ctn->fp_alg) {
+        /* cannot match anything */
+        return 0;
+    }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha1)) {
-                /* we got ourselves a winner! */
-                VRB("Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
+    a = ctn->fp_alg - 1;
+    if (opts->ctn_idx[a].count + 1 > opts->ctn_idx[a].size) {
+        /* grow the index, keep the load factor at most 1 */
+        size = (opts->ctn_idx[a].size ? opts->ctn_idx[a].size << 1 : 16);
+        buckets = calloc(size, sizeof *buckets);
+        if (!buckets) {
+            ERRMEM;
+            /* not indexed */
+            ctn->fp_alg = 0;
+            return -1;
+        }
+        for (i = 0; i < opts->ctn_idx[a].size; ++i) {
+            for (iter = opts->ctn_idx[a].buckets[i]; iter; iter = next) {
+                next = iter->idx_next;
+                b = nc_tls_ctn_fp_bucket(iter->fp, iter->fp_len, size);
+                iter->idx_next = buckets[b];
+                buckets[b] = iter;
             }
+        }
+        free(opts->ctn_idx[a].buckets);
+        opts->ctn_idx[a].buckets = buckets;
+        opts->ctn_idx[a].size = size;
+    }
 
-        /* SHA-224 */
-        } else if (!strncmp(ctn->fingerprint, "03", 2)) {
-            if (!digest_sha224) {
-                if (X509_digest(cert, EVP_sha224(), buf, &buf_len) != 1) {
-                    ERR("Calculating SHA-224 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha224);
-            }
+    b = nc_tls_ctn_fp_bucket(ctn->fp, ctn->fp_len, opts->ctn_idx[a].size);
+    ctn->idx_next = opts->ctn_idx[a].buckets[b];
+    opts->ctn_idx[a].buckets[b] = ctn;
+    ++opts->ctn_idx[a].count;
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha224)) {
-                /* we got ourselves a winner! */
-                VRB("Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
-            }
+    return 0;
+}
 
-        /* SHA-256 */
-        } else if (!strncmp(ctn->fingerprint, "04", 2)) {
-            if (!digest_sha256) {
-                if (X509_digest(cert, EVP_sha256(), buf, &buf_len) != 1) {
-                    ERR("Calculating SHA-256 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha256);
-            }
+/* return: 0 - OK, 1 - no match, -1 - error */
+static int
+nc_tls_cert_to_name(struct nc_server_tls_opts *opts, X509 *cert, NC_TLS_CTN_MAPTYPE *map_type, const char **name)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int dig_len;
+    const EVP_MD *md;
+    const char *alg_name;
+    struct nc_ctn *ctn, *match = NULL;
+    uint8_t a;
+
+    if (!opts || !cert || !map_type || !name) {
+        return -1;
+    }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha256)) {
-                /* we got ourselves a winner! */
-                VRB("Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
-            }
+    /* only the algorithms actually used are computed, the entry with the lowest id wins (as in a sequential search) */
+    for (a = 0; a < NC_TLS_CTN_FP_ALG_COUNT; ++a) {
+        if (!opts->ctn_idx[a].count) {
+            continue;
+        }
 
-        /* SHA-384 */
-        } else if (!strncmp(ctn->fingerprint, "05", 2)) {
-            if (!digest_sha384) {
-                if (X509_digest(cert, EVP_sha384(), buf, &buf_len) != 1) {
-                    ERR("Calculating SHA-384 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha384);
-            }
+        md = nc_tls_ctn_alg_md(a + 1, &alg_name);
+        if (X509_digest(cert, md, digest, &dig_len) != 1) {
+            ERR("Calculating %s digest failed (%s).", alg_name, ERR_reason_error_string(ERR_get_error()));
+            return -1;
+        }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha384)) {
-                /* we got ourselves a winner! */
-                VRB("Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
+        for (ctn = opts->ctn_idx[a].buckets[nc_tls_ctn_fp_bucket(digest, dig_len, opts->ctn_idx[a].size)]; ctn;
+                ctn = ctn->idx_next) {
+            if ((ctn->fp_len != dig_len) || memcmp(ctn->fp, digest, dig_len)) {
+                continue;
             }
-
-        /* SHA-512 */
-        } else if (!strncmp(ctn->fingerprint, "06", 2)) {
-            if (!digest_sha512) {
-                if (X509_digest(cert, EVP_sha512(), buf, &buf_len) != 1) {
-                    ERR("Calculating SHA-512 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha512);
+            if (match && (match->id < ctn->id)) {
+                continue;
             }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha512)) {
-                /* we got ourselves a winner! */
-                VRB("Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
+            /* make sure the entry is valid */
+            if (!ctn->map_type || ((ctn->map_type == NC_TLS_CTN_SPECIFIED) && !ctn->name)) {
+                VRB("Cert verify CTN: entry with id %u not valid, skipping.", ctn->id);
+                continue;
             }
 
-        /* unknown */
-        } else {
-            WRN("Unknown fingerprint algorithm used (%s), skipping.", ctn->fingerprint);
+            match = ctn;
         }
     }
 
-    if (!ctn) {
-        ret = 1;
+    if (!match) {
+        return 1;
     }
 
-cleanup:
-    free(digest_md5);
-    free(digest_sha1);
-    free(digest_sha224);
-    free(digest_sha256);
-    free(digest_sha384);
-    free(digest_sha512);
-    free(buf);
-    return ret;
+    /* we got ourselves a winner! */
+    VRB("Cert verify CTN: entry with a matching fingerprint found.");
+    *map_type = match->map_type;
+    if (match->map_type == NC_TLS_CTN_SPECIFIED) {
+        *name = match->name;
+    }
+    return 0;
 }
 
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L // >= 1.1.0
@@ -494,8 +537,8 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
     EVP_PKEY *pubkey;
     struct nc_session* session;
     struct nc_server_tls_opts *opts;
-    const ASN1_INTEGER *serial;
-    int i, n, rc, depth;
+    long serial;
+    int i, rc, depth;
     char *cp;
     const char *username = NULL;
     NC_TLS_CTN_MAPTYPE map_type = 0;
@@ -620,19 +663,15 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
         X509_STORE_CTX_free(store_ctx);
         crl = X509_OBJECT_get0_X509_CRL(obj);
         if (rc > 0 && crl) {
-            /* check if the current certificate is revoked by this CRL */
-            n = sk_X509_REVOKED_num(X509_CRL_get_REVOKED(crl));
-            for (i = 0; i < n; i++) {
-                revoked = sk_X509_REVOKED_value(X509_CRL_get_REVOKED(crl), i);
-                serial = X509_REVOKED_get0_serialNumber(revoked);
-                if (ASN1_INTEGER_cmp(serial, X509_get_serialNumber(cert)) == 0) {
-                    cp = X509_NAME_oneline(issuer, NULL, 0);
-                    ERR("Cert verify CRL: certificate with serial %ld (0x%lX) revoked per CRL from issuer %s.", serial, serial, cp);
-                    OPENSSL_free(cp);
-                    X509_STORE_CTX_set_error(x509_ctx, X509_V_ERR_CERT_REVOKED);
-                    X509_OBJECT_free(obj);
-                    return 0;
-                }
+            /* check if the current certificate is revoked by this CRL (binary search in the sorted revoked entries) */
+            if (X509_CRL_get0_by_serial(crl, &revoked, X509_get_serialNumber(cert)) == 1) {
+                serial = ASN1_INTEGER_get(X509_REVOKED_get0_serialNumber(revoked));
+                cp = X509_NAME_oneline(issuer, NULL, 0);
+                ERR("Cert verify CRL: certificate with serial %ld (0x%lX) revoked per CRL from issuer %s.", serial, serial, cp);
+                OPENSSL_free(cp);
+                X509_STORE_CTX_set_error(x509_ctx, X509_V_ERR_CERT_REVOKED);
+                X509_OBJECT_free(obj);
+                return 0;
             }
             X509_OBJECT_free(obj);
         }
@@ -644,7 +683,7 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
     }
 
     /* cert-to-name */
-    rc = nc_tls_cert_to_name(opts->ctn, cert, &map_type, &username);
+    rc = nc_tls_cert_to_name(opts, cert, &map_type, &username);
 
     if (rc) {
         if (rc == -1) {
@@ -707,7 +746,7 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
     struct nc_session* session;
     struct nc_server_tls_opts *opts;
     long serial;
-    int i, n, rc, depth;
+    int i, rc, depth;
     char *cp;
     const char *username = NULL;
     NC_TLS_CTN_MAPTYPE map_type = 0;
@@ -832,19 +871,15 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
         X509_STORE_CTX_cleanup(&store_ctx);
         crl = obj.data.crl;
         if (rc > 0 && crl) {
-            /* check if the current certificate is revoked by this CRL */
-            n = sk_X509_REVOKED_num(X509_CRL_get_REVOKED(crl));
-            for (i = 0; i < n; i++) {
-                revoked = sk_X509_REVOKED_value(X509_CRL_get_REVOKED(crl), i);
-                if (ASN1_INTEGER_cmp(revoked->serialNumber, X509_get_serialNumber(cert)) == 0) {
-                    serial = ASN1_INTEGER_get(revoked->serialNumber);
-                    cp = X509_NAME_oneline(issuer, NULL, 0);
-                    ERR("Cert verify CRL: certificate with serial %ld (0x%lX) revoked per CRL from issuer %s.", serial, serial, cp);
-                    OPENSSL_free(cp);
-                    X509_STORE_CTX_set_error(x509_ctx, X509_V_ERR_CERT_REVOKED);
-                    X509_OBJECT_free_contents(&obj);
-                    return 0;
-                }
+            /* check if the current certificate is revoked by this CRL (binary search in the sorted revoked entries) */
+            if (X509_CRL_get0_by_serial(crl, &revoked, X509_get_serialNumber(cert)) == 1) {
+                serial = ASN1_INTEGER_get(revoked->serialNumber);
+                cp = X509_NAME_oneline(issuer, NULL, 0);
+                ERR("Cert verify CRL: certificate with serial %ld (0x%lX) revoked per CRL from issuer %s.", serial, serial, cp);
+                OPENSSL_free(cp);
+                X509_STORE_CTX_set_error(x509_ctx, X509_V_ERR_CERT_REVOKED);
+                X509_OBJECT_free_contents(&obj);
+                return 0;
             }
             X509_OBJECT_free_contents(&obj);
         }
@@ -856,7 +891,7 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
     }
 
     /* cert-to-name */
-    rc = nc_tls_cert_to_name(opts->ctn, cert, &map_type, &username);
+    rc = nc_tls_cert_to_name(opts, cert, &map_type, &username);
 
     if (rc) {
         if (rc == -1) {
@@ -1221,6 +1256,38 @@ nc_server_tls_ch_client_set_trusted_ca_paths(const char *client_name, const char
     return ret;
 }
 
+/* sort revoked entries of all the CRLs loaded in the store so that the revocation checks
+ * can search them right away, CRLs loaded later from a directory are sorted on their first use */
+static void
+nc_tls_crl_store_sort(X509_STORE *store)
+{
+    STACK_OF(X509_OBJECT) *objs;
+    X509_OBJECT *obj;
+    X509_CRL *crl;
+    int i;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L // >= 1.1.0
+    objs = X509_STORE_get0_objects(store);
+#else
+    objs = store->objs;
+#endif
+    for (i = 0; i < sk_X509_OBJECT_num(objs); ++i) {
+        obj = sk_X509_OBJECT_value(objs, i);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L // >= 1.1.0
+        if (X509_OBJECT_get_type(obj) != X509_LU_CRL) {
+            continue;
+        }
+        crl = X509_OBJECT_get0_X509_CRL(obj);
+#else
+        if (obj->type != X509_LU_CRL) {
+            continue;
+        }
+        crl = obj->data.crl;
+#endif
+        sk_X509_REVOKED_sort(X509_CRL_get_REVOKED(crl));
+    }
+}
+
 static int
 nc_server_tls_set_crl_paths(const char *crl_file, const char *crl_dir, struct nc_server_tls_opts *opts)
 {
@@ -1261,6 +1328,7 @@ nc_server_tls_set_crl_paths(const char *crl_file, const char *crl_dir, struct nc
         }
     }
 
+    nc_tls_crl_store_sort(opts->crl_store);
     return 0;
 
 fail:
@@ -1410,9 +1478,16 @@ nc_server_tls_add_ctn(uint32_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE m
     new->id = id;
     if (fingerprint) {
         if (new->fingerprint) {
+            nc_tls_ctn_idx_del(new, opts);
             lydict_remove(server_opts.ctx, new->fingerprint);
         }
         new->fingerprint = lydict_insert(server_opts.ctx, fingerprint, 0);
+
+        /* normalize it only once, here */
+        nc_tls_ctn_parse_fingerprint(new);
+        if (nc_tls_ctn_idx_add(new, opts)) {
+            return -1;
+        }
     }
     if (map_type) {
         new->map_type = map_type;
@@ -1483,8 +1558,14 @@ nc_server_tls_del_ctn(int64_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE ma
 {
     struct nc_ctn *ctn, *next, *prev;
     int ret = -1;
+    uint8_t i;
 
     if ((id < 0) && !fingerprint && !map_type && !name) {
+        for (i = 0; i < NC_TLS_CTN_FP_ALG_COUNT; ++i) {
+            free(opts->ctn_idx[i].buckets);
+        }
+        memset(opts->ctn_idx, 0, sizeof opts->ctn_idx);
+
         ctn = opts->ctn;
         while (ctn) {
             lydict_remove(server_opts.ctx, ctn->fingerprint);
@@ -1505,6 +1586,7 @@ nc_server_tls_del_ctn(int64_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE ma
                     && (!fingerprint || !strcmp(ctn->fingerprint, fingerprint))
                     && (!map_type || (ctn->map_type == map_type))
                     && (!name || (ctn->name && !strcmp(ctn->name, name)))) {
+                nc_tls_ctn_idx_del(ctn, opts);
                 lydict_remove(server_opts.ctx, ctn->fingerprint);
                 lydict_remove(server_opts.ctx, ctn->name);
 
@@ -14,11 +14,13 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
@@ -129,6 +131,9 @@ teardown_sessions(void **state)
     free(client_session->ti_lock);
     free(client_session->ti_cond);
     free((int *)client_session->ti_inuse);
+    free(client_session->opts.client.replies);
+    free(client_session->opts.client.dropped);
+    free(client_session->rd.msg);
     free(client_session);
 
     return 0;
@@ -312,6 +317,926 @@ test_send_recv_data_11(void **state)
     test_send_recv_data();
 }
 
+static void
+test_send_recv_pipelined(void)
+{
+    int ret, i;
+    uint32_t reply_count;
+    uint64_t msgid[3];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc[3];
+    struct nc_reply *reply;
+    struct nc_pollsession *ps;
+
+    /* client RPCs, all sent before receiving any reply */
+    rpc[0] = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc[0]);
+    rpc[1] = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc[1]);
+    rpc[2] = nc_rpc_kill(1);
+    assert_non_null(rpc[2]);
+
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_send_rpc(client_session, rpc[i], 0, &msgid[i]);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+    }
+
+    /* server RPCs, send replies */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC | NC_PSPOLL_REPLY_ERROR);
+
+    /* server finished */
+    nc_ps_free(ps);
+
+    /* client replies in reverse order, the preceding ones are stored */
+    msgtype = nc_recv_reply(client_session, rpc[2], msgid[2], 1000, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_ERROR);
+    nc_reply_free(reply);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, &reply_count, NULL, NULL, NULL, NULL, NULL), 0);
+    assert_int_equal(reply_count, 2);
+
+    msgtype = nc_recv_reply(client_session, rpc[0], msgid[0], 0, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_OK);
+    nc_reply_free(reply);
+
+    msgtype = nc_recv_reply(client_session, rpc[1], msgid[1], 0, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_DATA);
+    nc_reply_free(reply);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, &reply_count, NULL, NULL, NULL, NULL, NULL), 0);
+    assert_int_equal(reply_count, 0);
+
+    for (i = 0; i < 3; ++i) {
+        nc_rpc_free(rpc[i]);
+    }
+}
+
+static void
+test_send_recv_pipelined_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_send_recv_pipelined();
+}
+
+static void
+test_send_recv_pipelined_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_send_recv_pipelined();
+}
+
+static void
+test_send_recv_prepared(void)
+{
+    int ret, i;
+    uint64_t msgid[2];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_rpc_prepared *prep;
+    struct nc_reply *reply;
+    struct nc_pollsession *ps;
+
+    /* client RPC, serialized once */
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+
+    prep = nc_rpc_prepare(client_session, rpc);
+    assert_non_null(prep);
+
+    /* the module cache is filled only with the context, never when creating RPCs */
+    assert_null(client_session->opts.client.mods.ctx);
+
+    /* and sent twice, each time with a new message-id */
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_send_rpc_prepared(client_session, prep, 0, &msgid[i]);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+    }
+    assert_int_not_equal(msgid[0], msgid[1]);
+
+    /* server RPCs, send replies */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    for (i = 0; i < 2; ++i) {
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_int_equal(ret, NC_PSPOLL_RPC);
+    }
+
+    /* server finished */
+    nc_ps_free(ps);
+
+    /* client replies */
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_recv_reply(client_session, rpc, msgid[i], 0, 0, &reply);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_int_equal(reply->type, NC_RPL_DATA);
+        nc_reply_free(reply);
+    }
+
+    nc_rpc_prepared_free(prep);
+    nc_rpc_free(rpc);
+}
+
+static void
+test_send_recv_prepared_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_send_recv_prepared();
+}
+
+static void
+test_send_recv_prepared_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_send_recv_prepared();
+}
+
+static void
+test_reply_queue_limit(void **state)
+{
+    (void)state;
+    int ret, i;
+    uint32_t reply_count, reply_dropped;
+    uint64_t msgid[3];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_reply *reply;
+    struct nc_pollsession *ps;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* only one reply can be stored */
+    nc_client_set_reply_queue_limits(1, 0);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_send_rpc(client_session, rpc, 0, &msgid[i]);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+    }
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    for (i = 0; i < 3; ++i) {
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_int_equal(ret, NC_PSPOLL_RPC);
+    }
+
+    nc_ps_free(ps);
+
+    /* the first reply is stored, the second one dropped */
+    msgtype = nc_recv_reply(client_session, rpc, msgid[2], 1000, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_reply_free(reply);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, &reply_count, NULL, &reply_dropped, NULL, NULL, NULL), 0);
+    assert_int_equal(reply_count, 1);
+    assert_int_equal(reply_dropped, 1);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid[0], 0, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_OK);
+    nc_reply_free(reply);
+
+    /* the dropped reply is an error, only once */
+    msgtype = nc_recv_reply(client_session, rpc, msgid[1], 0, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_ERROR);
+    msgtype = nc_recv_reply(client_session, rpc, msgid[1], 0, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_WOULDBLOCK);
+
+    nc_rpc_free(rpc);
+    nc_client_set_reply_queue_limits(NC_CLIENT_REPLY_QUEUE_MAX, 0);
+}
+
+#define TEST_NOTIF_MODULE "module test-reactor {namespace \"urn:test:reactor\"; prefix tr;" \
+                          "notification event {leaf value {type string;}}}"
+
+#define TEST_NOTIF "<notification xmlns=\"urn:ietf:params:xml:ns:netconf:notification:1.0\">" \
+                   "<eventTime>2026-01-01T00:00:00Z</eventTime>" \
+                   "<event xmlns=\"urn:test:reactor\"><value>1</value></event></notification>"
+
+#define TEST_NOTIF_COMPLETE "<notification xmlns=\"urn:ietf:params:xml:ns:netconf:notification:1.0\">" \
+                            "<eventTime>2026-01-01T00:00:01Z</eventTime>" \
+                            "<notificationComplete xmlns=\"urn:ietf:params:xml:ns:netmod:notification\"/></notification>"
+
+/* frame a message as the server session would */
+static int
+frame_msg(char *buf, size_t size, const char *msg)
+{
+    if (server_session->version == NC_VERSION_10) {
+        return snprintf(buf, size, "%s%s", msg, NC_VERSION_10_ENDTAG);
+    }
+    return snprintf(buf, size, "\n#%zu\n%s\n##\n", strlen(msg), msg);
+}
+
+static void
+server_write_msg(const char *msg)
+{
+    char buf[1024];
+    int len;
+
+    len = frame_msg(buf, sizeof buf, msg);
+    assert_int_equal(write(server_session->ti.fd.out, buf, len), len);
+}
+
+static void
+test_recv_notif_raw(void)
+{
+    NC_MSG_TYPE msgtype;
+    struct nc_notif_raw *notif_raw;
+    struct nc_notif *notif;
+
+    server_write_msg(TEST_NOTIF);
+
+    /* found without building an XML tree */
+    msgtype = nc_recv_notif_raw(client_session, 1000, &notif_raw);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+    assert_string_equal(notif_raw->datetime, "2026-01-01T00:00:00Z");
+    assert_string_equal(notif_raw->name, "event");
+    assert_string_equal(notif_raw->ns, "urn:test:reactor");
+    assert_int_equal(notif_raw->xml_len, strlen(TEST_NOTIF));
+    assert_memory_equal(notif_raw->xml, TEST_NOTIF, notif_raw->xml_len);
+
+    /* and still parsed the same way as a normal one */
+    notif = nc_notif_raw_parse(client_session, notif_raw);
+    assert_non_null(notif);
+    assert_string_equal(notif->datetime, "2026-01-01T00:00:00Z");
+    assert_string_equal(notif->tree->schema->name, "event");
+    nc_notif_free(notif);
+
+    nc_notif_raw_free(notif_raw);
+
+    msgtype = nc_recv_notif_raw(client_session, 0, &notif_raw);
+    assert_int_equal(msgtype, NC_MSG_WOULDBLOCK);
+}
+
+static void
+test_recv_notif_raw_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_recv_notif_raw();
+}
+
+static void
+test_recv_notif_raw_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_recv_notif_raw();
+}
+
+static volatile int raw_dispatched;
+
+static void
+my_notif_raw_clb(struct nc_session *session, const struct nc_notif_raw *notif)
+{
+    /* no asserts, called from the notification thread */
+    if ((session == client_session) && !strcmp(notif->name, "event")) {
+        ++raw_dispatched;
+    }
+}
+
+static void
+test_recv_notif_dispatch_raw(void **state)
+{
+    (void)state;
+    int i;
+    pthread_t *tid;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    raw_dispatched = 0;
+
+    /* both notifications and the end of the stream are read in one go */
+    server_write_msg(TEST_NOTIF);
+    server_write_msg(TEST_NOTIF);
+    server_write_msg(TEST_NOTIF_COMPLETE);
+
+    assert_int_equal(nc_recv_notif_dispatch_raw(client_session, my_notif_raw_clb), 0);
+    tid = (pthread_t *)client_session->opts.client.ntf_tid;
+    assert_non_null(tid);
+
+    /* the thread exits after <notificationComplete> */
+    for (i = 0; (i < 100) && client_session->opts.client.ntf_tid; ++i) {
+        usleep(10000);
+    }
+    assert_null(client_session->opts.client.ntf_tid);
+    pthread_join(*tid, NULL);
+    free(tid);
+
+    assert_int_equal(raw_dispatched, 2);
+}
+
+#ifdef HAVE_EPOLL
+
+struct async_reply {
+    int called;
+    NC_MSG_TYPE msgtype;
+    NC_RPL type;
+};
+
+/* also incremented by the reactor threads */
+static volatile int notif_dispatched;
+
+static void
+my_reply_clb(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype, struct nc_reply *reply, void *user_data)
+{
+    struct async_reply *res = (struct async_reply *)user_data;
+
+    (void)msgid;
+    assert_ptr_equal(session, client_session);
+
+    ++res->called;
+    res->msgtype = msgtype;
+    res->type = (reply ? reply->type : 0);
+}
+
+static void
+my_notif_clb(struct nc_session *session, const struct nc_notif *notif)
+{
+    /* no asserts, may be called from a reactor thread */
+    if ((session == client_session) && notif->tree && !strcmp(notif->tree->schema->name, "event")) {
+        ++notif_dispatched;
+    }
+}
+
+static void
+test_reactor_reply(void)
+{
+    int ret;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_pollsession *ps;
+    struct nc_client_reactor *reactor;
+    struct async_reply res = {0};
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, NULL), 0);
+
+    /* client RPC */
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc_async(client_session, rpc, 0, my_reply_clb, &res, NULL);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* nothing to dispatch yet */
+    assert_int_equal(nc_client_reactor_process(reactor, 0), 0);
+    assert_int_equal(res.called, 0);
+
+    /* server RPC, send reply */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    nc_ps_free(ps);
+
+    /* client reply dispatched by the reactor */
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 1);
+    assert_int_equal(res.called, 1);
+    assert_int_equal(res.msgtype, NC_MSG_REPLY);
+    assert_int_equal(res.type, NC_RPL_DATA);
+
+    nc_client_reactor_free(reactor);
+    nc_rpc_free(rpc);
+}
+
+static void
+test_reactor_reply_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_reactor_reply();
+}
+
+static void
+test_reactor_reply_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_reactor_reply();
+}
+
+static void
+test_reactor_partial(void)
+{
+    char reply[256], buf[512];
+    int len;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_client_reactor *reactor;
+    struct async_reply res = {0};
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, NULL), 0);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc_async(client_session, rpc, 0, my_reply_clb, &res, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    sprintf(reply, "<rpc-reply xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\" message-id=\"%"PRIu64"\"><ok/></rpc-reply>",
+            msgid);
+    len = frame_msg(buf, sizeof buf, reply);
+
+    /* only a part of the reply arrives, the reactor must not wait for the rest */
+    assert_int_equal(write(server_session->ti.fd.out, buf, len / 2), len / 2);
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 0);
+    assert_int_equal(res.called, 0);
+
+    /* the rest of it */
+    assert_int_equal(write(server_session->ti.fd.out, buf + len / 2, len - len / 2), len - len / 2);
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 1);
+    assert_int_equal(res.called, 1);
+    assert_int_equal(res.msgtype, NC_MSG_REPLY);
+    assert_int_equal(res.type, NC_RPL_OK);
+
+    nc_client_reactor_free(reactor);
+    nc_rpc_free(rpc);
+}
+
+static void
+test_reactor_partial_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_reactor_partial();
+}
+
+static void
+test_reactor_partial_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_reactor_partial();
+}
+
+static void
+test_reactor_session_busy(void **state)
+{
+    (void)state;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_client_reactor *reactor;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    notif_dispatched = 0;
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, my_notif_clb), 0);
+
+    server_write_msg(TEST_NOTIF);
+
+    /* the session is used by another thread, the reactor must not wait for it */
+    *client_session->ti_inuse = 1;
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 0);
+    assert_int_equal(nc_client_reactor_process(reactor, 0), 0);
+    assert_int_equal(notif_dispatched, 0);
+    *client_session->ti_inuse = 0;
+
+    /* unlocking the session after sending an RPC re-enables it in the reactor */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 1);
+    assert_int_equal(notif_dispatched, 1);
+
+    nc_client_reactor_free(reactor);
+    nc_rpc_free(rpc);
+}
+
+static void
+test_reactor_queued_notif(void **state)
+{
+    (void)state;
+    int ret;
+    uint32_t notif_count;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_reply *reply;
+    struct nc_pollsession *ps;
+    struct nc_client_reactor *reactor;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    notif_dispatched = 0;
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, my_notif_clb), 0);
+
+    /* client RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server notification, then the reply */
+    server_write_msg(TEST_NOTIF);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    nc_ps_free(ps);
+
+    /* the notification is read while waiting for the reply and queued */
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_OK);
+    nc_reply_free(reply);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, NULL, NULL, NULL, &notif_count, NULL, NULL), 0);
+    assert_int_equal(notif_count, 1);
+    assert_int_equal(notif_dispatched, 0);
+
+    /* and dispatched by the reactor */
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 1);
+    assert_int_equal(notif_dispatched, 1);
+
+    nc_client_reactor_free(reactor);
+    nc_rpc_free(rpc);
+}
+
+static void
+test_notif_queue_limit(void **state)
+{
+    (void)state;
+    int ret, i;
+    uint32_t notif_count, notif_dropped;
+    size_t notif_size;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_reply *reply;
+    struct nc_pollsession *ps;
+    struct nc_client_reactor *reactor;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    notif_dispatched = 0;
+    nc_client_set_notif_queue_limits(2, 0);
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, my_notif_clb), 0);
+
+    /* client RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server notifications, then the reply */
+    for (i = 0; i < 3; ++i) {
+        server_write_msg(TEST_NOTIF);
+    }
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    nc_ps_free(ps);
+
+    /* the notifications are read while waiting for the reply, the last one does not fit the queue */
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, 0, &reply);
+        assert_int_equal(msgtype, NC_MSG_NOTIF);
+    }
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_OK);
+    nc_reply_free(reply);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, NULL, NULL, NULL, &notif_count, &notif_size,
+                                                &notif_dropped), 0);
+    assert_int_equal(notif_count, 2);
+    assert_true(notif_size > 0);
+    assert_int_equal(notif_dropped, 1);
+
+    /* only the queued ones are dispatched */
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 2);
+    assert_int_equal(notif_dispatched, 2);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, NULL, NULL, NULL, &notif_count, &notif_size,
+                                                &notif_dropped), 0);
+    assert_int_equal(notif_count, 0);
+    assert_int_equal(notif_size, 0);
+    assert_int_equal(notif_dropped, 1);
+
+    nc_client_reactor_free(reactor);
+    nc_rpc_free(rpc);
+    nc_client_set_notif_queue_limits(0, 0);
+}
+
+static void
+test_reactor_mixed(void **state)
+{
+    (void)state;
+    int ret;
+    uint32_t reply_count;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc, *async_rpc;
+    struct nc_reply *reply;
+    struct nc_pollsession *ps;
+    struct nc_client_reactor *reactor;
+    struct async_reply res = {0};
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, NULL), 0);
+
+    /* asynchronous RPC first, then a synchronous one */
+    async_rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(async_rpc);
+    msgtype = nc_send_rpc_async(client_session, async_rpc, 0, my_reply_clb, &res, NULL);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server replies in order */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    nc_ps_free(ps);
+
+    /* the asynchronous reply is read first and passed to the reactor, not stored */
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, 0, &reply);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_int_equal(reply->type, NC_RPL_OK);
+    nc_reply_free(reply);
+
+    assert_int_equal(nc_session_get_queue_stats(client_session, &reply_count, NULL, NULL, NULL, NULL, NULL), 0);
+    assert_int_equal(reply_count, 0);
+    assert_int_equal(res.called, 0);
+
+    /* and dispatched by it */
+    assert_int_equal(nc_client_reactor_process(reactor, 1000), 1);
+    assert_int_equal(res.called, 1);
+    assert_int_equal(res.msgtype, NC_MSG_REPLY);
+    assert_int_equal(res.type, NC_RPL_DATA);
+
+    nc_client_reactor_free(reactor);
+    nc_rpc_free(rpc);
+    nc_rpc_free(async_rpc);
+}
+
+static void
+test_reactor_threads(void **state)
+{
+    (void)state;
+    int i;
+    struct nc_client_reactor *reactor;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    notif_dispatched = 0;
+
+    reactor = nc_client_reactor_new();
+    assert_non_null(reactor);
+    assert_int_equal(nc_client_reactor_add_session(reactor, client_session, my_notif_clb), 0);
+    assert_int_equal(nc_client_reactor_start_threads(reactor, 2), 0);
+
+    server_write_msg(TEST_NOTIF);
+    server_write_msg(TEST_NOTIF);
+
+    /* give the threads a second to dispatch both */
+    for (i = 0; (i < 100) && (notif_dispatched < 2); ++i) {
+        usleep(10000);
+    }
+
+    nc_client_reactor_stop_threads(reactor);
+    assert_int_equal(notif_dispatched, 2);
+
+    nc_client_reactor_free(reactor);
+}
+
+#endif /* HAVE_EPOLL */
+
+static void
+test_cpblt_index(void **state)
+{
+    (void)state;
+    int sock[2], len;
+    char buf[1024];
+    struct nc_session *session;
+    const char *hello = "<hello xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\"><capabilities>"
+                        "<capability>urn:ietf:params:netconf:base:1.0</capability>"
+                        "<capability>urn:ietf:params:netconf:capability:candidate:1.0</capability>"
+                        "<capability>urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=explicit</capability>"
+                        "<capability>urn:example:mod?module=mod&amp;revision=2020-01-01</capability>"
+                        "</capabilities><session-id>5</session-id></hello>";
+
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sock), 0);
+
+    /* server hello is waiting for the client */
+    len = sprintf(buf, "%s%s", hello, NC_VERSION_10_ENDTAG);
+    assert_int_equal(write(sock[0], buf, len), len);
+
+    session = nc_connect_inout(sock[1], sock[1], ctx);
+    assert_non_null(session);
+    assert_int_equal(nc_session_get_id(session), 5);
+
+    /* well-known capabilities */
+    assert_true(session->opts.client.cpblt_bits & NC_CPBLT_BASE_10);
+    assert_true(session->opts.client.cpblt_bits & NC_CPBLT_CANDIDATE);
+    assert_true(session->opts.client.cpblt_bits & NC_CPBLT_WITH_DEFAULTS);
+    assert_false(session->opts.client.cpblt_bits & NC_CPBLT_STARTUP);
+
+    /* whole URIs found in the index, with their parameters */
+    assert_string_equal(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:candidate:1.0"),
+                        "urn:ietf:params:netconf:capability:candidate:1.0");
+    assert_string_equal(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:with-defaults:1.0"),
+                        "urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=explicit");
+    assert_string_equal(nc_session_cpblt(session, "urn:example:mod"), "urn:example:mod?module=mod&revision=2020-01-01");
+
+    /* any other prefix, found by a binary search, the first one in the strcmp() order */
+    assert_string_equal(nc_session_cpblt(session, "urn:example:mod?module=mod"),
+                        "urn:example:mod?module=mod&revision=2020-01-01");
+    assert_string_equal(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:with"),
+                        "urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=explicit");
+    assert_string_equal(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:"),
+                        "urn:ietf:params:netconf:capability:candidate:1.0");
+
+    /* not supported, before, between and after the server capabilities */
+    assert_null(nc_session_cpblt(session, "urn:a"));
+    assert_null(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:startup:1.0"));
+    assert_null(nc_session_cpblt(session, "urn:example:mod2"));
+    assert_null(nc_session_cpblt(session, "urn:z"));
+
+    /* there is no server to close the session with */
+    session->status = NC_STATUS_INVALID;
+    nc_session_free(session, NULL);
+    close(sock[0]);
+    close(sock[1]);
+}
+
+/* client session connected to a server hello with the capabilities and its own context */
+static struct nc_session *
+connect_hello(const char *cpblts, int sock[2])
+{
+    char buf[1024];
+    int len;
+    struct nc_session *session;
+
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sock), 0);
+
+    len = sprintf(buf, "<hello xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\"><capabilities>%s</capabilities>"
+                  "<session-id>5</session-id></hello>%s", cpblts, NC_VERSION_10_ENDTAG);
+    assert_int_equal(write(sock[0], buf, len), len);
+
+    session = nc_connect_inout(sock[1], sock[1], NULL);
+    assert_non_null(session);
+    return session;
+}
+
+static void
+free_hello(struct nc_session *session, int sock[2])
+{
+    /* there is no server to close the session with */
+    session->status = NC_STATUS_INVALID;
+    nc_session_free(session, NULL);
+    close(sock[0]);
+    close(sock[1]);
+}
+
+static void
+test_ctx_pool(void **state)
+{
+    (void)state;
+    int sock[4][2];
+    struct nc_session *session[4];
+    const char *cpblts1 = "<capability>urn:ietf:params:netconf:base:1.0</capability>";
+    const char *cpblts2 = "<capability>urn:ietf:params:netconf:base:1.0</capability>"
+                          "<capability>urn:ietf:params:netconf:capability:candidate:1.0</capability>";
+
+    nc_client_set_ctx_pool(1);
+
+    /* miss, the new context is added to the pool */
+    session[0] = connect_hello(cpblts1, sock[0]);
+    assert_true(session[0]->flags & NC_SESSION_CLIENT_POOLCTX);
+
+    /* hit */
+    session[1] = connect_hello(cpblts1, sock[1]);
+    assert_true(session[1]->flags & NC_SESSION_CLIENT_POOLCTX);
+    assert_ptr_equal(session[1]->ctx, session[0]->ctx);
+
+    /* miss, other capabilities */
+    session[2] = connect_hello(cpblts2, sock[2]);
+    assert_true(session[2]->flags & NC_SESSION_CLIENT_POOLCTX);
+    assert_ptr_not_equal(session[2]->ctx, session[0]->ctx);
+
+    /* the context is released by the last session using it */
+    free_hello(session[0], sock[0]);
+    assert_non_null(ly_ctx_get_module(session[1]->ctx, "ietf-netconf", NULL));
+    free_hello(session[1], sock[1]);
+
+    /* so the same capabilities miss again and a new context is pooled */
+    session[0] = connect_hello(cpblts1, sock[0]);
+    assert_true(session[0]->flags & NC_SESSION_CLIENT_POOLCTX);
+    session[1] = connect_hello(cpblts1, sock[1]);
+    assert_ptr_equal(session[1]->ctx, session[0]->ctx);
+
+    /* not pooled when disabled */
+    nc_client_set_ctx_pool(0);
+    session[3] = connect_hello(cpblts1, sock[3]);
+    assert_false(session[3]->flags & NC_SESSION_CLIENT_POOLCTX);
+    assert_ptr_not_equal(session[3]->ctx, session[0]->ctx);
+
+    free_hello(session[3], sock[3]);
+    free_hello(session[2], sock[2]);
+    free_hello(session[1], sock[1]);
+    free_hello(session[0], sock[0]);
+}
+
 /* TODO
 static void
 test_send_recv_notif(void)
@@ -346,6 +1271,9 @@ main(void)
     assert_non_null(node);
     lys_set_private(node, my_getconfig_rpc_clb);
 
+    module = lys_parse_mem(ctx, TEST_NOTIF_MODULE, LYS_IN_YANG);
+    assert_non_null(module);
+
     nc_server_init(ctx);
 
     const struct CMUnitTest comm[] = {
@@ -354,7 +1282,28 @@ main(void)
         cmocka_unit_test_setup_teardown(test_send_recv_data_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_ok_11, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_error_11, setup_sessions, teardown_sessions),
-        cmocka_unit_test_setup_teardown(test_send_recv_data_11, setup_sessions, teardown_sessions)
+        cmocka_unit_test_setup_teardown(test_send_recv_data_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_pipelined_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_pipelined_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_prepared_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_prepared_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reply_queue_limit, setup_sessions, teardown_sessions),
+        cmocka_unit_test(test_cpblt_index),
+        cmocka_unit_test(test_ctx_pool),
+        cmocka_unit_test_setup_teardown(test_recv_notif_raw_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_recv_notif_raw_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_recv_notif_dispatch_raw, setup_sessions, teardown_sessions),
+#ifdef HAVE_EPOLL
+        cmocka_unit_test_setup_teardown(test_reactor_reply_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_reply_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_partial_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_partial_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_session_busy, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_queued_notif, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_notif_queue_limit, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_mixed, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_reactor_threads, setup_sessions, teardown_sessions),
+#endif
     };
 
     ret = cmocka_run_group_tests(comm, NULL, NULL);
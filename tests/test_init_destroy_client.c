@@ -22,9 +22,11 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 
 #include <cmocka.h>
 #include <libyang/libyang.h>
@@ -58,11 +60,143 @@ test_dummy(void **state)
     (void)state;
 }
 
+#ifdef NC_ENABLED_SSH
+
+struct connect_arg {
+    uint16_t port;
+    struct nc_session *session;
+};
+
+static void *
+connect_thread(void *arg)
+{
+    struct connect_arg *c = (struct connect_arg *)arg;
+
+    c->session = nc_connect_ssh("localhost", c->port, NULL);
+    return NULL;
+}
+
+static void
+test_connect_fallback(void **state)
+{
+    (void)state;
+    int lsock, sock;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof addr;
+    struct connect_arg c;
+    pthread_t tid;
+    time_t start;
+
+    /* listen on a free IPv4 loopback port */
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_int_not_equal(lsock, -1);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(lsock, (struct sockaddr *)&addr, sizeof addr), 0);
+    assert_int_equal(listen(lsock, 1), 0);
+    assert_int_equal(getsockname(lsock, (struct sockaddr *)&addr, &len), 0);
+    c.port = ntohs(addr.sin_port);
+    c.session = NULL;
+
+    /* "localhost" may resolve to ::1 first, where nobody listens, IPv4 must still be connected */
+    assert_int_equal(pthread_create(&tid, NULL, connect_thread, &c), 0);
+    sock = accept(lsock, NULL, NULL);
+    assert_int_not_equal(sock, -1);
+
+    /* there is no SSH server, so the session fails */
+    close(sock);
+    pthread_join(tid, NULL);
+    assert_null(c.session);
+
+    /* nobody listens anymore, all the attempts are refused right away */
+    close(lsock);
+    start = time(NULL);
+    assert_null(nc_connect_ssh("localhost", c.port, NULL));
+    assert_true(time(NULL) - start < 2);
+}
+
+struct bulk_result {
+    pthread_mutex_t lock;
+    int called[4];
+    int sessions;
+};
+
+static void
+bulk_clb(uint32_t idx, struct nc_session *session, void *user_data)
+{
+    struct bulk_result *res = (struct bulk_result *)user_data;
+
+    /* called from several threads at once */
+    pthread_mutex_lock(&res->lock);
+    if (idx < 4) {
+        ++res->called[idx];
+    }
+    if (session) {
+        ++res->sessions;
+        nc_session_free(session, NULL);
+    }
+    pthread_mutex_unlock(&res->lock);
+}
+
+static void
+test_connect_bulk(void **state)
+{
+    (void)state;
+    int lsock, i;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof addr;
+    struct nc_connect_target targets[4];
+    struct bulk_result res;
+
+    /* find a free IPv4 loopback port, nobody listens on it afterwards */
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_int_not_equal(lsock, -1);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(lsock, (struct sockaddr *)&addr, sizeof addr), 0);
+    assert_int_equal(getsockname(lsock, (struct sockaddr *)&addr, &len), 0);
+    close(lsock);
+
+    for (i = 0; i < 4; ++i) {
+        targets[i].ti = NC_TI_LIBSSH;
+        targets[i].host = "127.0.0.1";
+        targets[i].port = ntohs(addr.sin_port);
+    }
+    memset(&res, 0, sizeof res);
+    pthread_mutex_init(&res.lock, NULL);
+
+    assert_int_equal(nc_connect_bulk(targets, 4, NULL, 0, bulk_clb, &res), -1);
+
+    /* an excessive number of threads is limited, every target is still tried exactly once */
+    assert_int_equal(nc_connect_bulk(targets, 4, NULL, UINT16_MAX, bulk_clb, &res), 0);
+    for (i = 0; i < 4; ++i) {
+        assert_int_equal(res.called[i], 1);
+    }
+    assert_int_equal(res.sessions, 0);
+
+    /* and with fewer threads than targets */
+    memset(res.called, 0, sizeof res.called);
+    assert_int_equal(nc_connect_bulk(targets, 4, NULL, 2, bulk_clb, &res), 0);
+    for (i = 0; i < 4; ++i) {
+        assert_int_equal(res.called[i], 1);
+    }
+
+    pthread_mutex_destroy(&res.lock);
+}
+
+#endif /* NC_ENABLED_SSH */
+
 int
 main(void)
 {
     const struct CMUnitTest init_destroy[] = {
-        cmocka_unit_test_setup_teardown(test_dummy, setup_client, teardown_client)
+        cmocka_unit_test_setup_teardown(test_dummy, setup_client, teardown_client),
+#ifdef NC_ENABLED_SSH
+        cmocka_unit_test_setup_teardown(test_connect_fallback, setup_client, teardown_client),
+        cmocka_unit_test_setup_teardown(test_connect_bulk, setup_client, teardown_client),
+#endif
     };
 
     return cmocka_run_group_tests(init_destroy, NULL, NULL);
@@ -18,11 +18,13 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 
 #include <cmocka.h>
 #include <libyang/libyang.h>
@@ -169,13 +171,288 @@ test_write_rpc_11_bad(void **state)
     return test_write_rpc_bad(state);
 }
 
+/* BUFFERSIZE of io.c, the reply splitter gets the message in blocks of this size */
+#define SPLIT_BLOCK 512
+
+#define SPLIT_NS "urn:ietf:params:xml:ns:netconf:base:1.0"
+
+struct rd {
+    struct nc_session *session;
+    struct nc_rpc *rpc;
+    int out;                    /* the other end of the session socket */
+    char *frags[8];
+    int frag_count;
+    int fail;                   /* callback fails from this fragment on */
+};
+
+static int
+setup_read(void **state)
+{
+    int sock[2];
+    struct rd *r;
+
+    r = calloc(1, sizeof *r);
+    r->session = calloc(1, sizeof *r->session);
+    r->session->ctx = ly_ctx_new(TESTS_DIR"../schemas");
+    if (!r->session->ctx || !ly_ctx_load_module(r->session->ctx, "ietf-netconf-acm", NULL)
+            || socketpair(AF_UNIX, SOCK_STREAM, 0, sock)) {
+        return -1;
+    }
+    r->rpc = nc_rpc_get(NULL, 0, NC_PARAMTYPE_CONST);
+
+    r->session->status = NC_STATUS_RUNNING;
+    r->session->side = NC_CLIENT;
+    r->session->version = NC_VERSION_10;
+    r->session->ti_type = NC_TI_FD;
+    r->session->ti_lock = malloc(sizeof *r->session->ti_lock);
+    pthread_mutex_init(r->session->ti_lock, NULL);
+    r->session->ti_cond = malloc(sizeof *r->session->ti_cond);
+    pthread_cond_init(r->session->ti_cond, NULL);
+    r->session->ti_inuse = malloc(sizeof *r->session->ti_inuse);
+    *r->session->ti_inuse = 0;
+    r->session->ti.fd.in = sock[0];
+    r->session->ti.fd.out = sock[0];
+    /* the test subtrees are not in the context */
+    r->session->flags = NC_SESSION_CLIENT_NOT_STRICT;
+    r->session->opts.client.msgid = 1;
+    r->out = sock[1];
+    r->fail = -1;
+
+    *state = r;
+    return 0;
+}
+
+static int
+teardown_read(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    int i;
+
+    for (i = 0; i < r->frag_count; ++i) {
+        free(r->frags[i]);
+    }
+    nc_rpc_free(r->rpc);
+    close(r->out);
+    close(r->session->ti.fd.in);
+    ly_ctx_destroy(r->session->ctx, NULL);
+    pthread_mutex_destroy(r->session->ti_lock);
+    pthread_cond_destroy(r->session->ti_cond);
+    free(r->session->ti_lock);
+    free(r->session->ti_cond);
+    free((int *)r->session->ti_inuse);
+    free(r->session);
+    free(r);
+    *state = NULL;
+
+    return 0;
+}
+
+static int
+split_clb(struct nc_session *session, const struct lyd_node *subtree, const char *xml, void *arg)
+{
+    struct rd *r = (struct rd *)arg;
+
+    (void)subtree;
+    assert_ptr_equal(session, r->session);
+    assert_true(r->frag_count < 8);
+    r->frags[r->frag_count++] = strdup(xml);
+
+    return ((r->fail > -1) && (r->frag_count > r->fail)) ? 1 : 0;
+}
+
+static void
+split_clear(struct rd *r)
+{
+    while (r->frag_count) {
+        free(r->frags[--r->frag_count]);
+    }
+}
+
+/* send a message, in NETCONF 1.1 split into chunks at the given offsets */
+static void
+split_send(struct rd *r, const char *msg, const int *cuts, int cut_count)
+{
+    char len[16];
+    int i, start, end;
+
+    if (r->session->version == NC_VERSION_10) {
+        assert_int_equal(write(r->out, msg, strlen(msg)), strlen(msg));
+        assert_int_equal(write(r->out, NC_VERSION_10_ENDTAG, strlen(NC_VERSION_10_ENDTAG)), strlen(NC_VERSION_10_ENDTAG));
+        return;
+    }
+
+    for (i = 0, start = 0; i <= cut_count; ++i, start = end) {
+        end = (i < cut_count ? cuts[i] : (int)strlen(msg));
+        sprintf(len, "\n#%d\n", end - start);
+        assert_int_equal(write(r->out, len, strlen(len)), strlen(len));
+        assert_int_equal(write(r->out, msg + start, end - start), end - start);
+    }
+    assert_int_equal(write(r->out, "\n##\n", 4), 4);
+}
+
+static NC_MSG_TYPE
+split_recv(struct rd *r, uint64_t msgid, struct nc_reply **reply)
+{
+    return nc_recv_reply_stream(r->session, r->rpc, msgid, 1000, 0, split_clb, r, reply);
+}
+
+static void
+test_split_block_boundary(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    char msg[SPLIT_BLOCK * 2], frag[SPLIT_BLOCK * 2];
+    const char *head = "<rpc-reply xmlns=\"" SPLIT_NS "\" message-id=\"1\"><data><a xmlns=\"urn:a\">";
+    const char *tail = "</a></data></rpc-reply>";
+    int pad;
+
+    /* place every part of the closing tags and of the framing end tag at the block boundary */
+    for (pad = SPLIT_BLOCK - (int)(strlen(head) + strlen(tail) + 10); pad < SPLIT_BLOCK - (int)strlen(head); ++pad) {
+        sprintf(msg, "%s%*s%s", head, pad, "x", tail);
+        sprintf(frag, "<a xmlns=\"urn:a\">%*s</a>", pad, "x");
+        split_send(r, msg, NULL, 0);
+
+        assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY);
+        assert_int_equal(r->frag_count, 1);
+        assert_string_equal(r->frags[0], frag);
+        assert_int_equal(reply->type, NC_RPL_DATA);
+        assert_null(((struct nc_reply_data *)reply)->data);
+
+        nc_reply_free(reply);
+        split_clear(r);
+    }
+}
+
+static void
+test_split_markup_across_chunks(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    const char *msg = "<rpc-reply xmlns=\"" SPLIT_NS "\" message-id=\"1\"><data>"
+                      "<a xmlns=\"urn:a\"><!-- c -- > --><![CDATA[ <b> ]] ]]></a></data></rpc-reply>";
+    int cuts[3];
+
+    r->session->version = NC_VERSION_11;
+
+    /* "--" | ">" of the comment, "]]" | ">" of CDATA, and an end tag split in the middle */
+    cuts[0] = strstr(msg, "-->") - msg + 2;
+    cuts[1] = strstr(msg, "]]></a>") - msg + 2;
+    cuts[2] = strstr(msg, "</a>") - msg + 2;
+    split_send(r, msg, cuts, 3);
+
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY);
+    assert_int_equal(r->frag_count, 1);
+    assert_string_equal(r->frags[0], "<a xmlns=\"urn:a\"><!-- c -- > --><![CDATA[ <b> ]] ]]></a>");
+    nc_reply_free(reply);
+}
+
+static void
+test_split_prefixed(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    const char *msg = "<nc:rpc-reply xmlns:nc=\"" SPLIT_NS "\" message-id=\"1\"><nc:data>"
+                      "<x:a xmlns:x=\"urn:x\"><x:b/></x:a><nc:c/></nc:data></nc:rpc-reply>";
+
+    split_send(r, msg, NULL, 0);
+
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY);
+    assert_int_equal(r->frag_count, 2);
+    assert_string_equal(r->frags[0], "<x:a xmlns:nc=\"" SPLIT_NS "\" xmlns:x=\"urn:x\"><x:b/></x:a>");
+    assert_string_equal(r->frags[1], "<nc:c xmlns:nc=\"" SPLIT_NS "\"/>");
+    nc_reply_free(reply);
+}
+
+static void
+test_split_ns_override(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    const char *msg = "<rpc-reply xmlns=\"" SPLIT_NS "\" xmlns:p=\"urn:p1\" message-id=\"1\">"
+                      "<data xmlns:p=\"urn:p2\"><p:a/><p:b xmlns:p=\"urn:p3\">1</p:b></data></rpc-reply>";
+
+    split_send(r, msg, NULL, 0);
+
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY);
+    assert_int_equal(r->frag_count, 2);
+    assert_string_equal(r->frags[0], "<p:a xmlns=\"" SPLIT_NS "\" xmlns:p=\"urn:p2\"/>");
+    assert_string_equal(r->frags[1], "<p:b xmlns=\"" SPLIT_NS "\" xmlns:p=\"urn:p3\">1</p:b>");
+    nc_reply_free(reply);
+}
+
+static void
+test_split_other_msgid(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    const char *msg = "<rpc-reply xmlns=\"" SPLIT_NS "\" message-id=\"2\"><data>"
+                      "<nacm xmlns=\"urn:ietf:params:xml:ns:yang:ietf-netconf-acm\"><enable-nacm>false</enable-nacm></nacm>"
+                      "</data></rpc-reply>";
+
+    split_send(r, msg, NULL, 0);
+
+    /* a reply to another RPC is read whole, its data are then passed printed by libyang */
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY_ERR_MSGID);
+    assert_int_equal(r->frag_count, 1);
+    assert_non_null(strstr(r->frags[0], "<enable-nacm>false</enable-nacm>"));
+    assert_int_equal(reply->type, NC_RPL_DATA);
+    nc_reply_free(reply);
+}
+
+static void
+test_split_rpc_error(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    const char *msg = "<rpc-reply xmlns=\"" SPLIT_NS "\" message-id=\"1\"><rpc-error><error-type>protocol</error-type>"
+                      "<error-tag>operation-failed</error-tag><error-severity>error</error-severity></rpc-error></rpc-reply>";
+
+    split_send(r, msg, NULL, 0);
+
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY);
+    assert_int_equal(r->frag_count, 0);
+    assert_int_equal(reply->type, NC_RPL_ERROR);
+    nc_reply_free(reply);
+}
+
+static void
+test_split_clb_fail(void **state)
+{
+    struct rd *r = (struct rd *)*state;
+    struct nc_reply *reply;
+    const char *msg = "<rpc-reply xmlns=\"" SPLIT_NS "\" message-id=\"1\"><data><a xmlns=\"urn:a\"/>"
+                      "<b xmlns=\"urn:b\"/></data></rpc-reply>";
+
+    r->fail = 0;
+    split_send(r, msg, NULL, 0);
+    split_send(r, msg, NULL, 0);
+
+    /* the rest of the subtrees is skipped, but the whole message is read */
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_ERROR);
+    assert_null(reply);
+    assert_int_equal(r->frag_count, 1);
+
+    r->fail = -1;
+    split_clear(r);
+    assert_int_equal(split_recv(r, 1, &reply), NC_MSG_REPLY);
+    assert_int_equal(r->frag_count, 2);
+    nc_reply_free(reply);
+}
+
 int main(void)
 {
     const struct CMUnitTest io[] = {
         cmocka_unit_test_setup_teardown(test_write_rpc_10, setup_write, teardown_write),
         cmocka_unit_test_setup_teardown(test_write_rpc_10_bad, setup_write, teardown_write),
         cmocka_unit_test_setup_teardown(test_write_rpc_11, setup_write, teardown_write),
-        cmocka_unit_test_setup_teardown(test_write_rpc_11_bad, setup_write, teardown_write)};
+        cmocka_unit_test_setup_teardown(test_write_rpc_11_bad, setup_write, teardown_write),
+        cmocka_unit_test_setup_teardown(test_split_block_boundary, setup_read, teardown_read),
+        cmocka_unit_test_setup_teardown(test_split_markup_across_chunks, setup_read, teardown_read),
+        cmocka_unit_test_setup_teardown(test_split_prefixed, setup_read, teardown_read),
+        cmocka_unit_test_setup_teardown(test_split_ns_override, setup_read, teardown_read),
+        cmocka_unit_test_setup_teardown(test_split_other_msgid, setup_read, teardown_read),
+        cmocka_unit_test_setup_teardown(test_split_rpc_error, setup_read, teardown_read),
+        cmocka_unit_test_setup_teardown(test_split_clb_fail, setup_read, teardown_read)};
 
     return cmocka_run_group_tests(io, NULL, NULL);
 }
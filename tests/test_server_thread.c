@@ -222,6 +222,33 @@ ssh_endpt_del_authkey_thread(void *arg)
     return NULL;
 }
 
+static void *
+ssh_set_passwd_cache_timeout_thread(void *arg)
+{
+    (void)arg;
+
+    pthread_barrier_wait(&barrier);
+
+    /* enable, clear and enable the cache again while the client may be authenticating */
+    nc_server_ssh_set_passwd_cache_timeout(60);
+    nc_server_ssh_set_passwd_cache_timeout(0);
+    nc_server_ssh_set_passwd_cache_timeout(30);
+
+    return NULL;
+}
+
+static void *
+ssh_set_passwd_auth_max_thread(void *arg)
+{
+    (void)arg;
+
+    pthread_barrier_wait(&barrier);
+
+    nc_server_ssh_set_passwd_auth_max(4);
+
+    return NULL;
+}
+
 static int
 ssh_hostkey_check_clb(const char *hostname, ssh_session session)
 {
@@ -579,6 +606,8 @@ static void *(*thread_funcs[])(void *) = {
     ssh_endpt_set_auth_timeout_thread,
     ssh_endpt_add_authkey_thread,
     ssh_endpt_del_authkey_thread,
+    ssh_set_passwd_cache_timeout_thread,
+    ssh_set_passwd_auth_max_thread,
 #endif
 #ifdef NC_ENABLED_TLS
     endpt_set_address_thread,